@@ -231,14 +231,14 @@ namespace Horde3DTerrain
 	}
 	
 	
-	void TerrainNode::renderFunc( const string &shaderContext, const string &theClass, bool debugView,
+	void TerrainNode::renderFunc( uint32 shaderContext, uint32 theClass, bool debugView,
 	                              const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
 	                              int occSet )
 	{
 		CameraNode *curCam = Modules::renderer().getCurCamera();
 		if( curCam == 0x0 ) return;
 
-		Modules::renderer().setMaterial( 0x0, "" );
+		Modules::renderer().setMaterial( 0x0, 0 );
 
 		// Loop through terrain queue
 		for( uint32 i = 0, s = (uint32)Modules::sceneMan().getRenderableQueue().size(); i < s; ++i )
@@ -265,8 +265,8 @@ namespace Horde3DTerrain
 			localCamPos = terrain->_absTrans.inverted() * localCamPos;
 			
 			// Bind VBO
-			glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, terrain->_indexBuffer );
-			glBindBuffer( GL_ARRAY_BUFFER, terrain->_vertexBuffer );
+			Modules::renderer().setIndexBuffer( terrain->_indexBuffer );
+			Modules::renderer().setVertexBuffer( terrain->_vertexBuffer );
 			glVertexPointer( 3, GL_FLOAT, sizeof( float ) * 3, (char *)0 );
 			glEnableClientState( GL_VERTEX_ARRAY );
 			glVertexAttribPointer( attrib_terHeight, 1, GL_FLOAT, GL_FALSE, sizeof( float ),
@@ -126,7 +126,7 @@ namespace Horde3DTerrain
 
 		static SceneNodeTpl *parsingFunc( std::map< std::string, std::string > &attribs );
 		static SceneNode *factoryFunc( const SceneNodeTpl &nodeTpl );
-		static void renderFunc( const std::string &shaderContext, const std::string &theClass, bool debugView,
+		static void renderFunc( uint32 shaderContext, uint32 theClass, bool debugView,
 			const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
 
 		bool canAttach( SceneNode &parent );
@@ -8,6 +8,7 @@
 		_F02_NormalMapping
 		_F03_ParallaxMapping
 		_F04_EnvMapping
+		_F05_DualQuatSkinning (requires _F01_Skinning)
 // =================================================================================================
 -->
 
@@ -33,19 +34,22 @@
 
 <Context id="ATTRIBPASS">
 	<Shaders vertex="VS_GENERAL" fragment="FS_ATTRIBPASS" />
+	<RenderConfig instancing="true" />
 </Context>
 
 <Context id="SHADOWMAP">
 	<Shaders vertex="VS_SHADOWMAP" fragment="FS_SHADOWMAP" />
+	<RenderConfig instancing="true" />
 </Context>
 
 <Context id="LIGHTING">
 	<Shaders vertex="VS_GENERAL" fragment="FS_LIGHTING" />
-	<RenderConfig writeDepth="false" blendMode="ADD" />
+	<RenderConfig writeDepth="false" blendMode="ADD" instancing="true" />
 </Context>
 
 <Context id="AMBIENT">
 	<Shaders vertex="VS_GENERAL" fragment="FS_AMBIENT" />
+	<RenderConfig instancing="true" />
 </Context>
 
 
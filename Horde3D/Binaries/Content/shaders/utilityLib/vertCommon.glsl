@@ -9,8 +9,15 @@
 //
 // *************************************************************************************************
 
-uniform 	mat4 worldMat;
-uniform		mat3 worldNormalMat;
+#ifdef _INSTANCING_
+	attribute	mat4 instWorldMat;
+	attribute	mat3 instWorldNormalMat;
+	#define worldMat instWorldMat
+	#define worldNormalMat instWorldNormalMat
+#else
+	uniform 	mat4 worldMat;
+	uniform		mat3 worldNormalMat;
+#endif
 
 
 vec4 calcWorldPos( const vec4 pos )
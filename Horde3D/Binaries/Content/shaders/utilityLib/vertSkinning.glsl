@@ -9,8 +9,66 @@
 //
 // *************************************************************************************************
 
-uniform 	vec4 skinMatRows[75*3];
 attribute 	vec4 joints, weights;
+uniform 	float skinInfluences;  // Number of influences used for the current LOD (0: all)
+
+
+vec4 getSkinWeights()
+{
+	// Influences are sorted by weight, so reduced sets use the first ones with renormalized weights
+	if( skinInfluences == 1.0 ) return vec4( 1.0, 0.0, 0.0, 0.0 );
+	if( skinInfluences == 2.0 ) return vec4( weights.xy / max( weights.x + weights.y, 0.0001 ), 0.0, 0.0 );
+	return weights;
+}
+
+#ifdef _F05_DualQuatSkinning
+
+// Each joint is passed as a real and a dual quaternion
+uniform 	vec4 skinDualQuats[75*2];
+
+
+mat4 calcSkinningMat()
+{
+	vec4 q0 = skinDualQuats[int( joints.x ) * 2];
+	vec4 q1 = skinDualQuats[int( joints.y ) * 2];
+	vec4 q2 = skinDualQuats[int( joints.z ) * 2];
+	vec4 q3 = skinDualQuats[int( joints.w ) * 2];
+	
+	// Negate quaternions in the opposite hemisphere of the first one to blend along shortest path
+	vec4 w = getSkinWeights();
+	if( dot( q0, q1 ) < 0.0 ) w.y = -w.y;
+	if( dot( q0, q2 ) < 0.0 ) w.z = -w.z;
+	if( dot( q0, q3 ) < 0.0 ) w.w = -w.w;
+
+	vec4 r = q0 * w.x + q1 * w.y + q2 * w.z + q3 * w.w;
+	vec4 d = skinDualQuats[int( joints.x ) * 2 + 1] * w.x +
+			 skinDualQuats[int( joints.y ) * 2 + 1] * w.y +
+			 skinDualQuats[int( joints.z ) * 2 + 1] * w.z +
+			 skinDualQuats[int( joints.w ) * 2 + 1] * w.w;
+	
+	float len = length( r );
+	r /= len;
+	d /= len;
+	vec3 t = 2.0 * (r.w * d.xyz - d.w * r.xyz + cross( r.xyz, d.xyz ));
+	
+	// Note: This matrix is transposed so vec/mat multiplications need to be done in reversed order
+	return mat4( vec4( 1.0 - 2.0 * (r.y * r.y + r.z * r.z), 2.0 * (r.x * r.y - r.w * r.z),
+					   2.0 * (r.x * r.z + r.w * r.y), t.x ),
+				 vec4( 2.0 * (r.x * r.y + r.w * r.z), 1.0 - 2.0 * (r.x * r.x + r.z * r.z),
+					   2.0 * (r.y * r.z - r.w * r.x), t.y ),
+				 vec4( 2.0 * (r.x * r.z - r.w * r.y), 2.0 * (r.y * r.z + r.w * r.x),
+					   1.0 - 2.0 * (r.x * r.x + r.y * r.y), t.z ),
+				 vec4( 0, 0, 0, 1 ) );
+}
+
+vec4 skinPos( const vec4 pos )
+{
+	return pos * calcSkinningMat();
+}
+
+#else
+
+uniform 	vec4 skinMatRows[75*3];
 
 
 mat4 getJointMat( const int jointIndex )
@@ -24,23 +82,35 @@ mat4 getJointMat( const int jointIndex )
 
 mat4 calcSkinningMat()
 {
-	return weights.x * getJointMat( int( joints.x ) ) +
-		   weights.y * getJointMat( int( joints.y ) ) +
-		   weights.z * getJointMat( int( joints.z ) ) +
-		   weights.w * getJointMat( int( joints.w ) );
+	if( skinInfluences == 1.0 ) return getJointMat( int( joints.x ) );
+	
+	vec4 w = getSkinWeights();
+	mat4 m = w.x * getJointMat( int( joints.x ) ) +
+			 w.y * getJointMat( int( joints.y ) );
+	if( skinInfluences == 2.0 ) return m;
+	
+	return m + w.z * getJointMat( int( joints.z ) ) +
+			   w.w * getJointMat( int( joints.w ) );
 }
 
-mat3 getSkinningMatVec( const mat4 skinningMat )
+vec4 skinPos( const vec4 pos )
 {
-	return mat3( skinningMat[0].xyz, skinningMat[1].xyz, skinningMat[2].xyz );
+	if( skinInfluences == 1.0 ) return pos * getJointMat( int( joints.x ) );
+	
+	vec4 w = getSkinWeights();
+	vec4 p = pos * getJointMat( int( joints.x ) ) * w.x +
+			 pos * getJointMat( int( joints.y ) ) * w.y;
+	if( skinInfluences == 2.0 ) return p;
+	
+	return p + pos * getJointMat( int( joints.z ) ) * w.z +
+			   pos * getJointMat( int( joints.w ) ) * w.w;
 }
 
-vec4 skinPos( const vec4 pos )
+#endif
+
+mat3 getSkinningMatVec( const mat4 skinningMat )
 {
-	return pos * getJointMat( int( joints.x ) ) * weights.x +
-		   pos * getJointMat( int( joints.y ) ) * weights.y +
-		   pos * getJointMat( int( joints.z ) ) * weights.z +
-		   pos * getJointMat( int( joints.w ) ) * weights.w;
+	return mat3( skinningMat[0].xyz, skinningMat[1].xyz, skinningMat[2].xyz );
 }
 
 vec4 skinPos( const vec4 pos, const mat4 skinningMat )
@@ -56,7 +56,11 @@ namespace Horde3DNET
             SampleCount,
             WireframeMode,
             DebugViewMode,
-            DumpFailedShaders
+            DumpFailedShaders,
+            AnimationCulling,
+            VertexCompression,
+            GPUOnlyGeometry,
+            DynamicBatchSize
         }
 
         public enum EngineStats
@@ -65,7 +69,22 @@ namespace Horde3DNET
             BatchCount,
             LightPassCount,
             FrameTime,
-            CustomTime
+            CustomTime,
+            AnimFullCount,
+            AnimReducedCount,
+            AnimSkippedCount,
+            GeoUploadSize,
+            ClusterTriCount,
+            ClusterCullRatio,
+            DynBatchSavedCount,
+            DynBatchTime,
+            InstanceSavedCount,
+            ShaderBindCount,
+            MaterialBindCount,
+            TextureBindCount,
+            BufferBindCount,
+            StateCallCount,
+            StateCallFilteredCount
         }
 
         public enum ResourceTypes
@@ -87,7 +106,8 @@ namespace Horde3DNET
         {
             NoQuery = 1, //horde3d 1.0
             NoTexCompression = 2, //horde3d 1.0
-            NoTexMipmaps = 4 //horde3d 1.0
+            NoTexMipmaps = 4, //horde3d 1.0
+            NoGeoCPUCopy = 8
         }
 
         public enum GeometryResParams
@@ -95,7 +115,8 @@ namespace Horde3DNET
        		VertexCount = 200,
 		    IndexCount,
 		    VertexData,
-		    IndexData
+		    IndexData,
+		    CPUDataSize
         }
 
         public enum AnimationResParams
@@ -177,7 +198,13 @@ namespace Horde3DNET
             LodDist1,
             LodDist2,
             LodDist3,
-            LodDist4
+            LodDist4,
+            AnimLodDist1,
+            AnimLodDist2,
+            AnimLodJointDepth,
+            DualQuatSkinning,
+            SkinWeightLod,
+            JointHitboxes
         }
 
         public enum MeshNodeParams
@@ -234,7 +261,8 @@ namespace Horde3DNET
             SpreadAngle,
             ForceX,
             ForceY,
-            ForceZ
+            ForceZ,
+            PlaybackRate
         }
 
         // --- Basic funtions ---
@@ -1200,6 +1228,32 @@ namespace Horde3DNET
             return NativeMethodsEngine.checkNodeVisibility(node, cameraNode, checkOcclusion, calcLod);
         }
 
+        /// <summary>
+        /// Advances all nodes that are registered for engine playback.
+        /// </summary>
+        /// <remarks>This function advances the animation time of all Model stages that were started with
+        /// setModelAnimPlayback or fadeModelAnimStage and the simulation time of all Emitter nodes
+        /// with a PlaybackRate greater than 0. Nodes are unregistered automatically when their playback has finished.</remarks>
+        /// <param name="timeDelta">time elapsed since the last call in seconds</param>
+        public static void advanceTime(float timeDelta)
+        {
+            NativeMethodsEngine.advanceTime(timeDelta);
+        }
+
+        /// <summary>
+        /// Merges static meshes with the same material into combined draw calls.
+        /// </summary>
+        /// <remarks>Meshes below the node that only depend on their node transformation are merged into pre-transformed
+        /// buffers that are split into cells for culling. Merged Mesh nodes stay queryable but are skipped during rendering.
+        /// Any later change of a merged Mesh releases all batches.</remarks>
+        /// <param name="node">node at which the search for Meshes is beginning</param>
+        /// <param name="maxCellSize">maximum extent of a cell in world units (0 for no spatial limit)</param>
+        /// <returns>number of created batches</returns>
+        public static int buildStaticBatches(int node, float maxCellSize)
+        {
+            return NativeMethodsEngine.buildStaticBatches(node, maxCellSize);
+        }
+
         // Group specific
         /// <summary>
         /// This function creates a new Group node and attaches it to the specified parent node.
@@ -1288,6 +1342,36 @@ namespace Horde3DNET
             return NativeMethodsEngine.setModelMorpher(node, target, weight);
         }
 
+        /// <summary>
+        /// Lets the engine advance the time of an animation stage.
+        /// </summary>
+        /// <remarks>The time of the stage is advanced by advanceTime. The speed is given in frames per second and can be
+        /// negative; a speed of 0 stops the playback. If loop is false, playback stops at the first or last frame.</remarks>
+        /// <param name="node">handle to the Model node to be modified</param>
+        /// <param name="stage">index of the animation stage to be modified</param>
+        /// <param name="speed">playback speed in frames per second</param>
+        /// <param name="loop">flag indicating whether the animation is looped</param>
+        /// <returns>true in case of success, otherwise false</returns>
+        public static bool setModelAnimPlayback(int node, int stage, float speed, bool loop)
+        {
+            return NativeMethodsEngine.setModelAnimPlayback(node, stage, speed, loop);
+        }
+
+        /// <summary>
+        /// Fades the weight of an animation stage over time.
+        /// </summary>
+        /// <remarks>The weight is blended linearly towards the target weight within fadeTime seconds by advanceTime.
+        /// If fadeTime is 0 or less, the weight is set immediately.</remarks>
+        /// <param name="node">handle to the Model node to be modified</param>
+        /// <param name="stage">index of the animation stage to be modified</param>
+        /// <param name="weight">target blend weight</param>
+        /// <param name="fadeTime">duration of the fade in seconds</param>
+        /// <returns>true in case of success, otherwise false</returns>
+        public static bool fadeModelAnimStage(int node, int stage, float weight, float fadeTime)
+        {
+            return NativeMethodsEngine.fadeModelAnimStage(node, stage, weight, fadeTime);
+        }
+
         // Mesh specific
         /// <summary>
         /// This function creates a new Mesh node and attaches it to the specified parent node.
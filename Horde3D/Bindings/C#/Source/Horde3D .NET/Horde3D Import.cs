@@ -289,6 +289,12 @@ namespace Horde3DNET
         [DllImport(ENGINE_DLL), SuppressUnmanagedCodeSecurity]
         internal static extern int checkNodeVisibility(int node, int cameraNode, [MarshalAs(UnmanagedType.U1)]bool checkOcclusion, [MarshalAs(UnmanagedType.U1)]bool calcLod);
 
+        [DllImport(ENGINE_DLL), SuppressUnmanagedCodeSecurity]
+        internal static extern void advanceTime(float timeDelta);
+
+        [DllImport(ENGINE_DLL), SuppressUnmanagedCodeSecurity]
+        internal static extern int buildStaticBatches(int node, float maxCellSize);
+
         // Group specific
         [DllImport(ENGINE_DLL), SuppressUnmanagedCodeSecurity]
         internal static extern int addGroupNode(int parent, string name);
@@ -310,6 +316,14 @@ namespace Horde3DNET
         [return: MarshalAs(UnmanagedType.U1)]   // represents C++ bool type 
         internal static extern bool setModelMorpher(int node, string target, float weight);
 
+        [DllImport(ENGINE_DLL), SuppressUnmanagedCodeSecurity]
+        [return: MarshalAs(UnmanagedType.U1)]   // represents C++ bool type 
+        internal static extern bool setModelAnimPlayback(int node, int stage, float speed, [MarshalAs(UnmanagedType.U1)]bool loop);
+
+        [DllImport(ENGINE_DLL), SuppressUnmanagedCodeSecurity]
+        [return: MarshalAs(UnmanagedType.U1)]   // represents C++ bool type 
+        internal static extern bool fadeModelAnimStage(int node, int stage, float weight, float fadeTime);
+
         // Mesh specific
         [DllImport(ENGINE_DLL), SuppressUnmanagedCodeSecurity]
         internal static extern int addMeshNode(int parent, string name, int matRes, 
@@ -90,6 +90,26 @@ struct EngineOptions
 		                      lights are visualized using their screen space bounding box. (Values: 0, 1; Default: 0)
 		DumpFailedShaders   - Enables or disables storing of shader code that failed to compile in a text file; this can be
 		                      useful in combination with the line numbers given back by the shader compiler. (Values: 0, 1; Default: 0)
+		AnimationCulling    - Enables or disables skipping of animation updates for models that were not drawn in the
+		                      last frame, neither in the view nor in the shadow map of a visible light; the animation is
+		                      caught up as soon as the model gets visible. (Values: 0, 1; Default: 0)
+		VertexCompression   - Enables or disables storing of vertex data in video memory in a compact layout: positions of
+		                      static geometry are quantized to 16 bit relative to its bounding box, normals, tangents and
+		                      bitangents use the 10:10:10:2 format (normalized shorts without OpenGL 3.3) and joint indices
+		                      and weights are bytes, which reduces static geometry to less than half of its size. CPU copies
+		                      keep the float layout and bitangents are still stored since shaders read them as attribute;
+		                      affects only geometry resources loaded afterwards. (Values: 0, 1; Default: 0)
+		GPUOnlyGeometry     - Enables or disables releasing the CPU copies of static Geometry resources (no morph targets,
+		                      at most one joint) after upload; the data is read back from video memory when it is
+		                      required and released again after ray casts, cloning and static batching, while data
+		                      requested with getResourceData is kept. With VertexCompression the read back data is
+		                      decoded from the compact layout and differs from the original data by the quantization
+		                      error; affects only geometry resources loaded afterwards.
+		                      (Values: 0, 1; Default: 0)
+		DynamicBatchSize    - Maximum number of vertices of a Mesh that is merged with other visible Meshes of the same
+		                      material into a single draw call; the vertices are transformed on the CPU each frame,
+		                      so only small meshes should be batched. Meshes of Models with a skeleton, morph targets or
+		                      occlusion culling are not merged. 0 disables dynamic batching. (Default: 0)
 	*/
 	enum List
 	{
@@ -104,7 +124,11 @@ struct EngineOptions
 		SampleCount,
 		WireframeMode,
 		DebugViewMode,
-		DumpFailedShaders
+		DumpFailedShaders,
+		AnimationCulling,
+		VertexCompression,
+		GPUOnlyGeometry,
+		DynamicBatchSize
 	};
 };
 
@@ -113,11 +137,26 @@ struct EngineStats
 	/*	Enum: EngineStats
 			The available engine statistic parameters.
 		
-		TriCount        - Number of triangles that were pushed to the renderer
-		BatchCount      - Number of batches (draw calls)
-		LightPassCount  - Number of lighting passes
-		FrameTime       - Time in ms between two finalizeFrame calls
-		CustomTime      - Value of custom timer (useful for profiling engine functions)
+		TriCount          - Number of triangles that were pushed to the renderer
+		BatchCount        - Number of batches (draw calls)
+		LightPassCount    - Number of lighting passes
+		FrameTime         - Time in ms between two finalizeFrame calls
+		CustomTime        - Value of custom timer (useful for profiling engine functions)
+		AnimFullCount     - Number of model animation updates done at full rate
+		AnimReducedCount  - Number of model animation updates done at reduced rate
+		AnimSkippedCount  - Number of model animation updates that were skipped due to animation LOD
+		GeoUploadSize     - Number of bytes of vertex data uploaded for dynamic geometry
+		ClusterTriCount   - Number of triangles of meshes that were culled per cluster
+		ClusterCullRatio  - Ratio of cluster triangles that were culled by frustum or normal cone culling
+		DynBatchSavedCount - Number of draw calls saved by dynamic batching
+		DynBatchTime       - CPU time in ms spent for transforming and uploading dynamically batched vertices
+		InstanceSavedCount - Number of draw calls saved by hardware instancing
+		ShaderBindCount    - Number of shader program changes
+		MaterialBindCount  - Number of material setups
+		TextureBindCount   - Number of textures bound to samplers
+		BufferBindCount    - Number of vertex and index buffer bindings for drawing geometry
+		StateCallCount     - Number of OpenGL state changes that were actually issued
+		StateCallFilteredCount - Number of redundant OpenGL state changes skipped by the state cache
 	*/
 	enum List
 	{
@@ -125,7 +164,22 @@ struct EngineStats
 		BatchCount,
 		LightPassCount,
 		FrameTime,
-		CustomTime
+		CustomTime,
+		AnimFullCount,
+		AnimReducedCount,
+		AnimSkippedCount,
+		GeoUploadSize,
+		ClusterTriCount,
+		ClusterCullRatio,
+		DynBatchSavedCount,
+		DynBatchTime,
+		InstanceSavedCount,
+		ShaderBindCount,
+		MaterialBindCount,
+		TextureBindCount,
+		BufferBindCount,
+		StateCallCount,
+		StateCallFilteredCount
 	};
 };
 
@@ -168,12 +222,14 @@ struct ResourceFlags
 		NoQuery           - Excludes resource from being listed by queryUnloadedResource function.
 		NoTexCompression  - Disables texture compression for Texture resource.
 		NoTexMipmaps      - Disables generation of mipmaps for Texture resources.
+		NoGeoCPUCopy      - Releases the CPU copy of a static Geometry resource after upload (see option GPUOnlyGeometry).
 	*/
 	enum Flags
 	{
 		NoQuery = 1,
 		NoTexCompression = 2,
-		NoTexMipmaps = 4
+		NoTexMipmaps = 4,
+		NoGeoCPUCopy = 8
 	};
 };
 
@@ -186,13 +242,15 @@ struct GeometryResParams
 		IndexCount   - Number of triangle indices; valid for getResourceParami
 		VertexData   - Vertex positon data (pointer to float); valid for getResourceData
 		IndexData    - Triangle indices (pointer to uint); valid for getResourceData
+		CPUDataSize  - Number of bytes of resource data currently held in main memory; valid for getResourceParami
 	 */
 	enum List
 	{
 		VertexCount = 200,
 		IndexCount,
 		VertexData,
-		IndexData
+		IndexData,
+		CPUDataSize
 	};
 };
 
@@ -384,6 +442,20 @@ struct ModelNodeParams
 		                    (may not be smaller than LodDist2) (default: infinite) [type: float]
 		LodDist4          - Distance to camera from which on LOD4 is used
 		                    (may not be smaller than LodDist3) (default: infinite) [type: float]
+		AnimLodDist1      - Distance to camera from which on the animation is updated at a reduced rate
+		                    (default: infinite) [type: float]
+		AnimLodDist2      - Distance to camera from which on the animation is not updated anymore and the
+		                    last pose is kept (clamped to be not smaller than AnimLodDist1) (default: infinite) [type: float]
+		AnimLodJointDepth - Maximum hierarchy depth of joints that are animated at reduced rate;
+		                    0 animates all joints (default: 0) [type: int]
+		DualQuatSkinning  - Enables or disables dual quaternion blending for software skinning; hardware
+		                    skinning uses dual quaternions when the shader declares skinDualQuats
+		                    (default: 0) [type: int]
+		SkinWeightLod     - Enables or disables reduction of joint influences per vertex for LOD levels;
+		                    LOD 1 uses two and higher levels one influence with renormalized weights
+		                    (default: 0) [type: int]
+		JointHitboxes     - Enables or disables ray tests against per-joint boxes which follow the animated
+		                    joints instead of against the bind pose triangles of the meshes (default: 0) [type: int]
 	*/
 	enum List
 	{
@@ -392,7 +464,13 @@ struct ModelNodeParams
 		LodDist1,
 		LodDist2,
 		LodDist3,
-		LodDist4
+		LodDist4,
+		AnimLodDist1,
+		AnimLodDist2,
+		AnimLodJointDepth,
+		DualQuatSkinning,
+		SkinWeightLod,
+		JointHitboxes
 	};
 };
 
@@ -511,6 +589,8 @@ struct EmitterNodeParams
 		ForceX             - X-component of force vector applied to particles (default: 0.0) [type: float]
 		ForceY             - Y-component of force vector applied to particles (default: 0.0) [type: float]
 		ForceZ             - Z-component of force vector applied to particles (default: 0.0) [type: float]
+		PlaybackRate       - Time scale applied when the emitter is advanced by advanceTime; setting a value
+		                     greater than 0 registers the emitter for engine playback (default: 0.0) [type: float]
 	*/
 	enum List
 	{
@@ -523,7 +603,8 @@ struct EmitterNodeParams
 		SpreadAngle,
 		ForceX,
 		ForceY,
-		ForceZ
+		ForceZ,
+		PlaybackRate
 	};
 };
 
@@ -1260,7 +1341,8 @@ namespace Horde3D
 			Returns the handle to a child node.
 		
 		This function looks for the n-th (index) child node of a specified node and returns its handle. If the child
-		doesn't exist, the function returns 0.
+		doesn't exist, the function returns 0. Joints loaded with a model get their scene nodes when they are
+		first queried, so they follow the other children of their parent.
 		
 		Parameters:
 			node   - handle to the parent node
@@ -1527,6 +1609,7 @@ namespace Horde3D
 		This function loops recursively over all children of startNode and adds them to an internal list
 		of results if they match the specified name and type. The result list is cleared each time this
 		function is called. The function returns the number of nodes which were found and added to the list.
+		Scene nodes for matching joints that were loaded with a model are created by the search.
 		
 		Parameters:
 			startNode  - handle to the node where the search begins
@@ -1561,6 +1644,7 @@ namespace Horde3D
         nodes. The ray is a line segment and is specified by a starting point (the origin) and a finite direction
 		vector which also defines its length. Currently this function is limited to returning intersections with Meshes.
 		For Meshes, the base LOD (LOD0) is always used for performing the ray-triangle intersection tests.
+		For Models with enabled JointHitboxes, the Model node itself is returned and its meshes are not tested.
 		
 		Parameters:
 			node        - node at which intersection check is beginning
@@ -1611,6 +1695,48 @@ namespace Horde3D
 	*/
 	DLL int checkNodeVisibility( NodeHandle node, NodeHandle cameraNode, bool checkOcclusion, bool calcLod );
 
+	/*	Function: advanceTime
+			Advances all nodes that are registered for engine playback.
+
+		This function advances the animation time of all Model stages that were started with
+		setModelAnimPlayback or fadeModelAnimStage and the simulation time of all Emitter nodes
+		with a PlaybackRate greater than 0. Only nodes whose state actually changes are marked as
+		dirty. Models are unregistered automatically when their playback has finished; Emitters
+		stay registered until their PlaybackRate is set to 0, so a finished Emitter resumes when
+		its parameters restart it. Calling this function once per frame is enough to drive all
+		engine-side playback.
+
+		Parameters:
+			timeDelta  - time elapsed since the last call in seconds
+
+		Returns:
+			nothing
+	*/
+	DLL void advanceTime( float timeDelta );
+
+	/*	Function: buildStaticBatches
+			Merges static meshes with the same material into combined draw calls.
+
+		This function collects all Meshes below the specified node that have the same material and do not
+		depend on anything but their node transformation (no skeleton, no morph targets, no LOD levels and no
+		software skinning) and merges them into pre-transformed vertex and index buffers. The merged meshes
+		are split into cells along the longest axis until each cell fits into 16 bit indices and its extent
+		is not larger than maxCellSize, so that cells can still be culled against the view frustum. Each cell
+		is drawn with a single call and the merged Mesh nodes are skipped during rendering but stay in the
+		scene graph and can be queried as usual. Any later change of a merged Mesh (transformation, material,
+		activation or removal) releases all batches, so the function should be called after the static part
+		of the scene was set up. Calling the function again replaces the previous batches. The number of
+		merged Meshes and resulting batches is written to the log.
+		
+		Parameters:
+			node         - node at which the search for Meshes is beginning
+			maxCellSize  - maximum extent of a cell in world units (0 for no spatial limit)
+			
+		Returns:
+			number of created batches
+	*/
+	DLL int buildStaticBatches( NodeHandle node, float maxCellSize );
+
 
 	/* Group: Group-specific scene graph functions */
 	/* 	Function: addGroupNode
@@ -1710,6 +1836,44 @@ namespace Horde3D
 	*/
 	DLL bool setModelMorpher( NodeHandle modelNode, const char *target, float weight );
 	
+	/* 	Function: setModelAnimPlayback
+			Lets the engine advance the time of an animation stage.
+		
+		This function configures the playback of the specified animation stage so that its time is
+		advanced automatically by advanceTime. The speed is given in frames per second and can be negative
+		to play the animation backwards; a speed of 0 stops the playback and leaves the stage under control
+		of setModelAnimParams again. If loop is false, playback stops when the first or last frame is reached.
+		Calling setupModelAnimStage on the stage stops the playback as well.
+		
+		Parameters:
+			modelNode  - handle to the Model node to be modified
+			stage      - index of the animation stage to be modified
+			speed      - playback speed in frames per second
+			loop       - flag indicating whether the animation is looped
+			
+		Returns:
+			true in case of success, otherwise false
+	*/
+	DLL bool setModelAnimPlayback( NodeHandle modelNode, int stage, float speed, bool loop );
+	
+	/* 	Function: fadeModelAnimStage
+			Fades the weight of an animation stage over time.
+		
+		This function blends the weight of the specified animation stage linearly towards the target weight
+		within fadeTime seconds. The fade is advanced by advanceTime. If fadeTime is 0 or less, the weight
+		is set immediately.
+		
+		Parameters:
+			modelNode  - handle to the Model node to be modified
+			stage      - index of the animation stage to be modified
+			weight     - target blend weight
+			fadeTime   - duration of the fade in seconds
+			
+		Returns:
+			true in case of success, otherwise false
+	*/
+	DLL bool fadeModelAnimStage( NodeHandle modelNode, int stage, float weight, float fadeTime );
+	
 	
 	/* Group: Mesh-specific scene graph functions */
 	/* 	Function: addMeshNode
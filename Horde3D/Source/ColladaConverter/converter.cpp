@@ -34,6 +34,7 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <set>
 
 using namespace std;
 
@@ -416,6 +417,117 @@ void Converter::processJoints()
 }
 
 
+unsigned int Converter::splitTriGroup( TriGroup &triGroup, vector< TriGroup > &triGroups )
+{
+	// Note: The vertices and indices of the triangle group have to be at the end of the arrays
+
+	set< Joint * > joints;
+	for( unsigned int i = triGroup.vertRStart; i <= triGroup.vertREnd && i < _vertices.size(); ++i )
+	{
+		for( unsigned int j = 0; j < 4; ++j )
+		{
+			if( _vertices[i].joints[j] != 0x0 && _vertices[i].weights[j] > 0 )
+				joints.insert( _vertices[i].joints[j] );
+		}
+	}
+
+	if( joints.size() <= MaxJointsPerBatch )
+	{
+		triGroups.push_back( triGroup );
+		return 1;
+	}
+
+	// Distribute triangles to batches which reference at most MaxJointsPerBatch joints; vertices
+	// are copied so that every batch gets its own vertex range and hence its own joint palette
+	vector< Vertex > verts( _vertices.begin() + triGroup.vertRStart, _vertices.end() );
+	vector< unsigned int > indices( _indices.begin() + triGroup.first, _indices.end() );
+	vector< int > vertMap( verts.size(), -1 );
+	_vertices.resize( triGroup.vertRStart );
+	_indices.resize( triGroup.first );
+	
+	TriGroup batch = triGroup;
+	unsigned int numBatches = 0;
+	joints.clear();
+	
+	for( unsigned int i = 0; i < indices.size(); i += 3 )
+	{
+		set< Joint * > triJoints;
+		for( unsigned int j = 0; j < 3; ++j )
+		{
+			Vertex &v = verts[indices[i + j] - triGroup.vertRStart];
+			for( unsigned int k = 0; k < 4; ++k )
+			{
+				if( v.joints[k] != 0x0 && v.weights[k] > 0 && joints.find( v.joints[k] ) == joints.end() )
+					triJoints.insert( v.joints[k] );
+			}
+		}
+
+		// Start new batch if joint limit would be exceeded
+		if( joints.size() + triJoints.size() > MaxJointsPerBatch && _indices.size() > batch.first )
+		{
+			batch.count = (unsigned int)_indices.size() - batch.first;
+			batch.vertREnd = (unsigned int)_vertices.size() - 1;
+			triGroups.push_back( batch );
+			++numBatches;
+
+			batch.first = (unsigned int)_indices.size();
+			batch.vertRStart = (unsigned int)_vertices.size();
+			joints.clear();
+			vertMap.assign( verts.size(), -1 );
+			
+			// Joints of current triangle are all new for the batch
+			triJoints.clear();
+			for( unsigned int j = 0; j < 3; ++j )
+			{
+				Vertex &v = verts[indices[i + j] - triGroup.vertRStart];
+				for( unsigned int k = 0; k < 4; ++k )
+					if( v.joints[k] != 0x0 && v.weights[k] > 0 ) triJoints.insert( v.joints[k] );
+			}
+		}
+
+		joints.insert( triJoints.begin(), triJoints.end() );
+		
+		for( unsigned int j = 0; j < 3; ++j )
+		{
+			unsigned int index = indices[i + j] - triGroup.vertRStart;
+			if( vertMap[index] < 0 )
+			{
+				vertMap[index] = (int)_vertices.size();
+				_vertices.push_back( verts[index] );
+			}
+			_indices.push_back( (unsigned int)vertMap[index] );
+		}
+	}
+
+	if( _indices.size() > batch.first )
+	{
+		batch.count = (unsigned int)_indices.size() - batch.first;
+		batch.vertREnd = (unsigned int)_vertices.size() - 1;
+		triGroups.push_back( batch );
+		++numBatches;
+	}
+
+	// Rebuild the position lookup table for the copied vertices; every batch gets the table of
+	// all batches so that normals are still smoothed across vertices duplicated at batch borders
+	delete[] triGroup.posIndexToVertices;
+	triGroup.posIndexToVertices = 0x0;
+	
+	vector< unsigned int > *posIndexToVertices = new vector< unsigned int >[triGroup.numPosIndices];
+	for( unsigned int i = triGroup.vertRStart; i < _vertices.size(); ++i )
+		posIndexToVertices[_vertices[i].daePosIndex].push_back( i );
+	
+	for( unsigned int i = (unsigned int)triGroups.size() - numBatches; i < triGroups.size(); ++i )
+	{
+		triGroups[i].posIndexToVertices = new vector< unsigned int >[triGroup.numPosIndices];
+		for( unsigned int j = 0; j < triGroup.numPosIndices; ++j )
+			triGroups[i].posIndexToVertices[j] = posIndexToVertices[j];
+	}
+	delete[] posIndexToVertices;
+
+	return numBatches;
+}
+
+
 void Converter::processMeshes( ColladaDocument &doc, bool optimize )
 {
 	// Note: At the moment the geometry for all nodes is copied and not referenced
@@ -671,7 +783,15 @@ void Converter::processMeshes( ColladaDocument &doc, bool optimize )
 				log( "Removed " + ss.str() + " degenerated triangles from mesh " + _meshes[i]->daeNode->id );
 			}
 			
-			_meshes[i]->triGroups.push_back( oTriGroup );
+			// Split triangle group if it references too many joints for a single batch
+			unsigned int numBatches = splitTriGroup( oTriGroup, _meshes[i]->triGroups );
+			if( numBatches > 1 )
+			{
+				stringstream ss;
+				ss << numBatches;
+				log( "Split mesh " + _meshes[i]->daeNode->id + " into " + ss.str() +
+				     " batches to limit number of joints per batch" );
+			}
 		}
 
 		unsigned int numGeoVerts = (unsigned int)_vertices.size() - firstGeoVert;
@@ -802,6 +922,10 @@ void Converter::processMeshes( ColladaDocument &doc, bool optimize )
 				MeshOptimizer::optimizeIndexOrder( _meshes[i]->triGroups[j], _vertices, _indices );
 				effAfter += MeshOptimizer::calcCacheEfficiency( _meshes[i]->triGroups[j], _indices );
 			}
+
+			// Split large batches of static geometry into clusters for finer culling
+			if( _joints.empty() && _morphTargets.empty() )
+				MeshOptimizer::buildClusters( _meshes[i]->triGroups[j], _vertices, _indices, _clusters );
 			
 			delete[] _meshes[i]->triGroups[j].posIndexToVertices;
 			_meshes[i]->triGroups[j].posIndexToVertices = 0x0;
@@ -845,217 +969,233 @@ bool Converter::convertModel( ColladaDocument &doc, bool optimize )
 }
 
 
-bool Converter::writeGeometry( const string &name )
+static void appendData( vector< char > &data, const void *ptr, size_t size )
 {
-	FILE *f = fopen( (string() + "models/" + name + "/" + name + ".geo").c_str(), "wb" );
+	data.insert( data.end(), (const char *)ptr, (const char *)ptr + size );
+}
 
-	// Write header
-	unsigned int version = 5;
-	fwrite( "H3DG", 4, 1, f );
-	fwrite( &version, sizeof( int ), 1, f ); 
+
+static void appendMorphStream( vector< char > &data, const vector< MorphDiff > &diffs, Vec3f MorphDiff::*stream )
+{
+	// Quantize difference vectors to 16 bit with a common scale for the stream
+	float maxValue = 0;
+	for( unsigned int i = 0; i < diffs.size(); ++i )
+	{
+		const Vec3f &v = diffs[i].*stream;
+		maxValue = max( maxValue, max( fabsf( v.x ), max( fabsf( v.y ), fabsf( v.z ) ) ) );
+	}
+
+	float scale = maxValue / 32767.0f;
+	appendData( data, &scale, sizeof( float ) );
 	
-	// Write joints
-	unsigned int count = (unsigned int)_joints.size() + 1;
-	fwrite( &count, sizeof( int ), 1, f );
+	for( unsigned int i = 0; i < diffs.size(); ++i )
+	{
+		const Vec3f &v = diffs[i].*stream;
+		short values[3] = { 0, 0, 0 };
+		if( maxValue > 0 )
+		{
+			values[0] = (short)ftoi_r( v.x / scale );
+			values[1] = (short)ftoi_r( v.y / scale );
+			values[2] = (short)ftoi_r( v.z / scale );
+		}
+		appendData( data, values, sizeof( values ) );
+	}
+
+	// Pad to 4 bytes
+	if( diffs.size() & 1 ) data.resize( data.size() + sizeof( short ), 0 );
+}
+
 
-	// Write default identity matrix
-	for( unsigned int j = 0; j < 16; ++j )
-		fwrite( &Matrix4f().x[j], sizeof( float ), 1, f );
+bool Converter::writeGeometry( const string &name )
+{
+	// Geometry is written in the runtime layout of the engine (format version 6), so that it can be
+	// loaded and uploaded without converting single elements; each block of data is a section that
+	// is referenced from the section table in the header and aligned to 16 bytes
+
+	// Section types as defined in engine
+	enum { SecJoints = 1, SecDynVertices, SecStaticVertices, SecJointIndices, SecIndices16,
+	       SecIndices32, SecMorphTargets, SecIndexBases, SecClusters };
+	
+	FILE *f = fopen( (string() + "models/" + name + "/" + name + ".geo").c_str(), "wb" );
+	if( f == 0x0 ) return false;
 
+	vector< pair< unsigned int, vector< char > > > sections;
+	unsigned int count = (unsigned int)_vertices.size();
+	
+	// Joints; first joint is default identity matrix
+	sections.push_back( make_pair( (unsigned int)SecJoints, vector< char >() ) );
+	appendData( sections.back().second, Matrix4f().x, sizeof( float ) * 16 );
 	for( unsigned int i = 0; i < _joints.size(); ++i )
 	{
-		// Inverse bind matrix
-		for( unsigned int j = 0; j < 16; ++j )
+		appendData( sections.back().second, _joints[i]->invBindMat.x, sizeof( float ) * 16 );
+	}
+	
+	// Dynamic vertex streams
+	sections.push_back( make_pair( (unsigned int)SecDynVertices, vector< char >() ) );
+	for( unsigned int i = 0; i < 4; ++i )
+	{
+		for( unsigned int j = 0; j < count; ++j )
 		{
-			fwrite( &_joints[i]->invBindMat.x[j], sizeof( float ), 1, f );
+			const Vec3f &v = i == 0 ? _vertices[j].pos : i == 1 ? _vertices[j].normal :
+			                 i == 2 ? _vertices[j].tangent : _vertices[j].bitangent;
+			float values[3] = { v.x, v.y, v.z };
+			appendData( sections.back().second, values, sizeof( values ) );
 		}
 	}
-	
-	// Write vertex stream data
-	if( _joints.empty() ) count = 6; else count = 8;	// Number of streams
-	fwrite( &count, sizeof( int ), 1, f );
-	count = (unsigned int)_vertices.size();
-	fwrite( &count, sizeof( int ), 1, f );
 
-	for( unsigned int i = 0; i < 8; ++i )
+	// Static vertex data and joint indices; influences are sorted by descending weight
+	sections.push_back( make_pair( (unsigned int)SecStaticVertices, vector< char >() ) );
+	vector< unsigned char > jointIndices( count * 4, 0 );
+	for( unsigned int i = 0; i < count; ++i )
 	{
-		if( _joints.empty() && (i == 4 || i == 5) ) continue;
-		
-		unsigned char uc;
-		short sh;
-		unsigned int streamElemSize;
-		
-		switch( i )
+		const Vertex &v = _vertices[i];
+		float weights[4];
+		for( unsigned int j = 0; j < 4; ++j )
 		{
-		case 0:		// Position
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 3 * sizeof( float ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
-			{
-				fwrite( &_vertices[j].pos.x, sizeof( float ), 1, f );
-				fwrite( &_vertices[j].pos.y, sizeof( float ), 1, f );
-				fwrite( &_vertices[j].pos.z, sizeof( float ), 1, f );
-			}
-			break;
-		case 1:		// Normal
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 3 * sizeof( short ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
-			{
-				sh = (short)(_vertices[j].normal.x * 32767); fwrite( &sh, sizeof( short ), 1, f );
-				sh = (short)(_vertices[j].normal.y * 32767); fwrite( &sh, sizeof( short ), 1, f );
-				sh = (short)(_vertices[j].normal.z * 32767); fwrite( &sh, sizeof( short ), 1, f );
-			}
-			break;
-		case 2:		// Tangent
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 3 * sizeof( short ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
-			{
-				sh = (short)(_vertices[j].tangent.x * 32767); fwrite( &sh, sizeof( short ), 1, f );
-				sh = (short)(_vertices[j].tangent.y * 32767); fwrite( &sh, sizeof( short ), 1, f );
-				sh = (short)(_vertices[j].tangent.z * 32767); fwrite( &sh, sizeof( short ), 1, f );
-			}
-			break;
-		case 3:		// Bitangent
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 3 * sizeof( short ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
-			{
-				sh = (short)(_vertices[j].bitangent.x * 32767); fwrite( &sh, sizeof( short ), 1, f );
-				sh = (short)(_vertices[j].bitangent.y * 32767); fwrite( &sh, sizeof( short ), 1, f );
-				sh = (short)(_vertices[j].bitangent.z * 32767); fwrite( &sh, sizeof( short ), 1, f );
-			}
-			break;
-		case 4:		// Joint indices
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 4 * sizeof( char ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
-			{
-				unsigned char jointIndices[4] = { 0, 0, 0, 0 };
-				if( _vertices[j].joints[0] != 0x0 )
-					jointIndices[0] = (unsigned char)_vertices[j].joints[0]->index;
-				if( _vertices[j].joints[1] != 0x0 )
-					jointIndices[1] = (unsigned char)_vertices[j].joints[1]->index;
-				if( _vertices[j].joints[2] != 0x0 )
-					jointIndices[2] = (unsigned char)_vertices[j].joints[2]->index;
-				if( _vertices[j].joints[3] != 0x0 )
-					jointIndices[3] = (unsigned char)_vertices[j].joints[3]->index;
-				fwrite( &jointIndices[0], sizeof( char ), 1, f );
-				fwrite( &jointIndices[1], sizeof( char ), 1, f );
-				fwrite( &jointIndices[2], sizeof( char ), 1, f );
-				fwrite( &jointIndices[3], sizeof( char ), 1, f );
-			}
-			break;
-		case 5:		// Weights
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 4 * sizeof( char ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
-			{
-				uc = (unsigned char)(_vertices[j].weights[0] * 255); fwrite( &uc, sizeof( char ), 1, f );
-				uc = (unsigned char)(_vertices[j].weights[1] * 255); fwrite( &uc, sizeof( char ), 1, f );
-				uc = (unsigned char)(_vertices[j].weights[2] * 255); fwrite( &uc, sizeof( char ), 1, f );
-				uc = (unsigned char)(_vertices[j].weights[3] * 255); fwrite( &uc, sizeof( char ), 1, f );
-			}
-			break;
-		case 6:		// Texture Coord Set 1
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 2 * sizeof( float ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
-			{
-				fwrite( &_vertices[j].texCoords[0].x, sizeof( float ), 1, f );
-				fwrite( &_vertices[j].texCoords[0].y, sizeof( float ), 1, f );
-			}
-			break;
-		case 7:		// Texture Coord Set 2
-			fwrite( &i, sizeof( int ), 1, f );
-			streamElemSize = 2 * sizeof( float ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-			for( unsigned int j = 0; j < count; ++j )
+			weights[j] = v.weights[j];
+			if( v.joints[j] != 0x0 ) jointIndices[i * 4 + j] = (unsigned char)v.joints[j]->index;
+		}
+		for( unsigned int j = 1; j < 4; ++j )
+		{
+			for( unsigned int k = j; k > 0 && weights[k] > weights[k - 1]; --k )
 			{
-				fwrite( &_vertices[j].texCoords[1].x, sizeof( float ), 1, f );
-				fwrite( &_vertices[j].texCoords[1].y, sizeof( float ), 1, f );
+				swap( weights[k], weights[k - 1] );
+				swap( jointIndices[i * 4 + k], jointIndices[i * 4 + k - 1] );
 			}
-			break;
 		}
+		
+		// Layout of VertexDataStatic
+		float values[12] = { v.texCoords[0].x, v.texCoords[0].y,
+			(float)jointIndices[i * 4 + 0], (float)jointIndices[i * 4 + 1],
+			(float)jointIndices[i * 4 + 2], (float)jointIndices[i * 4 + 3],
+			weights[0], weights[1], weights[2], weights[3], v.texCoords[1].x, v.texCoords[1].y };
+		appendData( sections.back().second, values, sizeof( values ) );
 	}
 
-	// Write triangle indices
-	count = (unsigned int)_indices.size();
-	fwrite( &count, sizeof( int ), 1, f );
-
-	for( unsigned int i = 0; i < _indices.size(); ++i )
+	if( !_joints.empty() )
 	{
-		fwrite( &_indices[i], sizeof( int ), 1, f );
+		sections.push_back( make_pair( (unsigned int)SecJointIndices, vector< char >() ) );
+		if( count > 0 ) appendData( sections.back().second, &jointIndices[0], count * 4 );
 	}
 
-	// Write morph targets
-	count = (unsigned int)_morphTargets.size();
-	fwrite( &count, sizeof( int ), 1, f );
+	// Triangle indices; they are stored relative to the first vertex of their batch, so that
+	// 16 bit indices can be used as long as no single batch spans more than 65536 vertices
+	vector< unsigned int > indices( _indices );
+	vector< unsigned int > indexBases;  // Triples of batch start, batch count and base vertex
+	for( unsigned int i = 0; i < _meshes.size(); ++i )
+	{
+		for( unsigned int j = 0; j < _meshes[i]->triGroups.size(); ++j )
+		{
+			TriGroup &triGroup = _meshes[i]->triGroups[j];
+			if( triGroup.count == 0 || triGroup.vertRStart == 0 ) continue;
+			
+			for( unsigned int k = triGroup.first; k < triGroup.first + triGroup.count; ++k )
+				indices[k] -= triGroup.vertRStart;
+			
+			indexBases.push_back( triGroup.first );
+			indexBases.push_back( triGroup.count );
+			indexBases.push_back( triGroup.vertRStart );
+		}
+	}
 
-	for( unsigned int i = 0; i < _morphTargets.size(); ++i )
+	bool indices16 = true;
+	for( unsigned int i = 0; i < indices.size(); ++i )
 	{
-		fwrite( &_morphTargets[i].name, 256, 1, f );
-		
-		// Write vertex indices
-		count = (unsigned int)_morphTargets[i].diffs.size();
-		fwrite( &count, sizeof( int ), 1, f );
+		if( indices[i] > 65535 ) indices16 = false;
+	}
+	
+	if( indices16 )
+	{
+		sections.push_back( make_pair( (unsigned int)SecIndices16, vector< char >() ) );
+		for( unsigned int i = 0; i < indices.size(); ++i )
+		{
+			unsigned short index = (unsigned short)indices[i];
+			appendData( sections.back().second, &index, sizeof( short ) );
+		}
 
-		for( unsigned int j = 0; j < count; ++j )
+		if( !indexBases.empty() )
 		{
-			fwrite( &_morphTargets[i].diffs[j].vertIndex, sizeof( int ), 1, f );
+			sections.push_back( make_pair( (unsigned int)SecIndexBases, vector< char >() ) );
+			appendData( sections.back().second, &indexBases[0], indexBases.size() * sizeof( int ) );
 		}
+	}
+	else
+	{
+		sections.push_back( make_pair( (unsigned int)SecIndices32, vector< char >() ) );
+		if( !_indices.empty() )
+			appendData( sections.back().second, &_indices[0], _indices.size() * sizeof( int ) );
+	}
+
+	// Morph targets
+	if( !_morphTargets.empty() )
+	{
+		sections.push_back( make_pair( (unsigned int)SecMorphTargets, vector< char >() ) );
+		vector< char > &data = sections.back().second;
 		
-		// Write stream data
-		unsigned int numStreams = 4, streamElemSize;
-		fwrite( &numStreams, sizeof( int ), 1, f );
+		unsigned int numTargets = (unsigned int)_morphTargets.size();
+		appendData( data, &numTargets, sizeof( int ) );
+		
+		for( unsigned int i = 0; i < _morphTargets.size(); ++i )
+		{
+			const vector< MorphDiff > &diffs = _morphTargets[i].diffs;
+			unsigned int numVerts = (unsigned int)diffs.size();
+			
+			appendData( data, _morphTargets[i].name, 256 );
+			appendData( data, &numVerts, sizeof( int ) );
+			if( numVerts == 0 ) continue;
+			
+			for( unsigned int j = 0; j < numVerts; ++j )
+				appendData( data, &diffs[j].vertIndex, sizeof( int ) );
+			
+			appendMorphStream( data, diffs, &MorphDiff::posDiff );
+			appendMorphStream( data, diffs, &MorphDiff::normDiff );
+			appendMorphStream( data, diffs, &MorphDiff::tanDiff );
+			appendMorphStream( data, diffs, &MorphDiff::bitanDiff );
+		}
+	}
 
-		for( unsigned int j = 0; j < 4; ++j )
+	// Culling clusters
+	if( !_clusters.empty() )
+	{
+		sections.push_back( make_pair( (unsigned int)SecClusters, vector< char >() ) );
+		for( unsigned int i = 0; i < _clusters.size(); ++i )
 		{
-			switch( j )
-			{
-			case 0:		// Position
-				fwrite( &j, sizeof( int ), 1, f );
-				streamElemSize = 3 * sizeof( float ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-				for( unsigned int k = 0; k < count; ++k )
-				{
-					fwrite( &_morphTargets[i].diffs[k].posDiff.x, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].posDiff.y, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].posDiff.z, sizeof( float ), 1, f );
-				}
-				break;
-			case 1:		// Normal
-				fwrite( &j, sizeof( int ), 1, f );
-				streamElemSize = 3 * sizeof( float ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-				for( unsigned int k = 0; k < count; ++k )
-				{
-					fwrite( &_morphTargets[i].diffs[k].normDiff.x, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].normDiff.y, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].normDiff.z, sizeof( float ), 1, f );
-				}
-				break;
-			case 2:		// Tangent
-				fwrite( &j, sizeof( int ), 1, f );
-				streamElemSize = 3 * sizeof( float ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-				for( unsigned int k = 0; k < count; ++k )
-				{
-					fwrite( &_morphTargets[i].diffs[k].tanDiff.x, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].tanDiff.y, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].tanDiff.z, sizeof( float ), 1, f );
-				}
-				break;
-			case 3:		// Bitangent
-				fwrite( &j, sizeof( int ), 1, f );
-				streamElemSize = 3 * sizeof( float ); fwrite( &streamElemSize, sizeof( int ), 1, f );
-				for( unsigned int k = 0; k < count; ++k )
-				{
-					fwrite( &_morphTargets[i].diffs[k].bitanDiff.x, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].bitanDiff.y, sizeof( float ), 1, f );
-					fwrite( &_morphTargets[i].diffs[k].bitanDiff.z, sizeof( float ), 1, f );
-				}
-				break;
-			}
+			const Cluster &c = _clusters[i];
+			unsigned int range[2] = { c.first, c.count };
+			float values[10] = { c.bBMin.x, c.bBMin.y, c.bBMin.z, c.bBMax.x, c.bBMax.y, c.bBMax.z,
+			                     c.coneAxis.x, c.coneAxis.y, c.coneAxis.z, c.coneCutoff };
+			appendData( sections.back().second, range, sizeof( range ) );
+			appendData( sections.back().second, values, sizeof( values ) );
 		}
 	}
+
+	// Write header and section table
+	unsigned int version = 6, numSections = (unsigned int)sections.size();
+	fwrite( "H3DG", 4, 1, f );
+	fwrite( &version, sizeof( int ), 1, f );
+	fwrite( &numSections, sizeof( int ), 1, f );
+
+	unsigned int offset = 12 + numSections * 12;
+	for( unsigned int i = 0; i < numSections; ++i )
+	{
+		offset = (offset + 15) & ~15;
+		unsigned int entry[3] = { sections[i].first, offset, (unsigned int)sections[i].second.size() };
+		fwrite( entry, sizeof( entry ), 1, f );
+		offset += entry[2];
+	}
+
+	// Write sections
+	offset = 12 + numSections * 12;
+	for( unsigned int i = 0; i < numSections; ++i )
+	{
+		const char padding[16] = { 0 };
+		fwrite( padding, ((offset + 15) & ~15) - offset, 1, f );
+		offset = (offset + 15) & ~15;
+		
+		if( !sections[i].second.empty() )
+			fwrite( &sections[i].second[0], sections[i].second.size(), 1, f );
+		offset += (unsigned int)sections[i].second.size();
+	}
 	
 	fclose( f );
 
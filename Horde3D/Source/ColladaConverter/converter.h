@@ -27,6 +27,7 @@
 
 #include "daeMain.h"
 #include "utMath.h"
+#include "utSkinning.h"
 
 
 struct Joint;
@@ -64,6 +65,15 @@ struct TriGroup
 };
 
 
+struct Cluster
+{
+	unsigned int  first, count;
+	Vec3f         bBMin, bBMax;
+	Vec3f         coneAxis;  // Average triangle normal
+	float         coneCutoff;  // Sine of cone half angle; 1 if cluster can't be backface culled
+};
+
+
 struct SceneNode
 {
 	bool                        typeJoint;
@@ -141,6 +151,7 @@ private:
 	std::vector< Mesh * >        _meshes;
 	std::vector< Joint * >       _joints;
 	std::vector< MorphTarget >   _morphTargets;
+	std::vector< Cluster >       _clusters;
 
 	float                        _lodDist1, _lodDist2, _lodDist3, _lodDist4;
 	unsigned int                 _frameCount;
@@ -154,6 +165,7 @@ private:
 	                        Matrix4f transAccum, std::vector< Matrix4f > animTransAccum );
 	void calcTangentSpaceBasis( std::vector< Vertex > &vertices );
 	void processJoints();
+	unsigned int splitTriGroup( TriGroup &triGroup, std::vector< TriGroup > &triGroups );
 	void processMeshes( ColladaDocument &doc, bool optimize );
 	bool writeGeometry( const std::string &name );
 	void writeSGNode( const std::string &modelName, SceneNode *node, unsigned int depth, std::ofstream &outf );
@@ -207,3 +207,126 @@ float MeshOptimizer::calcCacheEfficiency( TriGroup &triGroup, vector< unsigned i
 	float atvr = (float)(triGroup.count + misses) / triGroup.count;
 	return atvr;
 }
+
+
+struct CentroidOrder
+{
+	const vector< Vec3f >  &centroids;
+	unsigned int           axis;
+
+	CentroidOrder( const vector< Vec3f > &centroids, unsigned int axis ) :
+		centroids( centroids ), axis( axis ) {}
+	
+	bool operator()( unsigned int t1, unsigned int t2 ) const
+		{ return (&centroids[t1].x)[axis] < (&centroids[t2].x)[axis]; }
+};
+
+
+void MeshOptimizer::buildClusters( TriGroup &triGroup, vector< Vertex > &vertices,
+                                   vector< unsigned int > &indices, vector< Cluster > &clusters )
+{
+	// Split large batches into spatially coherent clusters of triangles that the engine can
+	// cull separately; small batches are culled as a whole anyway
+	
+	unsigned int numTris = triGroup.count / 3;
+	if( numTris < maxClusterSize * 2 ) return;
+
+	vector< Vec3f > centroids( numTris );
+	vector< unsigned int > tris( numTris );
+	for( unsigned int i = 0; i < numTris; ++i )
+	{
+		unsigned int *tri = &indices[triGroup.first + i * 3];
+		centroids[i] = (vertices[tri[0]].pos + vertices[tri[1]].pos + vertices[tri[2]].pos) / 3.0f;
+		tris[i] = i;
+	}
+
+	// Split triangles recursively at the median centroid along the longest axis
+	vector< unsigned int > clusterIds( numTris );
+	vector< pair< unsigned int, unsigned int > > ranges( 1, make_pair( 0u, numTris ) );
+	unsigned int numClusters = 0;
+	while( !ranges.empty() )
+	{
+		unsigned int first = ranges.back().first, last = ranges.back().second;
+		ranges.pop_back();
+
+		if( last - first <= maxClusterSize )
+		{
+			for( unsigned int i = first; i < last; ++i ) clusterIds[tris[i]] = numClusters;
+			++numClusters;
+			continue;
+		}
+		
+		Vec3f bMin = centroids[tris[first]], bMax = bMin;
+		for( unsigned int i = first + 1; i < last; ++i )
+		{
+			const Vec3f &c = centroids[tris[i]];
+			bMin = Vec3f( min( bMin.x, c.x ), min( bMin.y, c.y ), min( bMin.z, c.z ) );
+			bMax = Vec3f( max( bMax.x, c.x ), max( bMax.y, c.y ), max( bMax.z, c.z ) );
+		}
+		Vec3f extent = bMax - bMin;
+		unsigned int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		
+		unsigned int mid = first + (last - first) / 2;
+		nth_element( tris.begin() + first, tris.begin() + mid, tris.begin() + last, CentroidOrder( centroids, axis ) );
+		
+		ranges.push_back( make_pair( mid, last ) );
+		ranges.push_back( make_pair( first, mid ) );
+	}
+
+	// Group triangles by cluster; the vertex cache optimized order is kept within clusters
+	vector< unsigned int > clusterStarts( numClusters + 1, 0 );
+	for( unsigned int i = 0; i < numTris; ++i ) ++clusterStarts[clusterIds[i] + 1];
+	for( unsigned int i = 0; i < numClusters; ++i ) clusterStarts[i + 1] += clusterStarts[i];
+	
+	vector< unsigned int > oldIndices( indices.begin() + triGroup.first, indices.begin() + triGroup.first + numTris * 3 );
+	vector< unsigned int > slots( clusterStarts.begin(), clusterStarts.end() - 1 );
+	for( unsigned int i = 0; i < numTris; ++i )
+	{
+		unsigned int slot = slots[clusterIds[i]]++;
+		for( unsigned int j = 0; j < 3; ++j )
+			indices[triGroup.first + slot * 3 + j] = oldIndices[i * 3 + j];
+	}
+
+	// Calculate bounding box and normal cone of clusters
+	for( unsigned int i = 0; i < numClusters; ++i )
+	{
+		Cluster cluster;
+		cluster.first = triGroup.first + clusterStarts[i] * 3;
+		cluster.count = (clusterStarts[i + 1] - clusterStarts[i]) * 3;
+		cluster.bBMin = vertices[indices[cluster.first]].pos;
+		cluster.bBMax = cluster.bBMin;
+		
+		vector< Vec3f > normals;
+		Vec3f axis;
+		for( unsigned int j = cluster.first; j < cluster.first + cluster.count; j += 3 )
+		{
+			for( unsigned int k = 0; k < 3; ++k )
+			{
+				const Vec3f &pos = vertices[indices[j + k]].pos;
+				cluster.bBMin = Vec3f( min( cluster.bBMin.x, pos.x ), min( cluster.bBMin.y, pos.y ), min( cluster.bBMin.z, pos.z ) );
+				cluster.bBMax = Vec3f( max( cluster.bBMax.x, pos.x ), max( cluster.bBMax.y, pos.y ), max( cluster.bBMax.z, pos.z ) );
+			}
+			
+			// Face normal of counter-clockwise (front facing) triangle
+			Vec3f &v0 = vertices[indices[j]].pos, &v1 = vertices[indices[j + 1]].pos, &v2 = vertices[indices[j + 2]].pos;
+			Vec3f normal = (v1 - v0).cross( v2 - v0 );
+			if( normal.length() <= 0 ) continue;
+			normals.push_back( normal.normalized() );
+			axis += normals.back();
+		}
+
+		cluster.coneCutoff = 1;
+		if( axis.length() > 0 )
+		{
+			cluster.coneAxis = axis.normalized();
+			float minDot = 1;
+			for( unsigned int j = 0; j < normals.size(); ++j )
+				minDot = min( minDot, normals[j].dot( cluster.coneAxis ) );
+			
+			// Cones of 90 degrees and more contain front faces from every view point
+			if( minDot > 0 ) cluster.coneCutoff = sqrtf( 1 - minDot * minDot );
+		}
+
+		clusters.push_back( cluster );
+	}
+}
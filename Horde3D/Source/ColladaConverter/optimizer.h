@@ -31,6 +31,7 @@
 
 struct TriGroup;
 struct Vertex;
+struct Cluster;
 struct OptFace;
 
 
@@ -55,6 +56,7 @@ class MeshOptimizer
 public:
 
 	static const int maxCacheSize = 16;
+	static const unsigned int maxClusterSize = 256;  // Triangles
 	
 	static unsigned int removeDegeneratedTriangles( TriGroup &triGroup, std::vector< Vertex > &vertices,
 	                                                std::vector< unsigned int > &indices );
@@ -62,6 +64,8 @@ public:
                                       const unsigned int cacheSize = maxCacheSize );
 	static void optimizeIndexOrder( TriGroup &triGroup, std::vector< Vertex > &vertices,
 	                                std::vector< unsigned int > &indices );
+	static void buildClusters( TriGroup &triGroup, std::vector< Vertex > &vertices,
+	                           std::vector< unsigned int > &indices, std::vector< Cluster > &clusters );
 };
 
 #endif	// _optimizer_H_
@@ -35,9 +35,9 @@ using namespace std;
 // *************************************************************************************************
 
 MeshNode::MeshNode( const MeshNodeTpl &meshTpl ) :
-	AnimatableSceneNode( meshTpl ), _bBoxDirty( true ),
-	_materialRes( meshTpl.matRes ), _batchStart( meshTpl.batchStart ), _batchCount( meshTpl.batchCount ),
-	_vertRStart( meshTpl.vertRStart ), _vertREnd( meshTpl.vertREnd ), _lodLevel( meshTpl.lodLevel )
+	AnimatableSceneNode( meshTpl ), _materialRes( meshTpl.matRes ), _batchStart( meshTpl.batchStart ),
+	_batchCount( meshTpl.batchCount ), _vertRStart( meshTpl.vertRStart ), _vertREnd( meshTpl.vertREnd ),
+	_lodLevel( meshTpl.lodLevel ), _bBoxDirty( true ), _jointBBoxesDirty( true ), _staticBatched( false )
 {
 }
 
@@ -90,14 +90,69 @@ SceneNode *MeshNode::factoryFunc( const SceneNodeTpl &nodeTpl )
 }
 
 
-void MeshNode::markBBoxesDirty()
+void MeshNode::markBBoxesDirty( bool geometryChanged )
 {
 	_bBoxDirty = true;
+	if( geometryChanged ) _jointBBoxesDirty = true;
 	
 	for( size_t i = 0, s = _children.size(); i < s; ++i )
 	{
 		if( _children[i]->getType() == SceneNodeTypes::Mesh )
-			((MeshNode *)_children[i])->markBBoxesDirty();
+			((MeshNode *)_children[i])->markBBoxesDirty( geometryChanged );
+	}
+}
+
+
+void MeshNode::calcJointBBoxes( GeometryResource *geoRes, const Vec3f *positions )
+{
+	// Boxes are built from untransformed geometry positions, which is the space skinned vertices are
+	// placed from by the absolute transformation of the mesh (including its relative transformation)
+	vector< int > jointSlots( geoRes->_joints.size(), -1 );
+	
+	_jointBBoxes.resize( 0 );
+	_jointBBoxesDirty = false;
+
+	if( positions == 0x0 )
+	{
+		_jointBBoxes.push_back( MeshJointBBox() );
+		_jointBBoxes.back().jointIndex = 0;
+		geoRes->getRangeBounds( _vertRStart, _vertREnd, _jointBBoxes.back().minCoords,
+		                        _jointBBoxes.back().maxCoords );
+		return;
+	}
+
+	VertexData &vd = *geoRes->getVertData();
+	for( uint32 i = _vertRStart; i <= _vertREnd; ++i )
+	{
+		const Vec3f &vertPos = positions[i];
+		
+		for( uint32 j = 0; j < 4; ++j )
+		{
+			if( vd.staticData[i].weightVec[j] <= 0 ) continue;
+			
+			uint32 jointIndex = geoRes->_jointIndices[i * 4 + j];
+			if( jointIndex >= jointSlots.size() ) continue;
+
+			if( jointSlots[jointIndex] < 0 )
+			{
+				jointSlots[jointIndex] = (int)_jointBBoxes.size();
+				_jointBBoxes.push_back( MeshJointBBox() );
+				_jointBBoxes.back().jointIndex = jointIndex;
+				_jointBBoxes.back().minCoords = vertPos;
+				_jointBBoxes.back().maxCoords = vertPos;
+				continue;
+			}
+
+			Vec3f &bBMin = _jointBBoxes[jointSlots[jointIndex]].minCoords;
+			Vec3f &bBMax = _jointBBoxes[jointSlots[jointIndex]].maxCoords;
+			
+			if( vertPos.x < bBMin.x ) bBMin.x = vertPos.x;
+			if( vertPos.y < bBMin.y ) bBMin.y = vertPos.y;
+			if( vertPos.z < bBMin.z ) bBMin.z = vertPos.z;
+			if( vertPos.x > bBMax.x ) bBMax.x = vertPos.x;
+			if( vertPos.y > bBMax.y ) bBMax.y = vertPos.y;
+			if( vertPos.z > bBMax.z ) bBMax.z = vertPos.z;
+		}
 	}
 }
 
@@ -148,9 +203,11 @@ bool MeshNode::setParami( int param, int value )
 			return false;
 		}
 		_materialRes = (MaterialResource *)res;
+		if( _staticBatched ) Modules::renderer().clearStaticBatches();
 		return true;
 	case MeshNodeParams::LodLevel:
 		_lodLevel = value;
+		if( _staticBatched ) Modules::renderer().clearStaticBatches();
 		return true;
 	default:
 		return SceneNode::setParami( param, value );
@@ -158,13 +215,55 @@ bool MeshNode::setParami( int param, int value )
 }
 
 
+bool MeshNode::isStaticBatchable()
+{
+	if( _parentModel == 0x0 || !_active || !_parentModel->_active ) return false;
+	
+	// Only meshes whose vertices are fully defined by the node transformation can be merged
+	GeometryResource *geoRes = _parentModel->getGeometryResource();
+	if( geoRes == 0x0 || _materialRes == 0x0 ) return false;
+	if( _parentModel->_lodDist1 != Math::MaxFloat || _lodLevel != 0 ) return false;
+	if( !_parentModel->_skeleton.empty() || geoRes->_joints.size() > 1 || !geoRes->_morphTargets.empty() ||
+	    _parentModel->_softwareSkinning || _parentModel->_dynVertData != 0x0 )
+		return false;
+
+	// Alpha blended meshes have to be drawn in back to front order (additive passes are order independent)
+	ShaderResource *shaderRes = _materialRes->_shaderRes;
+	if( shaderRes != 0x0 )
+	{
+		for( size_t i = 0, s = shaderRes->getContexts().size(); i < s; ++i )
+		{
+			int blendMode = shaderRes->getContexts()[i].blendMode;
+			if( blendMode == BlendModes::Blend || blendMode == BlendModes::AddBlended ) return false;
+		}
+	}
+
+	// Large meshes don't benefit from merging and have to fit into a cell
+	if( _vertREnd < _vertRStart || _vertREnd >= geoRes->getVertCount() ||
+	    _vertREnd - _vertRStart + 1 > MaxStaticBatchVerts ||
+	    _batchCount == 0 || _batchStart + _batchCount > geoRes->_indices.size() )
+		return false;
+
+	for( uint32 i = _batchStart; i < _batchStart + _batchCount; ++i )
+	{
+		if( geoRes->_indices[i] < _vertRStart || geoRes->_indices[i] > _vertREnd ) return false;
+	}
+
+	return true;
+}
+
+
 bool MeshNode::checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, Vec3f &intsPos ) const
 {
 	// Collision check is only done for base LOD
 	if( _lodLevel != 0 ) return false;
+
+	// Parent model is tested with its joint hitboxes instead
+	if( _parentModel->usesJointHitboxes() ) return false;
 	
 	GeometryResource *geoRes = _parentModel->getGeometryResource();
-	if( geoRes == 0x0 || geoRes->getVertData() == 0x0 ) return false;
+	Vec3f *positions = _parentModel->getVertPositions();
+	if( positions == 0x0 ) return false;
 	
 	// Transform ray to local space
 	Matrix4f m = _absTrans.inverted();
@@ -177,9 +276,9 @@ bool MeshNode::checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, Vec
 	// Check triangles
 	for( uint32 i = _batchStart; i < _batchStart + _batchCount; i += 3 )
 	{
-		Vec3f &vert0 = geoRes->getVertData()->positions[geoRes->_indices[i + 0]];
-		Vec3f &vert1 = geoRes->getVertData()->positions[geoRes->_indices[i + 1]];
-		Vec3f &vert2 = geoRes->getVertData()->positions[geoRes->_indices[i + 2]];
+		Vec3f &vert0 = positions[geoRes->_indices[i + 0]];
+		Vec3f &vert1 = positions[geoRes->_indices[i + 1]];
+		Vec3f &vert2 = positions[geoRes->_indices[i + 2]];
 		
 		if( rayTriangleIntersection( orig, dir, vert0, vert1, vert2, intsPos ) )
 		{
@@ -210,6 +309,20 @@ void MeshNode::onAttach( SceneNode &parentNode )
 void MeshNode::onDetach( SceneNode &/*parentNode*/ )
 {
 	if( _parentModel != 0x0 ) _parentModel->markNodeListDirty();
+	if( _staticBatched ) Modules::renderer().clearStaticBatches();
+}
+
+
+void MeshNode::onPostUpdate()
+{
+	// Static batches hold pre-transformed copies of the meshes, so any change invalidates them
+	if( _staticBatched ) Modules::renderer().clearStaticBatches();
+}
+
+
+void MeshNode::onActivationChanged()
+{
+	if( _staticBatched ) Modules::renderer().clearStaticBatches();
 }
 
 
@@ -222,7 +335,7 @@ void MeshNode::onPreUpdate()
 		_bBoxDirty = false;
 		
 		GeometryResource *geoRes = _parentModel->getGeometryResource();
-		if( geoRes == 0x0 || geoRes->getVertData() == 0x0 ) return;
+		if( geoRes == 0x0 || geoRes->getVertCount() == 0 ) return;
 
 		Vec3f &bBMin = _localBBox.getMinCoords();
 		Vec3f &bBMax = _localBBox.getMaxCoords();
@@ -231,16 +344,98 @@ void MeshNode::onPreUpdate()
 		{
 			bBMin = Vec3f( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat );
 			bBMax = Vec3f( -Math::MaxFloat, -Math::MaxFloat, -Math::MaxFloat );
-			for( uint32 i = _vertRStart; i <= _vertREnd; ++i )
+
+			// Skinned positions of morphed geometry and dual quaternion blends are not bounded by
+			// transformed bind pose data
+			bool skinnedMorphs = _parentModel->_softwareSkinning &&
+				(_parentModel->_morpherUsed || _parentModel->_dualQuatSkinning);
+			
+			if( !skinnedMorphs && !_parentModel->_skinMatRows.empty() )
+			{
+				// Transform bind pose bounding boxes of joints by current skinning matrices; since
+				// skinned vertices are a weighted average of the transformed positions, the union of the
+				// transformed boxes is a conservative bound (joint nodes are updated before meshes);
+				// the result is in mesh space like the skinned vertices, so that the relative transformation
+				// of the mesh is applied with its absolute transformation in SceneNode::update
+				if( _jointBBoxesDirty )
+				{
+					// Private streams hold skinned positions with software skinning; static geometry
+					// without CPU copy is bounded by the default joint
+					if( !geoRes->hasCPUData() && !_parentModel->_softwareSkinning )
+						calcJointBBoxes( geoRes, 0x0 );
+					else
+						calcJointBBoxes( geoRes, _parentModel->_softwareSkinning ?
+							geoRes->getVertData()->positions : _parentModel->getVertPositions() );
+				}
+
+				const Vec4f *rows = &_parentModel->_skinMatRows[0];
+				for( size_t i = 0, s = _jointBBoxes.size(); i < s; ++i )
+				{
+					MeshJointBBox &jb = _jointBBoxes[i];
+					if( !_parentModel->jointExists( jb.jointIndex ) ) continue;
+					
+					const Vec4f *row = &rows[jb.jointIndex * 3];
+					float minA[3] = { jb.minCoords.x, jb.minCoords.y, jb.minCoords.z };
+					float maxA[3] = { jb.maxCoords.x, jb.maxCoords.y, jb.maxCoords.z };
+					float minB[3], maxB[3];
+
+					// Efficient algorithm for transforming an AABB, taken from Graphics Gems
+					for( uint32 j = 0; j < 3; ++j )
+					{
+						float rowVals[3] = { row[j].x, row[j].y, row[j].z };
+						minB[j] = row[j].w;
+						maxB[j] = row[j].w;
+						
+						for( uint32 k = 0; k < 3; ++k )
+						{
+							float x = minA[k] * rowVals[k];
+							float y = maxA[k] * rowVals[k];
+							minB[j] += minf( x, y );
+							maxB[j] += maxf( x, y );
+						}
+					}
+
+					if( minB[0] < bBMin.x ) bBMin.x = minB[0];
+					if( minB[1] < bBMin.y ) bBMin.y = minB[1];
+					if( minB[2] < bBMin.z ) bBMin.z = minB[2];
+					if( maxB[0] > bBMax.x ) bBMax.x = maxB[0];
+					if( maxB[1] > bBMax.y ) bBMax.y = maxB[1];
+					if( maxB[2] > bBMax.z ) bBMax.z = maxB[2];
+				}
+
+				// Dual quaternion blends move vertices on a screw motion between the transformed
+				// positions instead of the straight line, so they can leave the union of the boxes; for
+				// two joints the distance to the line is at most half the distance of its end points.
+				// Hardware skinning uses dual quaternions if the shader requires them, so the bounds are
+				// expanded once they were computed for the model
+				if( !_parentModel->_skinDualQuats.empty() && bBMin.x <= bBMax.x )
+				{
+					float margin = (bBMax - bBMin).length() * 0.5f;
+					bBMin = bBMin - Vec3f( margin, margin, margin );
+					bBMax = bBMax + Vec3f( margin, margin, margin );
+				}
+			}
+			else
+			{
+				Vec3f *positions = _parentModel->getVertPositions();
+				for( uint32 i = _vertRStart; i <= _vertREnd; ++i )
+				{
+					Vec3f &vertPos = positions[i];
+
+					if( vertPos.x < bBMin.x ) bBMin.x = vertPos.x;
+					if( vertPos.y < bBMin.y ) bBMin.y = vertPos.y;
+					if( vertPos.z < bBMin.z ) bBMin.z = vertPos.z;
+					if( vertPos.x > bBMax.x ) bBMax.x = vertPos.x;
+					if( vertPos.y > bBMax.y ) bBMax.y = vertPos.y;
+					if( vertPos.z > bBMax.z ) bBMax.z = vertPos.z;
+				}
+			}
+
+			if( bBMin.x > bBMax.x )
 			{
-				Vec3f &vertPos = geoRes->getVertData()->positions[i];
-
-				if( vertPos.x < bBMin.x ) bBMin.x = vertPos.x;
-				if( vertPos.y < bBMin.y ) bBMin.y = vertPos.y;
-				if( vertPos.z < bBMin.z ) bBMin.z = vertPos.z;
-				if( vertPos.x > bBMax.x ) bBMax.x = vertPos.x;
-				if( vertPos.y > bBMax.y ) bBMax.y = vertPos.y;
-				if( vertPos.z > bBMax.z ) bBMax.z = vertPos.z;
+				// No vertex is influenced by a valid joint
+				bBMin = Vec3f( 0, 0, 0 );
+				bBMax = Vec3f( 0, 0, 0 );
 			}
 
 			// Avoid zero box dimensions for planes
@@ -262,7 +457,7 @@ void MeshNode::onPreUpdate()
 // *************************************************************************************************
 
 JointNode::JointNode( const JointNodeTpl &jointTpl ) :
-	AnimatableSceneNode( jointTpl ), _jointIndex( jointTpl.jointIndex )
+	AnimatableSceneNode( jointTpl ), _jointIndex( jointTpl.jointIndex ), _skelIndex( (uint32)-1 )
 {
 }
 
@@ -317,6 +512,8 @@ int JointNode::getParami( int param )
 
 void JointNode::onPostUpdate()
 {
+	// Joints of the skeleton are updated by the model
+	if( _skelIndex != (uint32)-1 ) return;
 	if( _parentModel->getGeometryResource() == 0x0 ) return;
 	
 	if( _parent->getType() != SceneNodeTypes::Joint )
@@ -341,11 +538,20 @@ void JointNode::onAttach( SceneNode &parentNode )
 	while( node->getType() != SceneNodeTypes::Model ) node = node->getParent();
 	_parentModel = (ModelNode *)node;
 	
-	_parentModel->markNodeListDirty();
+	if( _skelIndex == (uint32)-1 ) _parentModel->markNodeListDirty();
 }
 
 
 void JointNode::onDetach( SceneNode &/*parentNode*/ )
 {
-	if( _parentModel != 0x0 ) _parentModel->markNodeListDirty();
+	if( _parentModel == 0x0 ) return;
+	
+	if( _skelIndex != (uint32)-1 )
+	{
+		// Skeleton joint keeps being animated without node; a relocated node becomes a regular joint
+		_parentModel->_skeleton[_skelIndex].node = 0x0;
+		_skelIndex = (uint32)-1;
+	}
+	else
+		_parentModel->markNodeListDirty();
 }
@@ -28,6 +28,7 @@
 #include "egPrerequisites.h"
 #include "egScene.h"
 #include "egMaterial.h"
+#include "egGeometry.h"
 #include "utMath.h"
 
 class ModelNode;
@@ -89,26 +90,37 @@ struct MeshNodeTpl : public SceneNodeTpl
 
 // =================================================================================================
 
+struct MeshJointBBox
+{
+	uint32  jointIndex;
+	Vec3f   minCoords, maxCoords;  // Bind pose bounds of vertices influenced by joint
+};
+
+// =================================================================================================
+
 class MeshNode : public AnimatableSceneNode
 {
 protected:
 
-	PMaterialResource   _materialRes;
-	uint32              _batchStart, _batchCount;
-	uint32              _vertRStart, _vertREnd;
-	uint32              _lodLevel;
+	PMaterialResource             _materialRes;
+	uint32                        _batchStart, _batchCount;
+	uint32                        _vertRStart, _vertREnd;
+	uint32                        _lodLevel;
 	
-	BoundingBox         _localBBox;
-	bool                _bBoxDirty;
+	BoundingBox                   _localBBox;
+	std::vector< MeshJointBBox >  _jointBBoxes;
+	bool                          _bBoxDirty, _jointBBoxesDirty;
+	bool                          _staticBatched;  // Mesh is drawn as part of a static batch
 
 	MeshNode( const MeshNodeTpl &meshTpl );
+	void calcJointBBoxes( GeometryResource *geoRes, const Vec3f *positions );
 
 public:
 
 	static SceneNodeTpl *parsingFunc( std::map< std::string, std::string > &attribs );
 	static SceneNode *factoryFunc( const SceneNodeTpl &nodeTpl );
 
-	void markBBoxesDirty();
+	void markBBoxesDirty( bool geometryChanged );
 	BoundingBox *getLocalBBox() { return &_localBBox; }
 	bool canAttach( SceneNode &parent );
 	int getParami( int param );
@@ -118,6 +130,8 @@ public:
 	void onAttach( SceneNode &parentNode );
 	void onDetach( SceneNode &parentNode );
 	void onPreUpdate();
+	void onPostUpdate();
+	void onActivationChanged();
 
 	MaterialResource *getMaterialRes() { return _materialRes; }
 	uint32 getBatchStart() { return _batchStart; }
@@ -125,8 +139,12 @@ public:
 	uint32 getVertRStart() { return _vertRStart; }
 	uint32 getVertREnd() { return _vertREnd; }
 	uint32 getLodLevel() { return _lodLevel; }
+	ModelNode *getParentModel() { return _parentModel; }
+	bool isStaticBatched() { return _staticBatched; }
+	bool isStaticBatchable();
 
 	friend class ModelNode;
+	friend class Renderer;
 };
 
 
@@ -161,6 +179,7 @@ class JointNode : public AnimatableSceneNode
 protected:
 
 	uint32    _jointIndex;
+	uint32    _skelIndex;  // Index in skeleton of parent model (-1: joint is not part of skeleton)
 	Matrix4f  _relModelMat;  // Transformation relative to parent model
 
 	JointNode( const JointNodeTpl &jointTpl );
@@ -177,6 +196,9 @@ public:
 	void onAttach( SceneNode &parentNode );
 	void onDetach( SceneNode &parentNode );
 
+	ModelNode *getParentModel() { return _parentModel; }
+	uint32 getSkelIndex() { return _skelIndex; }
+
 	friend class ModelNode;
 };
 
@@ -47,6 +47,10 @@ EngineConfig::EngineConfig()
 	wireframeMode = false;
 	debugViewMode = false;
 	dumpFailedShaders = false;
+	animationCulling = false;
+	vertexCompression = false;
+	gpuOnlyGeometry = false;
+	dynamicBatchSize = 0;
 }
 
 
@@ -78,6 +82,14 @@ float EngineConfig::getOption( EngineOptions::List param )
 		return debugViewMode ? 1.0f : 0.0f;
 	case EngineOptions::DumpFailedShaders:
 		return dumpFailedShaders ? 1.0f : 0.0f;
+	case EngineOptions::AnimationCulling:
+		return animationCulling ? 1.0f : 0.0f;
+	case EngineOptions::VertexCompression:
+		return vertexCompression ? 1.0f : 0.0f;
+	case EngineOptions::GPUOnlyGeometry:
+		return gpuOnlyGeometry ? 1.0f : 0.0f;
+	case EngineOptions::DynamicBatchSize:
+		return (float)dynamicBatchSize;
 	default:
 		return Math::NaN;
 	}
@@ -144,6 +156,18 @@ bool EngineConfig::setOption( EngineOptions::List param, float value )
 	case EngineOptions::DumpFailedShaders:
 		dumpFailedShaders = (value != 0);
 		return true;
+	case EngineOptions::AnimationCulling:
+		animationCulling = (value != 0);
+		return true;
+	case EngineOptions::VertexCompression:
+		vertexCompression = (value != 0);
+		return true;
+	case EngineOptions::GPUOnlyGeometry:
+		gpuOnlyGeometry = (value != 0);
+		return true;
+	case EngineOptions::DynamicBatchSize:
+		dynamicBatchSize = ftoi_r( value );
+		return true;
 	default:
 		return false;
 	}
@@ -247,6 +271,21 @@ StatManager::StatManager()
 	_statTriCount = 0;
 	_statBatchCount = 0;
 	_statLightPassCount = 0;
+	_statAnimFullCount = 0;
+	_statAnimReducedCount = 0;
+	_statAnimSkippedCount = 0;
+	_statGeoUploadSize = 0;
+	_statClusterTriCount = 0;
+	_statClusterRatioTriCount = 0;
+	_statClusterCulledTriCount = 0;
+	_statDynBatchSavedCount = 0;
+	_statInstanceSavedCount = 0;
+	_statShaderBindCount = 0;
+	_statMaterialBindCount = 0;
+	_statTextureBindCount = 0;
+	_statBufferBindCount = 0;
+	_statStateCallCount = 0;
+	_statStateCallFilteredCount = 0;
 
 	_frameTime = 0;
 }
@@ -270,6 +309,70 @@ float StatManager::getStat( int param, bool reset )
 		value = (float)_statLightPassCount;
 		if( reset ) _statLightPassCount = 0;
 		return value;
+	case EngineStats::AnimFullCount:
+		value = (float)_statAnimFullCount;
+		if( reset ) _statAnimFullCount = 0;
+		return value;
+	case EngineStats::AnimReducedCount:
+		value = (float)_statAnimReducedCount;
+		if( reset ) _statAnimReducedCount = 0;
+		return value;
+	case EngineStats::AnimSkippedCount:
+		value = (float)_statAnimSkippedCount;
+		if( reset ) _statAnimSkippedCount = 0;
+		return value;
+	case EngineStats::GeoUploadSize:
+		value = (float)_statGeoUploadSize;
+		if( reset ) _statGeoUploadSize = 0;
+		return value;
+	case EngineStats::ClusterTriCount:
+		value = (float)_statClusterTriCount;
+		if( reset ) _statClusterTriCount = 0;
+		return value;
+	case EngineStats::ClusterCullRatio:
+		value = _statClusterRatioTriCount > 0 ? _statClusterCulledTriCount / (float)_statClusterRatioTriCount : 0;
+		if( reset )
+		{
+			_statClusterRatioTriCount = 0;
+			_statClusterCulledTriCount = 0;
+		}
+		return value;
+	case EngineStats::DynBatchSavedCount:
+		value = (float)_statDynBatchSavedCount;
+		if( reset ) _statDynBatchSavedCount = 0;
+		return value;
+	case EngineStats::DynBatchTime:
+		value = _dynBatchTimer.getElapsedTimeMS();
+		if( reset ) _dynBatchTimer.reset();
+		return value;
+	case EngineStats::InstanceSavedCount:
+		value = (float)_statInstanceSavedCount;
+		if( reset ) _statInstanceSavedCount = 0;
+		return value;
+	case EngineStats::ShaderBindCount:
+		value = (float)_statShaderBindCount;
+		if( reset ) _statShaderBindCount = 0;
+		return value;
+	case EngineStats::MaterialBindCount:
+		value = (float)_statMaterialBindCount;
+		if( reset ) _statMaterialBindCount = 0;
+		return value;
+	case EngineStats::TextureBindCount:
+		value = (float)_statTextureBindCount;
+		if( reset ) _statTextureBindCount = 0;
+		return value;
+	case EngineStats::BufferBindCount:
+		value = (float)_statBufferBindCount;
+		if( reset ) _statBufferBindCount = 0;
+		return value;
+	case EngineStats::StateCallCount:
+		value = (float)_statStateCallCount;
+		if( reset ) _statStateCallCount = 0;
+		return value;
+	case EngineStats::StateCallFilteredCount:
+		value = (float)_statStateCallFilteredCount;
+		if( reset ) _statStateCallFilteredCount = 0;
+		return value;
 	case EngineStats::FrameTime:
 		value = _frameTime;
 		if( reset ) _frameTime = 0;
@@ -297,6 +400,50 @@ void StatManager::incStat( int param, float value )
 	case EngineStats::LightPassCount:
 		_statLightPassCount += ftoi_r( value );
 		break;
+	case EngineStats::AnimFullCount:
+		_statAnimFullCount += ftoi_r( value );
+		break;
+	case EngineStats::AnimReducedCount:
+		_statAnimReducedCount += ftoi_r( value );
+		break;
+	case EngineStats::AnimSkippedCount:
+		_statAnimSkippedCount += ftoi_r( value );
+		break;
+	case EngineStats::GeoUploadSize:
+		_statGeoUploadSize += ftoi_r( value );
+		break;
+	case EngineStats::ClusterTriCount:
+		// The ratio keeps its own total so that both stats can be reset independently
+		_statClusterTriCount += ftoi_r( value );
+		_statClusterRatioTriCount += ftoi_r( value );
+		break;
+	case EngineStats::ClusterCullRatio:
+		_statClusterCulledTriCount += ftoi_r( value );
+		break;
+	case EngineStats::DynBatchSavedCount:
+		_statDynBatchSavedCount += ftoi_r( value );
+		break;
+	case EngineStats::InstanceSavedCount:
+		_statInstanceSavedCount += ftoi_r( value );
+		break;
+	case EngineStats::ShaderBindCount:
+		_statShaderBindCount += ftoi_r( value );
+		break;
+	case EngineStats::MaterialBindCount:
+		_statMaterialBindCount += ftoi_r( value );
+		break;
+	case EngineStats::TextureBindCount:
+		_statTextureBindCount += ftoi_r( value );
+		break;
+	case EngineStats::BufferBindCount:
+		_statBufferBindCount += ftoi_r( value );
+		break;
+	case EngineStats::StateCallCount:
+		_statStateCallCount += ftoi_r( value );
+		break;
+	case EngineStats::StateCallFilteredCount:
+		_statStateCallFilteredCount += ftoi_r( value );
+		break;
 	case EngineStats::FrameTime:
 		_frameTime += value;
 		break;
@@ -312,6 +459,8 @@ Timer *StatManager::getTimer( int param )
 		return &_frameTimer;
 	case EngineStats::CustomTime:
 		return &_customTimer;
+	case EngineStats::DynBatchTime:
+		return &_dynBatchTimer;
 	default:
 		return 0x0;
 	}
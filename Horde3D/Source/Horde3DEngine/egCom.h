@@ -56,7 +56,11 @@ struct EngineOptions
 		SampleCount,
 		WireframeMode,
 		DebugViewMode,
-		DumpFailedShaders
+		DumpFailedShaders,
+		AnimationCulling,
+		VertexCompression,
+		GPUOnlyGeometry,
+		DynamicBatchSize
 	};
 };
 
@@ -78,6 +82,10 @@ public:
 	bool  wireframeMode;
 	bool  debugViewMode;
 	bool  dumpFailedShaders;
+	bool  animationCulling;
+	bool  vertexCompression;
+	bool  gpuOnlyGeometry;
+	int   dynamicBatchSize;
 
 
 	EngineConfig();
@@ -149,7 +157,22 @@ struct EngineStats
 		BatchCount,
 		LightPassCount,
 		FrameTime,
-		CustomTime
+		CustomTime,
+		AnimFullCount,
+		AnimReducedCount,
+		AnimSkippedCount,
+		GeoUploadSize,
+		ClusterTriCount,
+		ClusterCullRatio,  // Incremented with number of culled cluster triangles
+		DynBatchSavedCount,
+		DynBatchTime,
+		InstanceSavedCount,
+		ShaderBindCount,
+		MaterialBindCount,
+		TextureBindCount,
+		BufferBindCount,
+		StateCallCount,
+		StateCallFilteredCount
 	};
 };
 
@@ -162,9 +185,21 @@ protected:
 	uint32  _statTriCount;
 	uint32  _statBatchCount;
 	uint32  _statLightPassCount;
+	uint32  _statAnimFullCount;
+	uint32  _statAnimReducedCount;
+	uint32  _statAnimSkippedCount;
+	uint32  _statGeoUploadSize;
+	uint32  _statClusterTriCount;
+	uint32  _statClusterRatioTriCount, _statClusterCulledTriCount;
+	uint32  _statDynBatchSavedCount;
+	uint32  _statInstanceSavedCount;
+	uint32  _statShaderBindCount, _statMaterialBindCount;
+	uint32  _statTextureBindCount, _statBufferBindCount;
+	uint32  _statStateCallCount, _statStateCallFilteredCount;
 
 	Timer   _frameTimer;
 	Timer   _customTimer;
+	Timer   _dynBatchTimer;
 	float   _frameTime;
 
 public:
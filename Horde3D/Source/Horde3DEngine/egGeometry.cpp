@@ -65,14 +65,21 @@ Resource *GeometryResource::clone()
 {
 	GeometryResource *res = new GeometryResource( "", _flags );
 
+	// Clones are usually modified, so they keep the CPU copy
+	bool cpuDataReleased = _cpuDataReleased;
+	if( cpuDataReleased ) restoreCPUData();
+	
 	*res = *this;
 
 	// Make a deep copy of the data
 	res->_vertData = new VertexData( _vertCount );
 	memcpy( res->_vertData->memory, _vertData->memory,
 			_vertCount * (sizeof( Vec3f ) * 4 + sizeof( VertexDataStatic ) ) );
-	res->_vertBuffer = Modules::renderer().cloneVertexBuffer( _vertBuffer );
+	res->_dynVertBuffer = Modules::renderer().cloneVertexBuffer( _dynVertBuffer );
+	res->_staticVertBuffer = Modules::renderer().cloneVertexBuffer( _staticVertBuffer );
 	res->_indexBuffer = Modules::renderer().cloneIndexBuffer( _indexBuffer );
+
+	if( cpuDataReleased ) releaseCPUData();
 	
 	return res;
 }
@@ -83,7 +90,14 @@ void GeometryResource::initDefault()
 	_vertCount = 0;
 	_vertData = 0x0;
 	_16BitIndices = false;
-	_vertBuffer = defVertBuffer;
+	_compactVertData = false;
+	_quantizedPositions = false;
+	_packedBasis = false;
+	_posDequantMat = Matrix4f();
+	_indexCount = 0;
+	_cpuDataReleased = false;
+	_dynVertBuffer = defVertBuffer;
+	_staticVertBuffer = defVertBuffer;
 	_indexBuffer = defIndexBuffer;
 	_minMorphIndex = 0; _maxMorphIndex = 0;
 }
@@ -91,10 +105,16 @@ void GeometryResource::initDefault()
 
 void GeometryResource::release()
 {
-	if( _vertBuffer != 0 && _vertBuffer != defVertBuffer )
+	if( _dynVertBuffer != 0 && _dynVertBuffer != defVertBuffer )
+	{
+		Modules::renderer().unloadBuffers( _dynVertBuffer, 0 );
+		_dynVertBuffer = 0;
+	}
+
+	if( _staticVertBuffer != 0 && _staticVertBuffer != defVertBuffer )
 	{
-		Modules::renderer().unloadBuffers( _vertBuffer, 0 );
-		_vertBuffer = 0;
+		Modules::renderer().unloadBuffers( _staticVertBuffer, 0 );
+		_staticVertBuffer = 0;
 	}
 	
 	if( _indexBuffer != 0 && _indexBuffer != defIndexBuffer )
@@ -104,9 +124,16 @@ void GeometryResource::release()
 	}
 
 	delete _vertData; _vertData = 0x0;
+	_jointIndices.clear();
 	_indices.clear();
+	_indexBases.clear();
+	_vertBlockBounds.clear();
+	_clusters.clear();
+	_cpuDataReleased = false;
 	_joints.clear();
 	_morphTargets.clear();
+	_jointPalettes.clear();
+	_jointHitboxes.clear();
 }
 
 
@@ -140,14 +167,15 @@ bool GeometryResource::load( const char *data, int size )
 
 	uint32 version;
 	memcpy( &version, myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
-	if( version != 5 ) return raiseError( "Unsupported version of geometry file" );
+	if( version != 5 && version != 6 ) return raiseError( "Unsupported version of geometry file" );
+	if( version == 6 ) return loadSections( data, size );
 
 	// Load joints
 	uint32 count;
 	memcpy( &count, myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
 
-	if( count > 75 )
-		Modules::log().writeWarning( "Geometry resource '%s': Model has more than 75 joints; this may cause defective behavior", _name.c_str() );
+	if( count > MaxJointsPerBatch )
+		Modules::log().writeWarning( "Geometry resource '%s': Model has more than %i joints; meshes are drawn with joint palettes", _name.c_str(), MaxJointsPerBatch );
 
 	_joints.resize( count );
 	for( uint32 i = 0; i < count; ++i )
@@ -168,6 +196,7 @@ bool GeometryResource::load( const char *data, int size )
 
 	_vertCount = streamSize;
 	_vertData = new VertexData( streamSize );
+	_jointIndices.resize( streamSize * 4, 0 );
 	for( uint32 i = 0; i < count; ++i )
 	{
 		unsigned char uc;
@@ -218,10 +247,11 @@ bool GeometryResource::load( const char *data, int size )
 			if( streamElemSize != 4 ) return raiseError( "Invalid joint stream" );
 			for( uint32 j = 0; j < streamSize; ++j )
 			{
-				memcpy( &uc, myData, sizeof( char ) ); myData += sizeof( char ); _vertData->staticData[j].jointVec[0] = (float)uc;
-				memcpy( &uc, myData, sizeof( char ) ); myData += sizeof( char ); _vertData->staticData[j].jointVec[1] = (float)uc;
-				memcpy( &uc, myData, sizeof( char ) ); myData += sizeof( char ); _vertData->staticData[j].jointVec[2] = (float)uc;
-				memcpy( &uc, myData, sizeof( char ) ); myData += sizeof( char ); _vertData->staticData[j].jointVec[3] = (float)uc;
+				memcpy( &_jointIndices[j * 4], myData, 4 ); myData += 4;
+				_vertData->staticData[j].jointVec[0] = (float)_jointIndices[j * 4 + 0];
+				_vertData->staticData[j].jointVec[1] = (float)_jointIndices[j * 4 + 1];
+				_vertData->staticData[j].jointVec[2] = (float)_jointIndices[j * 4 + 2];
+				_vertData->staticData[j].jointVec[3] = (float)_jointIndices[j * 4 + 3];
 			}
 			break;
 		case 5:		// Weights
@@ -256,6 +286,23 @@ bool GeometryResource::load( const char *data, int size )
 			continue;
 		}
 	}
+
+	// Sort joint influences by descending weight so that the first one or two of them can be used
+	// as reduced influence set for skinning LOD
+	for( uint32 i = 0; i < streamSize; ++i )
+	{
+		VertexDataStatic &sd = _vertData->staticData[i];
+		
+		for( uint32 j = 1; j < 4; ++j )
+		{
+			for( uint32 k = j; k > 0 && sd.weightVec[k] > sd.weightVec[k - 1]; --k )
+			{
+				std::swap( sd.weightVec[k], sd.weightVec[k - 1] );
+				std::swap( sd.jointVec[k], sd.jointVec[k - 1] );
+				std::swap( _jointIndices[i * 4 + k], _jointIndices[i * 4 + k - 1] );
+			}
+		}
+	}
 		
 	// Load triangle indices
 	memcpy( &count, myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
@@ -282,10 +329,10 @@ bool GeometryResource::load( const char *data, int size )
 		// Read vertex indices
 		uint32 streamSize;
 		memcpy( &streamSize, myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
-		mt.diffs.resize( streamSize );
+		mt.vertIndices.resize( streamSize );
 		for( uint32 j = 0; j < streamSize; ++j )
 		{
-			memcpy( &mt.diffs[j].vertIndex, myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
+			memcpy( &mt.vertIndices[j], myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
 		}
 		
 		// Loop over streams
@@ -296,61 +343,294 @@ bool GeometryResource::load( const char *data, int size )
 			memcpy( &streamID, myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
 			memcpy( &streamElemSize, myData, sizeof( uint32 ) ); myData += sizeof( uint32 );
 
-			switch( streamID )
+			if( streamID > 3 )
 			{
-			case 0:		// Position
-				if( streamElemSize != 12 ) return raiseError( "Invalid position morph stream" );
-				for( uint32 k = 0; k < streamSize; ++k )
-				{
-					memcpy( &mt.diffs[k].posDiff.x, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].posDiff.y, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].posDiff.z, myData, sizeof( float ) ); myData += sizeof( float );
-				}
-				break;
-			case 1:		// Normal
-				if( streamElemSize != 12 ) return raiseError( "Invalid normal morph stream" );
-				for( uint32 k = 0; k < streamSize; ++k )
-				{
-					memcpy( &mt.diffs[k].normDiff.x, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].normDiff.y, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].normDiff.z, myData, sizeof( float ) ); myData += sizeof( float );
-				}
-				break;
-			case 2:		// Tangent
-				if( streamElemSize != 12 ) return raiseError( "Invalid tangent morph stream" );
-				for( uint32 k = 0; k < streamSize; ++k )
-				{
-					memcpy( &mt.diffs[k].tanDiff.x, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].tanDiff.y, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].tanDiff.z, myData, sizeof( float ) ); myData += sizeof( float );
-				}
-				break;
-			case 3:		// Bitangent
-				if( streamElemSize != 12 ) return raiseError( "Invalid bitangent morph stream" );
-				for( uint32 k = 0; k < streamSize; ++k )
-				{
-					memcpy( &mt.diffs[k].bitanDiff.x, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].bitanDiff.y, myData, sizeof( float ) ); myData += sizeof( float );
-					memcpy( &mt.diffs[k].bitanDiff.z, myData, sizeof( float ) ); myData += sizeof( float );
-				}
-				break;
-			default:
 				myData += streamElemSize * streamSize;
 				Modules::log().writeWarning( "Geometry resource '%s': Ignoring unsupported vertex morph stream", _name.c_str() );
 				continue;
 			}
+			if( streamElemSize != 12 ) return raiseError( "Invalid morph stream" );
+
+			// Quantize difference vectors to 16 bit with a common scale for the stream
+			float maxValue = 0;
+			for( uint32 k = 0; k < streamSize * 3; ++k )
+			{
+				float f;
+				memcpy( &f, myData + k * sizeof( float ), sizeof( float ) );
+				maxValue = std::max( maxValue, fabsf( f ) );
+			}
+			
+			MorphDiffStream &ds = mt.diffStreams[streamID];
+			ds.scale = maxValue / 32767.0f;
+			ds.values.resize( streamSize * 3 );
+			for( uint32 k = 0; k < streamSize * 3; ++k )
+			{
+				float f;
+				memcpy( &f, myData, sizeof( float ) ); myData += sizeof( float );
+				ds.values[k] = maxValue > 0 ? (short)ftoi_r( f / ds.scale ) : 0;
+			}
+		}
+	}
+
+	// Convert indices to 16 bit if possible
+	vector< unsigned short > indices16;
+	_16BitIndices = !_indices.empty() && _indices.size() < 65000;
+	if( _16BitIndices )
+	{
+		indices16.resize( _indices.size() );
+		for( uint32 i = 0; i < _indices.size(); ++i )
+			indices16[i] = (unsigned short)_indices[i];
+	}
+
+	finishLoading( _16BitIndices ? (void *)&indices16[0] : (void *)(_indices.empty() ? 0x0 : &_indices[0]) );
+	
+	return true;
+}
+
+
+static bool indexBaseOrder( const IndexBase &ib1, const IndexBase &ib2 )
+{
+	return ib1.batchStart < ib2.batchStart;
+}
+
+
+static bool clusterOrder( const GeometryCluster &c1, const GeometryCluster &c2 )
+{
+	return c1.batchStart < c2.batchStart;
+}
+
+
+static bool readSectionData( const char *&data, const char *end, void *dest, size_t size )
+{
+	if( size > (size_t)(end - data) ) return false;
+
+	memcpy( dest, data, size ); data += size;
+	return true;
+}
+
+
+bool GeometryResource::loadSections( const char *data, int size )
+{
+	// Version 6 stores all data in the runtime layout, so sections are copied as a whole
+	// and vertex data can be uploaded without converting single elements
+	
+	const char *sections[GeometrySections::Count] = { 0x0 };
+	uint32 sectionSizes[GeometrySections::Count] = { 0 };
+	
+	uint32 numSections;
+	if( size < 12 ) return raiseError( "Invalid geometry resource" );
+	memcpy( &numSections, data + 8, sizeof( uint32 ) );
+	if( numSections > (uint32)(size - 12) / 12 ) return raiseError( "Invalid section table" );
+
+	for( uint32 i = 0; i < numSections; ++i )
+	{
+		uint32 entry[3];  // Type, offset and size
+		memcpy( entry, data + 12 + i * 12, sizeof( entry ) );
+		
+		if( entry[1] > (uint32)size || entry[2] > (uint32)size - entry[1] )
+			return raiseError( "Invalid section table" );
+		
+		// Unknown sections are skipped
+		if( entry[0] < GeometrySections::Count )
+		{
+			sections[entry[0]] = data + entry[1];
+			sectionSizes[entry[0]] = entry[2];
+		}
+	}
+	
+	// Joints
+	uint32 count = sectionSizes[GeometrySections::Joints] / sizeof( Matrix4f );
+	if( count * sizeof( Matrix4f ) != sectionSizes[GeometrySections::Joints] )
+		return raiseError( "Invalid joint section" );
+	
+	if( count > MaxJointsPerBatch )
+		Modules::log().writeWarning( "Geometry resource '%s': Model has more than %i joints; meshes are drawn with joint palettes", _name.c_str(), MaxJointsPerBatch );
+	
+	_joints.resize( count );
+	for( uint32 i = 0; i < count; ++i )
+	{
+		memcpy( _joints[i].invBindMat.x, sections[GeometrySections::Joints] + i * sizeof( Matrix4f ), sizeof( Matrix4f ) );
+	}
+
+	// Vertices
+	_vertCount = sectionSizes[GeometrySections::DynVertices] / (sizeof( Vec3f ) * 4);
+	if( _vertCount * sizeof( Vec3f ) * 4 != sectionSizes[GeometrySections::DynVertices] ||
+	    _vertCount * sizeof( VertexDataStatic ) != sectionSizes[GeometrySections::StaticVertices] )
+		return raiseError( "Invalid vertex sections" );
+	
+	_vertData = new VertexData( _vertCount, false );  // All data is overwritten
+	if( _vertCount > 0 )
+	{
+		memcpy( _vertData->memory, sections[GeometrySections::DynVertices], _vertCount * sizeof( Vec3f ) * 4 );
+		memcpy( _vertData->staticData, sections[GeometrySections::StaticVertices], _vertCount * sizeof( VertexDataStatic ) );
+	}
+
+	_jointIndices.resize( _vertCount * 4, 0 );
+	if( sections[GeometrySections::JointIndices] != 0x0 )
+	{
+		if( sectionSizes[GeometrySections::JointIndices] != _vertCount * 4 )
+			return raiseError( "Invalid joint index section" );
+		if( _vertCount > 0 )
+			memcpy( &_jointIndices[0], sections[GeometrySections::JointIndices], _vertCount * 4 );
+	}
+	else
+	{
+		// Joint indices are optional and can be derived from the static vertex data
+		for( uint32 i = 0; i < _vertCount * 4; ++i )
+		{
+			float jointIndex = _vertData->staticData[i / 4].jointVec[i % 4];
+			if( jointIndex > 0 && jointIndex < 256 ) _jointIndices[i] = (unsigned char)(jointIndex + 0.5f);
+		}
+	}
+
+	// Indices; 16 bit indices are uploaded directly from the section
+	const void *gpuIndices = 0x0;
+	_16BitIndices = sections[GeometrySections::Indices16] != 0x0;
+	if( _16BitIndices )
+	{
+		const char *indexData = sections[GeometrySections::Indices16];
+		_indices.resize( sectionSizes[GeometrySections::Indices16] / sizeof( short ) );
+		for( uint32 i = 0; i < _indices.size(); ++i )
+		{
+			unsigned short index;
+			memcpy( &index, indexData + i * sizeof( short ), sizeof( short ) );
+			_indices[i] = index;
+		}
+		gpuIndices = indexData;
+		
+		// Indices of large models are relative to the first vertex of their batch, so that
+		// 16 bit are sufficient; the CPU copy is converted back to absolute indices
+		if( sections[GeometrySections::IndexBases] != 0x0 )
+		{
+			uint32 numBases = sectionSizes[GeometrySections::IndexBases] / sizeof( IndexBase );
+			if( numBases * sizeof( IndexBase ) != sectionSizes[GeometrySections::IndexBases] )
+				return raiseError( "Invalid index base section" );
+
+			_indexBases.resize( numBases );
+			if( numBases > 0 )
+				memcpy( &_indexBases[0], sections[GeometrySections::IndexBases], numBases * sizeof( IndexBase ) );
+			std::sort( _indexBases.begin(), _indexBases.end(), indexBaseOrder );
+
+			for( uint32 i = 0; i < numBases; ++i )
+			{
+				IndexBase &ib = _indexBases[i];
+				if( ib.batchStart > _indices.size() || ib.batchCount > _indices.size() - ib.batchStart ||
+				    (i > 0 && ib.batchStart < _indexBases[i - 1].batchStart + _indexBases[i - 1].batchCount) )
+					return raiseError( "Invalid index base section" );
+				
+				for( uint32 j = ib.batchStart; j < ib.batchStart + ib.batchCount; ++j )
+					_indices[j] += ib.baseVertex;
+			}
+		}
+	}
+	else
+	{
+		_indices.resize( sectionSizes[GeometrySections::Indices32] / sizeof( uint32 ) );
+		if( !_indices.empty() )
+		{
+			memcpy( &_indices[0], sections[GeometrySections::Indices32], _indices.size() * sizeof( uint32 ) );
+			gpuIndices = &_indices[0];
 		}
 	}
 
+	// Morph targets
+	if( sections[GeometrySections::MorphTargets] != 0x0 )
+	{
+		const char *myData = sections[GeometrySections::MorphTargets];
+		const char *end = myData + sectionSizes[GeometrySections::MorphTargets];
+		
+		if( !readSectionData( myData, end, &count, sizeof( uint32 ) ) ||
+		    count > (uint32)(end - myData) / (256 + sizeof( uint32 )) )
+			return raiseError( "Invalid morph target section" );
+		
+		_morphTargets.resize( count );
+		for( uint32 i = 0; i < count; ++i )
+		{
+			MorphTarget &mt = _morphTargets[i];
+			char name[256];
+			uint32 numVerts;
+			
+			if( !readSectionData( myData, end, name, 256 ) ||
+			    !readSectionData( myData, end, &numVerts, sizeof( uint32 ) ) ||
+			    numVerts > (uint32)(end - myData) / sizeof( uint32 ) )
+				return raiseError( "Invalid morph target section" );
+			name[255] = '\0';
+			mt.name = name;
+			if( numVerts == 0 ) continue;
+
+			mt.vertIndices.resize( numVerts );
+			if( !readSectionData( myData, end, &mt.vertIndices[0], numVerts * sizeof( uint32 ) ) )
+				return raiseError( "Invalid morph target section" );
+
+			// Difference streams are padded to 4 bytes
+			for( uint32 j = 0; j < 4; ++j )
+			{
+				MorphDiffStream &ds = mt.diffStreams[j];
+				ds.values.resize( numVerts * 3 );
+				
+				if( !readSectionData( myData, end, &ds.scale, sizeof( float ) ) ||
+				    !readSectionData( myData, end, &ds.values[0], numVerts * 3 * sizeof( short ) ) )
+					return raiseError( "Invalid morph target section" );
+				if( numVerts & 1 ) myData += std::min( (int)sizeof( short ), (int)(end - myData) );
+			}
+		}
+	}
+
+	// Culling clusters; they are only valid if the geometry is not deformed
+	if( sections[GeometrySections::Clusters] != 0x0 && _joints.size() <= 1 && _morphTargets.empty() )
+	{
+		// Records of 2 ints and 10 floats
+		const uint32 recordSize = 2 * sizeof( uint32 ) + 10 * sizeof( float );
+		uint32 numClusters = sectionSizes[GeometrySections::Clusters] / recordSize;
+		if( numClusters * recordSize != sectionSizes[GeometrySections::Clusters] )
+			return raiseError( "Invalid cluster section" );
+
+		_clusters.resize( numClusters );
+		for( uint32 i = 0; i < numClusters; ++i )
+		{
+			const char *record = sections[GeometrySections::Clusters] + i * recordSize;
+			uint32 range[2];
+			float values[10];
+			memcpy( range, record, sizeof( range ) );
+			memcpy( values, record + sizeof( range ), sizeof( values ) );
+			
+			GeometryCluster &c = _clusters[i];
+			c.batchStart = range[0]; c.batchCount = range[1];
+			c.bBMin = Vec3f( values[0], values[1], values[2] );
+			c.bBMax = Vec3f( values[3], values[4], values[5] );
+			c.coneAxis = Vec3f( values[6], values[7], values[8] );
+			c.coneCutoff = values[9];
+		}
+		std::sort( _clusters.begin(), _clusters.end(), clusterOrder );
+
+		for( uint32 i = 0; i < numClusters; ++i )
+		{
+			GeometryCluster &c = _clusters[i];
+			if( c.batchStart > _indices.size() || c.batchCount > _indices.size() - c.batchStart ||
+			    (i > 0 && c.batchStart < _clusters[i - 1].batchStart + _clusters[i - 1].batchCount) )
+				return raiseError( "Invalid cluster section" );
+		}
+	}
+
+	finishLoading( gpuIndices );
+	
+	return true;
+}
+
+
+void GeometryResource::finishLoading( const void *gpuIndices, bool allowPosQuantization )
+{
+	_indexCount = (uint32)_indices.size();
+	
 	// Find min/max morph target vertex indices
 	_minMorphIndex = (unsigned)_vertCount;
 	_maxMorphIndex = 0;
 	for( uint32 i = 0; i < _morphTargets.size(); ++i )
 	{
-		for( uint32 j = 0; j < _morphTargets[i].diffs.size(); ++j )
+		for( uint32 j = 0; j < _morphTargets[i].vertIndices.size(); ++j )
 		{
-			_minMorphIndex = std::min( _minMorphIndex, _morphTargets[i].diffs[j].vertIndex );
-			_maxMorphIndex = std::max( _maxMorphIndex, _morphTargets[i].diffs[j].vertIndex );
+			_minMorphIndex = std::min( _minMorphIndex, _morphTargets[i].vertIndices[j] );
+			_maxMorphIndex = std::max( _maxMorphIndex, _morphTargets[i].vertIndices[j] );
 		}
 	}
 	if( _minMorphIndex > _maxMorphIndex )
@@ -367,29 +647,303 @@ bool GeometryResource::load( const char *data, int size )
 	// Upload data
 	if( _vertCount > 0 && _indices.size() > 0 )
 	{
-		// Upload vertices
-		_vertBuffer = Modules::renderer().uploadVertices( _vertData->memory,
-			_vertCount * (sizeof( Vec3f ) * 4 + sizeof( VertexDataStatic )) );
-		
-		// Upload indices (convert indices to 16 bit if possible)
-		if( _indices.size() < 65000 )
+		// Upload vertices; dynamic streams get their own buffer so that updates don't touch static data
+		_compactVertData = Modules::config().vertexCompression;
+		if( _compactVertData )
 		{
-			_16BitIndices = true;
-			unsigned short *indices = new unsigned short[_indices.size()];
-			for( uint32 i = 0; i < _indices.size(); ++i )
-				indices[i] = (unsigned short)_indices[i];
-			_indexBuffer = Modules::renderer().uploadIndices(
-				indices, (uint32)_indices.size() * sizeof( short ) );
-			delete[] indices;
+			// Positions of deformed geometry stay float since skinning and morphing work on them
+			_quantizedPositions = allowPosQuantization && _joints.size() <= 1 && _morphTargets.empty();
+			_packedBasis = Modules::renderer().supportsPackedVertices();
+			
+			vector< char > data;
+			packDynVertData( data );
+			_dynVertBuffer = Modules::renderer().uploadVertices( &data[0], (uint32)data.size() );
+			packStaticVertData( _vertData->staticData, _vertCount, data );
+			_staticVertBuffer = Modules::renderer().uploadVertices( &data[0], (uint32)data.size() );
 		}
 		else
 		{
-			_indexBuffer = Modules::renderer().uploadIndices(
-				&_indices[0], (uint32)_indices.size() * sizeof( uint32 ) );
+			_dynVertBuffer = Modules::renderer().uploadVertices( _vertData->memory,
+				_vertCount * sizeof( Vec3f ) * 4 );
+			_staticVertBuffer = Modules::renderer().uploadVertices( _vertData->staticData,
+				_vertCount * sizeof( VertexDataStatic ) );
+		}
+		
+		_indexBuffer = Modules::renderer().uploadIndices( (void *)gpuIndices,
+			(uint32)_indices.size() * (_16BitIndices ? sizeof( short ) : sizeof( uint32 )) );
+
+		// Static geometry doesn't need the CPU copies for rendering; they are read back from
+		// the GPU buffers when they are requested
+		if( (Modules::config().gpuOnlyGeometry || (_flags & ResourceFlags::NoGeoCPUCopy)) &&
+		    _joints.size() <= 1 && _morphTargets.empty() )
+		{
+			releaseCPUData();
+		}
+	}
+}
+
+
+void GeometryResource::releaseCPUData()
+{
+	// Keep bounds of vertex blocks so that meshes can get their bounding boxes without the data;
+	// bounds of the original data are kept when a restored copy is released again
+	if( _vertBlockBounds.empty() )
+	{
+		uint32 numBlocks = (_vertCount + VertBlockSize - 1) / VertBlockSize;
+		_vertBlockBounds.resize( numBlocks * 2 );
+		for( uint32 i = 0; i < numBlocks; ++i )
+		{
+			Vec3f &bMin = _vertBlockBounds[i * 2], &bMax = _vertBlockBounds[i * 2 + 1];
+			bMin = Vec3f( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat );
+			bMax = Vec3f( -Math::MaxFloat, -Math::MaxFloat, -Math::MaxFloat );
+			
+			for( uint32 j = i * VertBlockSize; j < std::min( (i + 1) * VertBlockSize, _vertCount ); ++j )
+			{
+				const Vec3f &pos = _vertData->positions[j];
+				bMin.x = minf( bMin.x, pos.x ); bMin.y = minf( bMin.y, pos.y ); bMin.z = minf( bMin.z, pos.z );
+				bMax.x = maxf( bMax.x, pos.x ); bMax.y = maxf( bMax.y, pos.y ); bMax.z = maxf( bMax.z, pos.z );
+			}
 		}
 	}
 	
-	return true;
+	delete _vertData; _vertData = 0x0;
+	vector< uint32 >().swap( _indices );
+	vector< unsigned char >().swap( _jointIndices );
+	_cpuDataReleased = true;
+}
+
+
+void GeometryResource::restoreCPUData()
+{
+	// Compact GPU data is decoded, so the restored copy differs by the quantization error
+	_cpuDataReleased = false;
+	_vertData = new VertexData( _vertCount, false );
+	
+	// Vertices
+	if( _compactVertData )
+	{
+		vector< char > data( _vertCount * (getCompactPosSize() + 3 * getCompactBasisSize()) );
+		Modules::renderer().readBuffer( _dynVertBuffer, 0, 0, (uint32)data.size(), &data[0] );
+		unpackDynVertData( data );
+
+		data.resize( _vertCount * sizeof( VertexDataStaticCompact ) );
+		Modules::renderer().readBuffer( _staticVertBuffer, 0, 0, (uint32)data.size(), &data[0] );
+		VertexDataStaticCompact *compact = (VertexDataStaticCompact *)&data[0];
+		for( uint32 i = 0; i < _vertCount; ++i )
+		{
+			VertexDataStatic &sd = _vertData->staticData[i];
+			sd.u0 = compact[i].u0; sd.v0 = compact[i].v0;
+			sd.u1 = compact[i].u1; sd.v1 = compact[i].v1;
+			for( uint32 j = 0; j < 4; ++j )
+			{
+				sd.jointVec[j] = (float)compact[i].jointVec[j];
+				sd.weightVec[j] = compact[i].weightVec[j] / 255.0f;
+			}
+		}
+	}
+	else
+	{
+		Modules::renderer().readBuffer( _dynVertBuffer, 0, 0, _vertCount * sizeof( Vec3f ) * 4,
+			_vertData->memory );
+		Modules::renderer().readBuffer( _staticVertBuffer, 0, 0, _vertCount * sizeof( VertexDataStatic ),
+			_vertData->staticData );
+	}
+	_jointIndices.resize( _vertCount * 4, 0 );  // Static geometry only references the default joint
+
+	// Indices
+	_indices.resize( _indexCount );
+	if( _16BitIndices && _indexCount > 0 )
+	{
+		vector< unsigned short > indices16( _indexCount );
+		Modules::renderer().readBuffer( 0, _indexBuffer, 0, _indexCount * sizeof( short ), &indices16[0] );
+		for( uint32 i = 0; i < _indexCount; ++i ) _indices[i] = indices16[i];
+		
+		for( uint32 i = 0; i < _indexBases.size(); ++i )
+		{
+			for( uint32 j = _indexBases[i].batchStart; j < _indexBases[i].batchStart + _indexBases[i].batchCount; ++j )
+				_indices[j] += _indexBases[i].baseVertex;
+		}
+	}
+	else if( _indexCount > 0 )
+	{
+		Modules::renderer().readBuffer( 0, _indexBuffer, 0, _indexCount * sizeof( uint32 ), &_indices[0] );
+	}
+	
+	Modules::log().writeDebugInfo( "Geometry resource '%s': CPU copy restored from GPU buffers", _name.c_str() );
+}
+
+
+void GeometryResource::getRangeBounds( uint32 vertRStart, uint32 vertREnd, Vec3f &bBMin, Vec3f &bBMax )
+{
+	// Union of the bounds of all blocks touched by the range; conservative if the range is not
+	// aligned to blocks
+	bBMin = Vec3f( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat );
+	bBMax = Vec3f( -Math::MaxFloat, -Math::MaxFloat, -Math::MaxFloat );
+	
+	for( uint32 i = vertRStart / VertBlockSize; i <= vertREnd / VertBlockSize && i * 2 < _vertBlockBounds.size(); ++i )
+	{
+		const Vec3f &bMin = _vertBlockBounds[i * 2], &bMax = _vertBlockBounds[i * 2 + 1];
+		bBMin.x = minf( bBMin.x, bMin.x ); bBMin.y = minf( bBMin.y, bMin.y ); bBMin.z = minf( bBMin.z, bMin.z );
+		bBMax.x = maxf( bBMax.x, bMax.x ); bBMax.y = maxf( bBMax.y, bMax.y ); bBMax.z = maxf( bBMax.z, bMax.z );
+	}
+}
+
+
+uint32 GeometryResource::calcCPUDataSize()
+{
+	uint32 size = (uint32)(_indices.size() * sizeof( uint32 ) + _jointIndices.size() +
+		_vertBlockBounds.size() * sizeof( Vec3f ) + _indexBases.size() * sizeof( IndexBase ) +
+		_clusters.size() * sizeof( GeometryCluster ));
+	if( _vertData != 0x0 ) size += _vertCount * (sizeof( Vec3f ) * 4 + sizeof( VertexDataStatic ));
+	
+	for( uint32 i = 0; i < _morphTargets.size(); ++i )
+	{
+		size += (uint32)_morphTargets[i].vertIndices.size() * sizeof( uint32 );
+		for( uint32 j = 0; j < 4; ++j )
+			size += (uint32)_morphTargets[i].diffStreams[j].values.size() * sizeof( short );
+	}
+
+	return size;
+}
+
+
+static inline short packSNorm16( float f )
+{
+	return (short)ftoi_r( clamp( f, -1, 1 ) * 32767 );
+}
+
+
+static inline uint32 packSNorm10( float f )
+{
+	return (uint32)ftoi_r( clamp( f, -1, 1 ) * 511 ) & 0x3ff;
+}
+
+
+static inline float unpackSNorm10( uint32 v )
+{
+	// Sign extension by shifting the component to the top of a signed integer
+	return maxf( ((int)(v << 22) >> 22) / 511.0f, -1 );
+}
+
+
+void GeometryResource::packDynVertData( vector< char > &data )
+{
+	// Streams are stored one after another as in VertexData; quantized positions are relative to
+	// the bounding box and basis vectors are padded to four components to keep them 4 byte aligned
+	uint32 posSize = getCompactPosSize(), basisSize = getCompactBasisSize();
+	data.resize( _vertCount * (posSize + 3 * basisSize) );
+	
+	if( _quantizedPositions )
+	{
+		Vec3f bBMin( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat );
+		Vec3f bBMax( -Math::MaxFloat, -Math::MaxFloat, -Math::MaxFloat );
+		for( uint32 i = 0; i < _vertCount; ++i )
+		{
+			const Vec3f &pos = _vertData->positions[i];
+			bBMin.x = minf( bBMin.x, pos.x ); bBMin.y = minf( bBMin.y, pos.y ); bBMin.z = minf( bBMin.z, pos.z );
+			bBMax.x = maxf( bBMax.x, pos.x ); bBMax.y = maxf( bBMax.y, pos.y ); bBMax.z = maxf( bBMax.z, pos.z );
+		}
+		
+		Vec3f center = (bBMin + bBMax) * 0.5f, extent = (bBMax - bBMin) * 0.5f;
+		if( extent.x <= 0 ) extent.x = 1;
+		if( extent.y <= 0 ) extent.y = 1;
+		if( extent.z <= 0 ) extent.z = 1;
+		_posDequantMat = Matrix4f::TransMat( center.x, center.y, center.z ) *
+			Matrix4f::ScaleMat( extent.x / 32767, extent.y / 32767, extent.z / 32767 );
+
+		short *pos = (short *)&data[0];
+		for( uint32 i = 0; i < _vertCount; ++i, pos += 4 )
+		{
+			Vec3f p = _vertData->positions[i] - center;
+			pos[0] = packSNorm16( p.x / extent.x );
+			pos[1] = packSNorm16( p.y / extent.y );
+			pos[2] = packSNorm16( p.z / extent.z );
+			pos[3] = 0;
+		}
+	}
+	else
+	{
+		memcpy( &data[0], _vertData->positions, _vertCount * sizeof( Vec3f ) );
+	}
+
+	char *basis = &data[_vertCount * posSize];
+	Vec3f *streams[3] = { _vertData->normals, _vertData->tangents, _vertData->bitangents };
+	for( uint32 i = 0; i < 3; ++i )
+	{
+		for( uint32 j = 0; j < _vertCount; ++j, basis += basisSize )
+		{
+			const Vec3f &v = streams[i][j];
+			if( _packedBasis )
+			{
+				uint32 packed = packSNorm10( v.x ) | packSNorm10( v.y ) << 10 | packSNorm10( v.z ) << 20;
+				memcpy( basis, &packed, sizeof( uint32 ) );
+			}
+			else
+			{
+				short packed[4] = { packSNorm16( v.x ), packSNorm16( v.y ), packSNorm16( v.z ), 0 };
+				memcpy( basis, packed, sizeof( packed ) );
+			}
+		}
+	}
+}
+
+
+void GeometryResource::unpackDynVertData( const vector< char > &data )
+{
+	// Decoded data differs from the original data by the quantization error
+	if( _quantizedPositions )
+	{
+		const short *pos = (const short *)&data[0];
+		for( uint32 i = 0; i < _vertCount; ++i, pos += 4 )
+			_vertData->positions[i] = _posDequantMat * Vec3f( pos[0], pos[1], pos[2] );
+	}
+	else
+	{
+		const Vec3f *pos = (const Vec3f *)&data[0];
+		std::copy( pos, pos + _vertCount, _vertData->positions );
+	}
+
+	const char *basis = &data[_vertCount * getCompactPosSize()];
+	Vec3f *streams[3] = { _vertData->normals, _vertData->tangents, _vertData->bitangents };
+	for( uint32 i = 0; i < 3; ++i )
+	{
+		for( uint32 j = 0; j < _vertCount; ++j, basis += getCompactBasisSize() )
+		{
+			if( _packedBasis )
+			{
+				uint32 packed;
+				memcpy( &packed, basis, sizeof( uint32 ) );
+				streams[i][j] = Vec3f( unpackSNorm10( packed ), unpackSNorm10( packed >> 10 ),
+				                       unpackSNorm10( packed >> 20 ) );
+			}
+			else
+			{
+				short packed[4];
+				memcpy( packed, basis, sizeof( packed ) );
+				streams[i][j] = Vec3f( packed[0] / 32767.0f, packed[1] / 32767.0f, packed[2] / 32767.0f );
+			}
+		}
+	}
+}
+
+
+void GeometryResource::packStaticVertData( const VertexDataStatic *staticData, uint32 count,
+                                           vector< char > &data )
+{
+	data.resize( count * sizeof( VertexDataStaticCompact ) );
+	VertexDataStaticCompact *compact = (VertexDataStaticCompact *)&data[0];
+
+	for( uint32 i = 0; i < count; ++i )
+	{
+		const VertexDataStatic &sd = staticData[i];
+		compact[i].u0 = sd.u0; compact[i].v0 = sd.v0;
+		compact[i].u1 = sd.u1; compact[i].v1 = sd.v1;
+		for( uint32 j = 0; j < 4; ++j )
+		{
+			compact[i].jointVec[j] = (unsigned char)ftoi_r( sd.jointVec[j] );
+			compact[i].weightVec[j] = (unsigned char)ftoi_r( clamp( sd.weightVec[j], 0, 1 ) * 255 );
+		}
+	}
 }
 
 
@@ -398,7 +952,9 @@ int GeometryResource::getParami( int param )
 	switch( param )
 	{
 	case GeometryResParams::IndexCount:
-		return (int)_indices.size();
+		return (int)_indexCount;
+	case GeometryResParams::CPUDataSize:
+		return (int)calcCPUDataSize();
 	case GeometryResParams::VertexCount:
 		return (int)_vertCount;
 	default:
@@ -412,9 +968,10 @@ const void *GeometryResource::getData( int param )
 	switch( param )
 	{
 	case GeometryResParams::IndexData:
+		if( _cpuDataReleased ) restoreCPUData();
 		return _indices.empty() ? 0x0 : &_indices[0];
 	case GeometryResParams::VertexData:
-		return _vertData != 0x0 ? _vertData->positions : 0x0;
+		return getVertData() != 0x0 ? _vertData->positions : 0x0;
 	default:
 		return Resource::getData( param );
 	}
@@ -424,9 +981,240 @@ const void *GeometryResource::getData( int param )
 void GeometryResource::updateDynamicVertData()
 {
 	// Upload dynamic stream data
-	if( _vertData != 0x0 )
+	if( _vertData != 0x0 && _compactVertData )
+	{
+		vector< char > data;
+		packDynVertData( data );
+		Modules::renderer().updateVertices( &data[0], 0, (uint32)data.size(), _dynVertBuffer, true );
+	}
+	else if( _vertData != 0x0 )
+	{
+		Modules::renderer().updateVertices( _vertData->memory, 0, _vertCount * sizeof( Vec3f ) * 4,
+			_dynVertBuffer, true );
+	}
+}
+
+
+bool GeometryResource::getBaseVertex( uint32 batchStart, uint32 batchCount, uint32 &baseVertex )
+{
+	baseVertex = 0;
+	if( _indexBases.empty() ) return true;
+
+	// Find last range that starts before or at the batch
+	uint32 first = 0, last = (uint32)_indexBases.size();
+	while( first < last )
+	{
+		uint32 mid = (first + last) / 2;
+		if( _indexBases[mid].batchStart <= batchStart ) first = mid + 1;
+		else last = mid;
+	}
+
+	// A batch must not span several ranges since it is drawn with a single base vertex
+	if( first > 0 && batchStart < _indexBases[first - 1].batchStart + _indexBases[first - 1].batchCount )
+	{
+		const IndexBase &ib = _indexBases[first - 1];
+		baseVertex = ib.baseVertex;
+		return batchStart + batchCount <= ib.batchStart + ib.batchCount;
+	}
+	
+	return first == _indexBases.size() || batchStart + batchCount <= _indexBases[first].batchStart;
+}
+
+
+bool GeometryResource::findClusters( uint32 batchStart, uint32 batchCount, uint32 &firstCluster, uint32 &numClusters )
+{
+	// Find first cluster that starts at or after the batch
+	uint32 first = 0, last = (uint32)_clusters.size();
+	while( first < last )
+	{
+		uint32 mid = (first + last) / 2;
+		if( _clusters[mid].batchStart < batchStart ) first = mid + 1;
+		else last = mid;
+	}
+	
+	// Clusters can only be used if they cover the batch without gaps
+	uint32 end = batchStart;
+	for( last = first; last < _clusters.size() && _clusters[last].batchStart == end && end < batchStart + batchCount; ++last )
+		end += _clusters[last].batchCount;
+
+	firstCluster = first;
+	numClusters = last - first;
+	return numClusters > 0 && end == batchStart + batchCount;
+}
+
+
+const JointPalette *GeometryResource::getJointPalette( uint32 vertRStart, uint32 vertREnd )
+{
+	// Skeletons that fit into the skinning uniform are passed completely
+	if( _joints.size() <= MaxJointsPerBatch || _vertData == 0x0 ||
+	    vertRStart > vertREnd || vertREnd >= _vertCount )
+	{
+		return 0x0;
+	}
+	
+	for( size_t i = 0, s = _jointPalettes.size(); i < s; ++i )
+	{
+		const JointPalette &palette = _jointPalettes[i];
+		if( palette.joints.empty() )
+		{
+			if( palette.vertRStart == vertRStart && palette.vertREnd == vertREnd ) return 0x0;
+		}
+		else if( palette.vertRStart <= vertRStart && palette.vertREnd >= vertREnd )
+		{
+			return &palette;
+		}
+	}
+
+	// Joint indices of the GPU data can only refer to one palette, so palettes of overlapping
+	// vertex ranges are merged
+	uint32 first = vertRStart, last = vertREnd;
+	for( size_t i = 0; i < _jointPalettes.size(); ++i )
+	{
+		const JointPalette &palette = _jointPalettes[i];
+		if( !palette.joints.empty() && palette.vertRStart <= last && palette.vertREnd >= first &&
+		    (palette.vertRStart < first || palette.vertREnd > last) )
+		{
+			first = std::min( first, palette.vertRStart );
+			last = std::max( last, palette.vertREnd );
+			i = (size_t)-1;  // Merged range may overlap palettes that were checked already
+		}
+	}
+	
+	// Collect joints referenced by vertex range
+	JointPalette palette;
+	palette.vertRStart = first;
+	palette.vertREnd = last;
+	
+	vector< int > localIndices( _joints.size(), -1 );
+	for( uint32 i = first; i <= last; ++i )
+	{
+		for( uint32 j = 0; j < 4; ++j )
+		{
+			uint32 jointIndex = _jointIndices[i * 4 + j];
+			if( _vertData->staticData[i].weightVec[j] <= 0 || jointIndex >= _joints.size() ) continue;
+			
+			if( localIndices[jointIndex] < 0 )
+			{
+				localIndices[jointIndex] = (int)palette.joints.size();
+				palette.joints.push_back( jointIndex );
+			}
+		}
+	}
+
+	if( palette.joints.size() > MaxJointsPerBatch )
+	{
+		Modules::log().writeWarning( "Geometry resource '%s': Vertex range (including overlapping ranges) references more than %i joints", _name.c_str(), MaxJointsPerBatch );
+		
+		// Remember range to avoid repeated warnings
+		palette.vertRStart = vertRStart;
+		palette.vertREnd = vertREnd;
+		palette.joints.clear();
+		_jointPalettes.push_back( palette );
+		return 0x0;
+	}
+
+	// Remap joint indices of GPU data to palette; the CPU copy keeps the model joint indices
+	vector< VertexDataStatic > staticData( &_vertData->staticData[first], &_vertData->staticData[last] + 1 );
+	for( uint32 i = first; i <= last; ++i )
+	{
+		for( uint32 j = 0; j < 4; ++j )
+		{
+			uint32 jointIndex = _jointIndices[i * 4 + j];
+			int localIndex = jointIndex < _joints.size() ? localIndices[jointIndex] : -1;
+			staticData[i - first].jointVec[j] = (float)(localIndex >= 0 ? localIndex : 0);
+		}
+	}
+
+	if( _staticVertBuffer != defVertBuffer && _compactVertData )
+	{
+		vector< char > data;
+		packStaticVertData( &staticData[0], (uint32)staticData.size(), data );
+		Modules::renderer().updateVertices( &data[0], first * sizeof( VertexDataStaticCompact ),
+			(uint32)data.size(), _staticVertBuffer );
+	}
+	else if( _staticVertBuffer != defVertBuffer )
+	{
+		Modules::renderer().updateVertices( &staticData[0], first * sizeof( VertexDataStatic ),
+			(uint32)staticData.size() * sizeof( VertexDataStatic ), _staticVertBuffer );
+	}
+
+	// Replace palettes of merged ranges
+	for( size_t i = _jointPalettes.size(); i-- > 0; )
+	{
+		if( !_jointPalettes[i].joints.empty() &&
+		    _jointPalettes[i].vertRStart >= first && _jointPalettes[i].vertREnd <= last )
+		{
+			_jointPalettes.erase( _jointPalettes.begin() + i );
+		}
+	}
+	_jointPalettes.push_back( palette );
+
+	return &_jointPalettes.back();
+}
+
+
+void GeometryResource::getJointHitboxes( uint32 vertRStart, uint32 vertREnd, uint32 &first, uint32 &count )
+{
+	// Each vertex is assigned to its dominant joint (influences are sorted by weight) and the boxes
+	// are fitted in joint space, so that they are tight around limbs and follow the animated joint;
+	// boxes are built per vertex range since meshes can have different transformations
+	
+	first = 0; count = 0;
+	if( _joints.size() < 2 || getVertData() == 0x0 || vertRStart > vertREnd || vertREnd >= _vertCount )
+		return;
+
+	for( size_t i = 0, s = _jointHitboxes.size(); i < s; ++i )
+	{
+		if( _jointHitboxes[i].vertRStart == vertRStart && _jointHitboxes[i].vertREnd == vertREnd )
+		{
+			if( _jointHitboxes[i].jointIndex == Math::MaxUInt32 ) return;
+			if( count == 0 ) first = (uint32)i;
+			++count;
+		}
+		else if( count > 0 ) return;
+	}
+	if( count > 0 ) return;
+
+	first = (uint32)_jointHitboxes.size();
+	vector< int > hitboxIndices( _joints.size(), -1 );
+	
+	for( uint32 i = vertRStart; i <= vertREnd; ++i )
+	{
+		uint32 jointIndex = _jointIndices[i * 4];
+		if( jointIndex >= _joints.size() || _vertData->staticData[i].weightVec[0] <= 0 ) continue;
+
+		Vec3f pos = _joints[jointIndex].invBindMat * _vertData->positions[i];
+		
+		if( hitboxIndices[jointIndex] < 0 )
+		{
+			hitboxIndices[jointIndex] = (int)_jointHitboxes.size();
+			_jointHitboxes.push_back( JointHitbox() );
+			
+			JointHitbox &hitbox = _jointHitboxes.back();
+			hitbox.vertRStart = vertRStart;
+			hitbox.vertREnd = vertREnd;
+			hitbox.jointIndex = jointIndex;
+			hitbox.bindMat = _joints[jointIndex].invBindMat.inverted();
+			hitbox.mins = pos;
+			hitbox.maxs = pos;
+		}
+		else
+		{
+			JointHitbox &hitbox = _jointHitboxes[hitboxIndices[jointIndex]];
+			hitbox.mins = Vec3f( minf( hitbox.mins.x, pos.x ), minf( hitbox.mins.y, pos.y ), minf( hitbox.mins.z, pos.z ) );
+			hitbox.maxs = Vec3f( maxf( hitbox.maxs.x, pos.x ), maxf( hitbox.maxs.y, pos.y ), maxf( hitbox.maxs.z, pos.z ) );
+		}
+	}
+
+	count = (uint32)_jointHitboxes.size() - first;
+
+	// Remember ranges without boxes so that their vertices are not scanned again
+	if( count == 0 )
 	{
-		Modules::renderer().updateVertices( _vertData->memory, 0, 
-			_vertCount * (sizeof( Vec3f ) * 4 + sizeof( VertexDataStatic )), _vertBuffer );
+		first = 0;
+		_jointHitboxes.push_back( JointHitbox() );
+		_jointHitboxes.back().vertRStart = vertRStart;
+		_jointHitboxes.back().vertREnd = vertREnd;
+		_jointHitboxes.back().jointIndex = Math::MaxUInt32;
 	}
 }
@@ -30,12 +30,16 @@
 #include "egScene.h"
 #include "egAnimation.h"
 #include "utMath.h"
+#include "utSkinning.h"
+#include <algorithm>
 
 
 // =================================================================================================
 // Geometry Resource
 // =================================================================================================
 
+const uint32 VertBlockSize = 64;  // Vertices per block of bounds kept for geometry without CPU copy
+
 struct GeometryResParams
 {
 	enum List
@@ -43,7 +47,25 @@ struct GeometryResParams
 		VertexCount = 200,
 		IndexCount,
 		VertexData,
-		IndexData
+		IndexData,
+		CPUDataSize
+	};
+};
+
+struct GeometrySections	// Section types of geometry format version 6
+{
+	enum List
+	{
+		Joints = 1,  // Inverse bind matrices
+		DynVertices,  // Positions, normals, tangents and bitangents in layout of VertexData
+		StaticVertices,  // Array of VertexDataStatic with influences sorted by descending weight
+		JointIndices,  // Integer joint indices (4 per vertex)
+		Indices16,
+		Indices32,
+		MorphTargets,  // Quantized difference streams
+		IndexBases,  // Array of IndexBase for 16 bit indices relative to a base vertex
+		Clusters,  // Array of GeometryCluster sorted by batchStart
+		Count
 	};
 };
 
@@ -57,6 +79,14 @@ struct VertexDataStatic		// Static data
 	float  u1, v1;
 };
 
+struct VertexDataStaticCompact		// Static data in compact GPU layout
+{
+	float          u0, v0;
+	unsigned char  jointVec[4];
+	unsigned char  weightVec[4];	// Normalized
+	float          u1, v1;
+};
+
 struct VertexData
 {
 private:
@@ -78,7 +108,7 @@ public:
 	friend class ModelNode;
 
 
-	VertexData( uint32 vertCount )
+	VertexData( uint32 vertCount, bool fillDefaults = true )
 	{
 		memory = new char[(sizeof( Vec3f ) * 4 + sizeof( VertexDataStatic )) * vertCount];
 		
@@ -89,6 +119,7 @@ public:
 		staticData = (VertexDataStatic *)(memory + (sizeof( Vec3f ) * 4 * vertCount));
 
 		// Fill with default data
+		if( !fillDefaults ) return;
 		memset( memory, 0, (sizeof( Vec3f ) * 4 + sizeof( VertexDataStatic )) * vertCount );
 		for( uint32 i = 0; i < vertCount; ++i ) staticData[i].weightVec[0] = 1;
 	}
@@ -100,24 +131,98 @@ public:
 };
 
 
+struct DynVertexData	// Private copy of dynamic streams, shares the static data of a VertexData
+{
+private:
+
+	Vec3f   *memory;
+
+public:
+
+	uint32  vertCount;
+	Vec3f   *positions;
+	Vec3f   *normals;
+	Vec3f   *tangents;
+	Vec3f   *bitangents;
+
+	friend class ModelNode;
+
+
+	DynVertexData( const VertexData &vd, uint32 vertCount )
+	{
+		this->vertCount = vertCount;
+		// One additional vector allows four component accesses to the last element
+		memory = new Vec3f[vertCount * 4 + 1];
+
+		positions = memory;
+		normals = memory + vertCount;
+		tangents = memory + vertCount * 2;
+		bitangents = memory + vertCount * 3;
+
+		// Dynamic streams are stored contiguously in VertexData
+		std::copy( vd.positions, vd.positions + vertCount * 4, memory );
+	}
+
+	~DynVertexData()
+	{
+		delete[] memory;
+	}
+};
+
+
 struct Joint
 {
 	Matrix4f  invBindMat;
 };
 
 
-struct MorphDiff
+struct JointPalette
 {
-	uint32  vertIndex;
-	Vec3f   posDiff;
-	Vec3f   normDiff, tanDiff, bitanDiff;
+	uint32                 vertRStart, vertREnd;
+	std::vector< uint32 >  joints;  // Model joint for each local joint index (empty: range can't use palette)
+};
+
+
+struct IndexBase	// Range of indices that is stored relative to a base vertex
+{
+	uint32  batchStart, batchCount;
+	uint32  baseVertex;
+};
+
+
+struct GeometryCluster	// Spatially coherent part of a batch that is culled separately
+{
+	uint32  batchStart, batchCount;
+	Vec3f   bBMin, bBMax;
+	Vec3f   coneAxis;  // Average triangle normal
+	float   coneCutoff;  // Sine of normal cone half angle; 1 if cluster can't be backface culled
+};
+
+
+struct JointHitbox	// Box around the vertices of a range dominated by a joint, in joint space
+{
+	uint32    vertRStart, vertREnd;
+	uint32    jointIndex;  // MaxUInt32: range has no boxes
+	Matrix4f  bindMat;  // Joint space to bind pose model space
+	Vec3f     mins, maxs;
+};
+
+
+struct MorphDiffStream
+{
+	std::vector< short >  values;  // Quantized difference vectors (3 components per vertex)
+	float                 scale;  // Dequantization factor
+
+
+	MorphDiffStream() : scale( 0 ) {}
 };
 
 
 struct MorphTarget
 {
-	std::string               name;
-	std::vector< MorphDiff >  diffs;
+	std::string            name;
+	std::vector< uint32 >  vertIndices;
+	MorphDiffStream        diffStreams[4];  // Position, normal, tangent and bitangent differences
 };
 
 // =================================================================================================
@@ -126,18 +231,41 @@ class GeometryResource : public Resource
 {
 private:
 
-	uint32                      _vertBuffer, _indexBuffer;
-
-	uint32                      _vertCount;
-	VertexData                  *_vertData;	
-	bool                        _16BitIndices;
-	std::vector< uint32 >       _indices;
+	uint32                        _dynVertBuffer;  // Dynamic streams (positions, normals, tangents, bitangents)
+	uint32                        _staticVertBuffer;  // Interleaved static data
+	uint32                        _indexBuffer;
+
+	uint32                        _vertCount;
+	VertexData                    *_vertData;	
+	std::vector< unsigned char >  _jointIndices;  // Integer joint indices (4 per vertex) for software skinning
+	bool                          _16BitIndices;
+	bool                          _compactVertData;  // GPU vertices use normalized shorts and bytes
+	bool                          _quantizedPositions;  // Compact GPU positions are shorts mapped by _posDequantMat
+	bool                          _packedBasis;  // Compact GPU basis vectors use the 10:10:10:2 format
+	Matrix4f                      _posDequantMat;
+	std::vector< uint32 >         _indices;  // Absolute vertex indices
+	uint32                        _indexCount;
+	bool                          _cpuDataReleased;  // CPU copies are dropped for static geometry
+	std::vector< Vec3f >          _vertBlockBounds;  // Min and max of vertex blocks without CPU copy
+	std::vector< GeometryCluster >  _clusters;  // Culling clusters of static geometry
+	std::vector< IndexBase >      _indexBases;  // Rebased index ranges of GPU data, sorted by batchStart
 	
-	std::vector< Joint >        _joints;
-	std::vector< MorphTarget >  _morphTargets;
-	uint32                      _minMorphIndex, _maxMorphIndex;
+	std::vector< Joint >          _joints;
+	std::vector< MorphTarget >    _morphTargets;
+	uint32                        _minMorphIndex, _maxMorphIndex;
+	std::vector< JointPalette >   _jointPalettes;  // Palettes of vertex ranges with remapped joint indices in GPU data
+	std::vector< JointHitbox >    _jointHitboxes;  // Ray test proxies for skinned geometry, grouped by vertex range
 
 	bool raiseError( const std::string &msg );
+	bool loadSections( const char *data, int size );
+	void finishLoading( const void *gpuIndices, bool allowPosQuantization = true );
+	void packDynVertData( std::vector< char > &data );
+	void unpackDynVertData( const std::vector< char > &data );
+	void packStaticVertData( const VertexDataStatic *staticData, uint32 count, std::vector< char > &data );
+	void releaseCPUData();
+	void restoreCPUData();
+	uint32 getCompactPosSize() { return _quantizedPositions ? 4 * sizeof( short ) : sizeof( Vec3f ); }
+	uint32 getCompactBasisSize() { return _packedBasis ? sizeof( uint32 ) : 4 * sizeof( short ); }
 
 public:
 
@@ -160,16 +288,26 @@ public:
 	const void *getData( int param );
 
 	void updateDynamicVertData();
+	const JointPalette *getJointPalette( uint32 vertRStart, uint32 vertREnd );
+	void getJointHitboxes( uint32 vertRStart, uint32 vertREnd, uint32 &first, uint32 &count );
+	bool getBaseVertex( uint32 batchStart, uint32 batchCount, uint32 &baseVertex );
+	void getRangeBounds( uint32 vertRStart, uint32 vertREnd, Vec3f &bBMin, Vec3f &bBMax );
+	bool findClusters( uint32 batchStart, uint32 batchCount, uint32 &firstCluster, uint32 &numClusters );
+	uint32 calcCPUDataSize();
 
 	uint32 getVertCount() { return _vertCount; }
-	VertexData *getVertData() { return _vertData; }
-	uint32 getVertBuffer() { return _vertBuffer; }
+	VertexData *getVertData() { if( _cpuDataReleased ) restoreCPUData(); return _vertData; }
+	bool hasCPUData() { return !_cpuDataReleased; }
+	uint32 getIndexCount() { return _indexCount; }
+	uint32 getDynVertBuffer() { return _dynVertBuffer; }
+	uint32 getStaticVertBuffer() { return _staticVertBuffer; }
 	uint32 getIndexBuffer() { return _indexBuffer; }
 	Matrix4f &getInvBindMat( uint32 jointIndex ) { return _joints[jointIndex].invBindMat; }
 
 	friend class Renderer;
 	friend class ModelNode;
 	friend class MeshNode;
+	friend class SceneManager;
 };
 
 typedef SmartResPtr< GeometryResource > PGeometryResource;
@@ -34,8 +34,8 @@ LightNode::LightNode( const LightNodeTpl &lightTpl ) :
 	SceneNode( lightTpl )
 {
 	_materialRes = lightTpl.matRes;
-	_lightingContext = lightTpl.lightingContext;
-	_shadowContext = lightTpl.shadowContext;
+	_lightingContext = ShaderResource::getContextID( lightTpl.lightingContext );
+	_shadowContext = ShaderResource::getContextID( lightTpl.shadowContext );
 	_radius = lightTpl.radius; _fov = lightTpl.fov;
 	_diffCol_R = lightTpl.col_R; _diffCol_G = lightTpl.col_G; _diffCol_B =lightTpl.col_B;
 	_shadowMapCount = lightTpl.shadowMapCount;
@@ -210,8 +210,8 @@ bool LightNode::setParami( int param, int value )
 
 void LightNode::setContexts( const char *lightingContext, const char *shadowContext )
 {
-	if( lightingContext != 0x0 ) _lightingContext = lightingContext;
-	if( shadowContext != 0x0 ) _shadowContext = shadowContext;
+	if( lightingContext != 0x0 ) _lightingContext = ShaderResource::getContextID( lightingContext );
+	if( shadowContext != 0x0 ) _shadowContext = ShaderResource::getContextID( shadowContext );
 }
 
 
@@ -83,7 +83,7 @@ private:
 	Vec3f                  _absPos, _spotDir;
 
 	PMaterialResource      _materialRes;
-	std::string            _lightingContext, _shadowContext;
+	uint32                 _lightingContext, _shadowContext;  // Interned context ids
 	float                  _radius, _fov;
 	float                  _diffCol_R, _diffCol_G, _diffCol_B;
 	uint32                 _shadowMapCount;
@@ -615,6 +615,12 @@ namespace Horde3D
 			return 0;
 		}
 
+		// Create scene nodes for child joints of skeleton
+		if( sn->getType() == SceneNodeTypes::Model )
+			((ModelNode *)sn)->createChildJointNodes( (uint32)-1 );
+		else if( sn->getType() == SceneNodeTypes::Joint && ((JointNode *)sn)->getSkelIndex() != (uint32)-1 )
+			((JointNode *)sn)->getParentModel()->createChildJointNodes( ((JointNode *)sn)->getSkelIndex() );
+
 		if( (unsigned)index < sn->getChildren().size() )
 			return sn->getChildren()[index]->getHandle();
 		else
@@ -880,6 +886,13 @@ namespace Horde3D
 			return 0;
 		}
 		
+		// Skeleton joints below a joint node may not have scene nodes yet
+		if( sn->getType() == SceneNodeTypes::Joint && ((JointNode *)sn)->getSkelIndex() != (uint32)-1 &&
+		    (type == SceneNodeTypes::Undefined || type == SceneNodeTypes::Joint) )
+		{
+			((JointNode *)sn)->getParentModel()->createJointNodes( safeStr( name ) );
+		}
+		
 		Modules::sceneMan().clearFindResults();
 		return Modules::sceneMan().findNodes( sn, safeStr( name ), type );
 	}
@@ -950,6 +963,25 @@ namespace Horde3D
 	}
 
 
+	DLLEXP void advanceTime( float timeDelta )
+	{
+		Modules::sceneMan().advanceTime( timeDelta );
+	}
+
+
+	DLLEXP int buildStaticBatches( NodeHandle node, float maxCellSize )
+	{
+		SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
+		if( sn == 0x0 )
+		{
+			Modules::log().writeDebugInfo( "Invalid node handle %i in buildStaticBatches", node );
+			return 0;
+		}
+
+		return Modules::renderer().buildStaticBatches( sn, maxCellSize );
+	}
+
+
 	DLLEXP NodeHandle addGroupNode( NodeHandle parent, const char *name )
 	{
 		SceneNode *parentNode = Modules::sceneMan().resolveNodeHandle( parent );
@@ -1036,6 +1068,36 @@ namespace Horde3D
 	}
 
 
+	DLLEXP bool setModelAnimPlayback( NodeHandle modelNode, int stage, float speed, bool loop )
+	{
+		SceneNode *sn = Modules::sceneMan().resolveNodeHandle( modelNode );
+		if( sn != 0x0 && sn->getType() == SceneNodeTypes::Model )
+		{
+			return ((ModelNode *)sn)->setAnimPlayback( stage, speed, loop );
+		}
+		else
+		{	
+			Modules::log().writeDebugInfo( "Invalid Model node handle %i in setModelAnimPlayback", modelNode );
+			return false;
+		}
+	}
+
+
+	DLLEXP bool fadeModelAnimStage( NodeHandle modelNode, int stage, float weight, float fadeTime )
+	{
+		SceneNode *sn = Modules::sceneMan().resolveNodeHandle( modelNode );
+		if( sn != 0x0 && sn->getType() == SceneNodeTypes::Model )
+		{
+			return ((ModelNode *)sn)->fadeAnimStage( stage, weight, fadeTime );
+		}
+		else
+		{	
+			Modules::log().writeDebugInfo( "Invalid Model node handle %i in fadeModelAnimStage", modelNode );
+			return false;
+		}
+	}
+
+
 	DLLEXP NodeHandle addMeshNode( NodeHandle parent, const char *name, ResHandle materialRes,
 	                               int batchStart, int batchCount, int vertRStart, int vertREnd )
 	{
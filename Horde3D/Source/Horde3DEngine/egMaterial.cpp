@@ -33,6 +33,9 @@
 
 using namespace std;
 
+vector< string > MaterialResource::_classNames( 1 );
+
+
 MaterialResource::MaterialResource( const string &name, int flags ) :
 	Resource( ResourceTypes::Material, name, flags )
 {
@@ -51,6 +54,7 @@ Resource *MaterialResource::clone()
 	MaterialResource *res = new MaterialResource( "", _flags );
 
 	*res = *this;
+	res->_bindingTables.clear();  // Tables point to the values of the original
 	
 	return res;
 }
@@ -62,6 +66,7 @@ void MaterialResource::initDefault()
 	_combMask = 0;
 	_matLink = 0x0;
 	_class = "";
+	_classBitCount = 0;
 }
 
 
@@ -73,6 +78,8 @@ void MaterialResource::release()
 
 	_samplers.clear();
 	_uniforms.clear();
+	_bindingTables.clear();
+	_classBitCount = 0;
 }
 
 
@@ -109,6 +116,7 @@ bool MaterialResource::load( const char *data, int size )
 
 	// Class
     _class = rootNode.getAttribute( "class", "" );
+	updateClassBits();
 
 	// Link
 	if( strcmp( rootNode.getAttribute( "link", "" ), "" ) != 0 )
@@ -210,7 +218,7 @@ bool MaterialResource::setUniform( const string &name, float a, float b, float c
 			_uniforms[i].values[1] = b;
 			_uniforms[i].values[2] = c;
 			_uniforms[i].values[3] = d;
-			return true;
+			return true;  // Binding tables point to the values, so they need no update
 		}
 	}
 
@@ -225,6 +233,7 @@ bool MaterialResource::setSampler( const std::string &name, TextureResource *tex
 		if( _samplers[i].name == name )
 		{
 			_samplers[i].texRes = texRes;
+			_bindingTables.clear();
 			return true;
 		}
 	}
@@ -233,6 +242,100 @@ bool MaterialResource::setSampler( const std::string &name, TextureResource *tex
 }
 
 
+MatBindingTable &MaterialResource::getBindingTable( ShaderResource &shaderRes, ShaderCombination &sc )
+{
+	for( size_t i = 0, s = _bindingTables.size(); i < s; ++i )
+	{
+		if( _bindingTables[i].compileStamp == sc.compileStamp ) return _bindingTables[i];
+	}
+
+	// Replace table of a previous compilation of the combination
+	MatBindingTable *table = 0x0;
+	for( size_t i = 0, s = _bindingTables.size(); i < s; ++i )
+	{
+		if( _bindingTables[i].shaderComb == &sc ) table = &_bindingTables[i];
+	}
+	if( table == 0x0 )
+	{
+		_bindingTables.push_back( MatBindingTable() );
+		table = &_bindingTables.back();
+	}
+	
+	table->shaderComb = &sc;
+	table->compileStamp = sc.compileStamp;
+	table->samplers.resize( 0 );
+	table->uniforms.resize( 0 );
+
+	// Resolve samplers by name
+	for( size_t i = 0, s = shaderRes._samplers.size(); i < s; ++i )
+	{
+		if( sc.customSamplers[i] < 0 ) continue;
+
+		MatSamplerBinding binding;
+		binding.sampler = &shaderRes._samplers[i];
+		binding.texRes = 0x0;
+		
+		for( size_t j = 0, s = _samplers.size(); j < s; ++j )
+		{
+			if( _samplers[j].name == binding.sampler->id )
+			{
+				binding.texRes = _samplers[j].texRes;
+				break;
+			}
+		}
+
+		table->samplers.push_back( binding );
+	}
+
+	// Resolve uniforms by name, using default values if not found
+	for( size_t i = 0, s = shaderRes._uniforms.size(); i < s; ++i )
+	{
+		if( sc.customUniforms[i] < 0 ) continue;
+
+		MatUniformBinding binding;
+		binding.location = sc.customUniforms[i];
+		binding.values = shaderRes._uniforms[i].defValues;
+
+		for( size_t j = 0, s = _uniforms.size(); j < s; ++j )
+		{
+			if( _uniforms[j].name == shaderRes._uniforms[i].id )
+			{
+				binding.values = _uniforms[j].values;
+				break;
+			}
+		}
+
+		table->uniforms.push_back( binding );
+	}
+
+	return *table;
+}
+
+
+uint32 MaterialResource::getClassID( const string &theClass )
+{
+	for( uint32 i = 0; i < _classNames.size(); ++i )
+		if( _classNames[i] == theClass ) return i;
+
+	_classNames.push_back( theClass );
+	return (uint32)_classNames.size() - 1;
+}
+
+
+void MaterialResource::updateClassBits()
+{
+	// Evaluate class membership for all ids interned so far; ids added later
+	// are picked up on the first query
+	_classBitCount = (uint32)_classNames.size();
+	_classBits.assign( (_classBitCount + 31) / 32, 0 );
+	
+	for( uint32 i = 0; i < _classBitCount; ++i )
+	{
+		if( isOfClass( _classNames[i] ) ) _classBits[i >> 5] |= 1u << (i & 31);
+	}
+}
+
+
 bool MaterialResource::isOfClass( const string &theClass )
 {
 	static string theClass2;
@@ -331,6 +434,7 @@ bool MaterialResource::setParamstr( int param, const char *value )
 	{
 	case MaterialResParams::Class:
 		_class = value;
+		_classBitCount = 0;
 		return true;
 	default:
 		return Resource::setParamstr( param, value );
@@ -66,6 +66,28 @@ struct MatUniform
 	}
 };
 
+struct MatSamplerBinding
+{
+	ShaderSampler    *sampler;
+	TextureResource  *texRes;  // Texture assigned by material or 0x0
+};
+
+
+struct MatUniformBinding
+{
+	int          location;
+	const float  *values;  // Points to material values or shader defaults
+};
+
+
+struct MatBindingTable
+{
+	ShaderCombination                 *shaderComb;
+	uint32                            compileStamp;
+	std::vector< MatSamplerBinding >  samplers;
+	std::vector< MatUniformBinding >  uniforms;
+};
+
 // =================================================================================================
 
 class MaterialResource;
@@ -83,12 +105,21 @@ private:
 	std::vector< std::string >  _shaderFlags;
 	PMaterialResource           _matLink;
 
+	std::vector< MatBindingTable >  _bindingTables;  // Samplers and uniforms resolved per shader combination
+	std::vector< uint32 >           _classBits;  // Membership bit for each interned class id
+	uint32                          _classBitCount;  // Number of class ids covered by _classBits
+
+	static std::vector< std::string >  _classNames;  // Interned class names, 0 is empty name (all classes)
+
 	bool raiseError( const std::string &msg, int line = -1 );
+	void updateClassBits();
 
 public:
 
 	static Resource *factoryFunc( const std::string &name, int flags )
 		{ return new MaterialResource( name, flags ); }
+
+	static uint32 getClassID( const std::string &theClass );
 	
 	MaterialResource( const std::string &name, int flags );
 	~MaterialResource();
@@ -100,6 +131,12 @@ public:
 	bool setUniform( const std::string &name, float a, float b, float c, float d );
 	bool setSampler( const std::string &name, TextureResource *texRes );
 	bool isOfClass( const std::string &theClass );
+	bool isOfClass( uint32 classID )
+	{
+		if( classID >= _classBitCount ) updateClassBits();
+		return (_classBits[classID >> 5] & (1u << (classID & 31))) != 0;
+	}
+	MatBindingTable &getBindingTable( ShaderResource &shaderRes, ShaderCombination &sc );
 
 	int getParami( int param );
 	bool setParami( int param, int value );
@@ -25,17 +25,28 @@
 #include "egModel.h"
 #include "egMaterial.h"
 #include "egModules.h"
+#include "utPlatform.h"
+#include "utMathSSE.h"
+
+#ifdef PLATFORM_SSE2
+#	include <emmintrin.h>
+#endif
 
 #include "utDebug.h"
 
 using namespace std;
 
 ModelNode::ModelNode( const ModelNodeTpl &modelTpl ) :
-	SceneNode( modelTpl ), _geometryRes( modelTpl.geoRes ), _baseGeoRes( 0x0 ),
-	_softwareSkinning( modelTpl.softwareSkinning ), _morpherUsed( false ), _morpherDirty( false ),
-	_animDirty( false ), _nodeListDirty( false ), _skinningDirty( false ), _meshCount( 0 ),
+	SceneNode( modelTpl ), _geometryRes( modelTpl.geoRes ), _dynVertData( 0x0 ), _dynVertBuffer( 0 ),
 	_lodDist1( modelTpl.lodDist1 ), _lodDist2( modelTpl.lodDist2 ), _lodDist3( modelTpl.lodDist3 ),
-	_lodDist4( modelTpl.lodDist4 )
+	_lodDist4( modelTpl.lodDist4 ), _animLodDist1( modelTpl.animLodDist1 ),
+	_animLodDist2( std::max( modelTpl.animLodDist2, modelTpl.animLodDist1 ) ),
+	_animLodJointDepth( (uint32)modelTpl.animLodJointDepth ), _meshCount( 0 ), _skeletonDirty( false ),
+	_softwareSkinning( modelTpl.softwareSkinning ), _skinningDirty( false ),
+	_dualQuatSkinning( modelTpl.dualQuatSkinning ), _skinDualQuatsDirty( true ),
+	_skinWeightLod( modelTpl.skinWeightLod ), _skinInfluences( 4 ), _jointHitboxes( modelTpl.jointHitboxes ),
+	_animDirty( false ), _nodeListDirty( false ), _morpherUsed( false ), _morpherDirty( false ),
+	_visibleFrame( 0 ), _viewDist( 0 ), _animFrame( 0 )
 {
 	_renderable = true;
 	
@@ -48,7 +59,8 @@ ModelNode::ModelNode( const ModelNodeTpl &modelTpl ) :
 
 ModelNode::~ModelNode()
 {
-	_geometryRes = 0x0; _baseGeoRes = 0x0;
+	releaseDynVertData();
+	_geometryRes = 0x0;
 	for( uint32 i = 0; i < _occQueries.size(); ++i )
 	{
 		if( _occQueries[i] != 0 )
@@ -81,6 +93,30 @@ SceneNodeTpl *ModelNode::parsingFunc( map< string, string > &attribs )
 		else
 			modelTpl->softwareSkinning = false;
 	}
+	itr = attribs.find( "dualQuatSkinning" );
+	if( itr != attribs.end() ) 
+	{
+		if ( _stricmp( itr->second.c_str(), "true" ) == 0 || _stricmp( itr->second.c_str(), "1" ) == 0 )
+			modelTpl->dualQuatSkinning = true;
+		else
+			modelTpl->dualQuatSkinning = false;
+	}
+	itr = attribs.find( "skinWeightLod" );
+	if( itr != attribs.end() ) 
+	{
+		if ( _stricmp( itr->second.c_str(), "true" ) == 0 || _stricmp( itr->second.c_str(), "1" ) == 0 )
+			modelTpl->skinWeightLod = true;
+		else
+			modelTpl->skinWeightLod = false;
+	}
+	itr = attribs.find( "jointHitboxes" );
+	if( itr != attribs.end() ) 
+	{
+		if ( _stricmp( itr->second.c_str(), "true" ) == 0 || _stricmp( itr->second.c_str(), "1" ) == 0 )
+			modelTpl->jointHitboxes = true;
+		else
+			modelTpl->jointHitboxes = false;
+	}
 
 	itr = attribs.find( "lodDist1" );
 	if( itr != attribs.end() ) modelTpl->lodDist1 = (float)atof( itr->second.c_str() );
@@ -90,6 +126,12 @@ SceneNodeTpl *ModelNode::parsingFunc( map< string, string > &attribs )
 	if( itr != attribs.end() ) modelTpl->lodDist3 = (float)atof( itr->second.c_str() );
 	itr = attribs.find( "lodDist4" );
 	if( itr != attribs.end() ) modelTpl->lodDist4 = (float)atof( itr->second.c_str() );
+	itr = attribs.find( "animLodDist1" );
+	if( itr != attribs.end() ) modelTpl->animLodDist1 = (float)atof( itr->second.c_str() );
+	itr = attribs.find( "animLodDist2" );
+	if( itr != attribs.end() ) modelTpl->animLodDist2 = (float)atof( itr->second.c_str() );
+	itr = attribs.find( "animLodJointDepth" );
+	if( itr != attribs.end() ) modelTpl->animLodJointDepth = atoi( itr->second.c_str() );
 
 	if( !result )
 	{
@@ -117,6 +159,10 @@ void ModelNode::updateStageAnimations( uint32 stage, const string &startNode )
 		{
 			_nodeList[i].animEntities[stage] = 0x0;
 		}
+		for( size_t i = 0, s = _skeleton.size(); i < s; ++i ) 
+		{
+			_skeleton[i].animEntities[stage] = 0x0;
+		}
 		
 		return;
 	}
@@ -147,28 +193,129 @@ void ModelNode::updateStageAnimations( uint32 stage, const string &startNode )
 		else
 			_nodeList[i].animEntities[stage] = 0x0;
 	}
+
+	for( size_t i = 0, s = _skeleton.size(); i < s; ++i )
+	{
+		bool includeNode = true;
+		
+		if( startNode != "" )
+		{
+			includeNode = false;
+			
+			for( uint32 j = (uint32)i; j != (uint32)-1; j = _skeleton[j].parent )
+			{
+				if( _skeleton[j].name == startNode )
+				{
+					includeNode = true;
+					break;
+				}
+			}
+		}
+
+		_skeleton[i].animEntities[stage] = includeNode ? anim->findEntity( _skeleton[i].name ) : 0x0;
+	}
+}
+
+
+void ModelNode::addSkeletonJointsRec( JointNodeTpl &jointTpl, uint32 parent, uint32 depth )
+{
+	uint32 index = (uint32)_skeleton.size();
+	_skeleton.push_back( SkelJoint( jointTpl.name, parent, jointTpl.jointIndex, depth ) );
+	
+	Matrix4f &relTrans = _skeleton.back().relTrans;
+	relTrans = Matrix4f::ScaleMat( jointTpl.scale.x, jointTpl.scale.y, jointTpl.scale.z );
+	relTrans.rotate( degToRad( jointTpl.rot.x ), degToRad( jointTpl.rot.y ), degToRad( jointTpl.rot.z ) );
+	relTrans.translate( jointTpl.trans.x, jointTpl.trans.y, jointTpl.trans.z );
+	_skeletonDirty = true;
+
+	// Joints with attachment data get their scene node right away
+	if( !jointTpl.attachmentString.empty() )
+	{
+		JointNode *node = createJointNode( index );
+		if( node != 0x0 ) node->setAttachmentString( jointTpl.attachmentString.c_str() );
+	}
+
+	for( uint32 i = 0; i < jointTpl.children.size(); ++i )
+	{
+		if( jointTpl.children[i]->type == SceneNodeTypes::Joint )
+		{
+			addSkeletonJointsRec( *(JointNodeTpl *)jointTpl.children[i], index, depth + 1 );
+		}
+		else
+		{
+			// Other nodes need a scene node of the joint as parent
+			JointNode *node = createJointNode( index );
+			if( node != 0x0 ) Modules::sceneMan().parseNode( *jointTpl.children[i], node );
+		}
+	}
+}
+
+
+JointNode *ModelNode::createJointNode( uint32 skelIndex )
+{
+	if( skelIndex >= _skeleton.size() ) return 0x0;
+	if( _skeleton[skelIndex].node != 0x0 ) return _skeleton[skelIndex].node;
+
+	// Parent joints need to exist as scene nodes as well
+	SceneNode *parentNode = this;
+	if( _skeleton[skelIndex].parent != (uint32)-1 )
+	{
+		parentNode = createJointNode( _skeleton[skelIndex].parent );
+		if( parentNode == 0x0 ) return 0x0;
+	}
+
+	SkelJoint &joint = _skeleton[skelIndex];
+	JointNode *node = new JointNode( JointNodeTpl( joint.name, joint.jointIndex ) );
+	node->_skelIndex = skelIndex;
+	node->_relTrans = joint.relTrans;
+	node->_relModelMat = joint.relModelMat;
+	
+	if( Modules::sceneMan().addNode( node, *parentNode ) == 0 ) return 0x0;
+	joint.node = node;
+
+	return node;
+}
+
+
+void ModelNode::createJointNodes( const string &name )
+{
+	for( uint32 i = 0; i < (uint32)_skeleton.size(); ++i )
+	{
+		if( name == "" || _skeleton[i].name == name ) createJointNode( i );
+	}
+}
+
+
+void ModelNode::createChildJointNodes( uint32 parentSkelIndex )
+{
+	for( uint32 i = 0; i < (uint32)_skeleton.size(); ++i )
+	{
+		if( _skeleton[i].parent == parentSkelIndex ) createJointNode( i );
+	}
 }
 
 
-void ModelNode::recreateNodeListRec( SceneNode *node, bool firstCall )
+void ModelNode::recreateNodeListRec( SceneNode *node, uint32 depth )
 {
 	if( node->getType() == SceneNodeTypes::Mesh )
 	{
 		++_meshCount;
-		_nodeList.push_back( NodeListEntry( (AnimatableSceneNode *)node ) );
+		_nodeList.push_back( NodeListEntry( (AnimatableSceneNode *)node, depth ) );
 		if( _nodeList.size() > _meshCount )
 			swap( _nodeList[_meshCount - 1], _nodeList.back() );
 	}
 	else if( node->getType() == SceneNodeTypes::Joint )
 	{
-		_nodeList.push_back( NodeListEntry( (AnimatableSceneNode *)node ) );
+		// Joints of the skeleton are animated by the model directly
+		if( ((JointNode *)node)->_skelIndex == (uint32)-1 )
+			_nodeList.push_back( NodeListEntry( (AnimatableSceneNode *)node, depth ) );
 	}
-	else if( !firstCall ) return;	// First node is the model
+	else if( depth > 0 ) return;	// First node is the model
 
 	// Children
 	for( size_t i = 0, s = node->getChildren().size(); i < s; ++i )
 	{
-		recreateNodeListRec( node->getChildren()[i], false );
+		recreateNodeListRec( node->getChildren()[i], depth + 1 );
 	}
 }
 
@@ -178,7 +325,7 @@ void ModelNode::recreateNodeList()
 	_meshCount = 0;
 	_nodeList.resize( 0 );
 	
-	recreateNodeListRec( this, true );
+	recreateNodeListRec( this, 0 );
 	for( uint32 i = 0; i < MaxNumAnimStages; ++i )
 	{
 		if( _animStages[i] != 0x0 && _animStages[i]->anim != 0x0 )
@@ -223,8 +370,10 @@ bool ModelNode::setupAnimStage( int stage, uint32 animRes, const string &startNo
 	}
 	else if( curStage != 0x0 )
 	{
-		// Reset stage
+		// Reset stage; engine playback is stopped
 		if( curStage->anim != 0x0 ) curStage->anim = 0x0;
+		curStage->speed = 0;
+		curStage->fadeSpeed = 0;
 	}
 	else
 	{
@@ -256,6 +405,8 @@ bool ModelNode::setAnimParams( int stage, float time, float weight )
 	// Reset ignore animation flag
 	for( size_t i = 0, s = _nodeList.size(); i < s; ++i )
 		_nodeList[i].node->_ignoreAnim = false;
+	for( size_t i = 0, s = _skeleton.size(); i < s; ++i )
+		if( _skeleton[i].node != 0x0 ) _skeleton[i].node->_ignoreAnim = false;
 
 	markDirty();	// Mark scene node as dirty so that update function is called
 	_animDirty = true;
@@ -264,12 +415,119 @@ bool ModelNode::setAnimParams( int stage, float time, float weight )
 }
 
 
+bool ModelNode::setAnimPlayback( int stage, float speed, bool loop )
+{
+	if( (unsigned)stage >= MaxNumAnimStages ) return false;
+
+	AnimStage *curStage = _animStages[stage];
+	if( curStage == 0x0 || curStage->anim == 0x0 ) return false;
+
+	curStage->speed = speed;
+	curStage->loop = loop;
+	if( speed != 0 ) Modules::sceneMan().addPlaybackNode( *this );
+
+	return true;
+}
+
+
+bool ModelNode::fadeAnimStage( int stage, float weight, float fadeTime )
+{
+	if( (unsigned)stage >= MaxNumAnimStages ) return false;
+
+	AnimStage *curStage = _animStages[stage];
+	if( curStage == 0x0 || curStage->anim == 0x0 ) return false;
+
+	if( fadeTime <= 0 )
+	{
+		curStage->fadeSpeed = 0;
+		curStage->blendWeight = weight;
+		
+		markDirty();
+		_animDirty = true;
+		return true;
+	}
+
+	curStage->fadeTarget = weight;
+	curStage->fadeSpeed = fabsf( weight - curStage->blendWeight ) / fadeTime;
+	if( curStage->fadeSpeed > 0 ) Modules::sceneMan().addPlaybackNode( *this );
+
+	return true;
+}
+
+
+bool ModelNode::onAdvanceTime( float timeDelta )
+{
+	bool playing = false, changed = false;
+	
+	for( uint32 i = 0; i < MaxNumAnimStages; ++i )
+	{
+		AnimStage *curStage = _animStages[i];
+		if( curStage == 0x0 || curStage->anim == 0x0 ) continue;
+
+		if( curStage->speed != 0 )
+		{
+			float numFrames = (float)curStage->anim->_numFrames;
+			curStage->animTime += curStage->speed * timeDelta;
+			
+			if( curStage->loop )
+			{
+				// Keep time in range of animation to avoid precision loss
+				if( numFrames > 0 )
+				{
+					curStage->animTime = fmodf( curStage->animTime, numFrames );
+					if( curStage->animTime < 0 ) curStage->animTime += numFrames;
+				}
+			}
+			else
+			{
+				// Stop at first or last frame
+				float lastFrame = maxf( numFrames - 1, 0 );
+				if( (curStage->speed > 0 && curStage->animTime >= lastFrame) ||
+				    (curStage->speed < 0 && curStage->animTime <= 0) )
+				{
+					curStage->animTime = clamp( curStage->animTime, 0, lastFrame );
+					curStage->speed = 0;
+				}
+			}
+			changed = true;
+		}
+
+		if( curStage->fadeSpeed > 0 )
+		{
+			float step = curStage->fadeSpeed * timeDelta;
+			float diff = curStage->fadeTarget - curStage->blendWeight;
+			
+			if( fabsf( diff ) <= step )
+			{
+				curStage->blendWeight = curStage->fadeTarget;
+				curStage->fadeSpeed = 0;
+			}
+			else
+			{
+				curStage->blendWeight += diff > 0 ? step : -step;
+			}
+			changed = true;
+		}
+
+		playing |= curStage->speed != 0 || curStage->fadeSpeed > 0;
+	}
+
+	// Only models with changed animation state are updated
+	if( changed && timeDelta != 0 )
+	{
+		markDirty();
+		_animDirty = true;
+	}
+
+	return playing;
+}
+
+
 bool ModelNode::setMorphParam( const string &targetName, float weight )
 {
 	if( _geometryRes == 0x0 || _morphers.empty() ) return false;
 
 	bool result = false;
-	_morpherDirty = true;
 	_morpherUsed = false;
 
 	// Set specified morph target or all targets if targetName == ""
@@ -277,6 +535,8 @@ bool ModelNode::setMorphParam( const string &targetName, float weight )
 	{
 		if( targetName == "" || _morphers[i].name == targetName )
 		{
+			// Geometry only needs to be updated if a weight has really changed
+			if( _morphers[i].weight != weight ) _morpherDirty = true;
 			_morphers[i].weight = weight;
 			result = true;
 		}
@@ -284,7 +544,7 @@ bool ModelNode::setMorphParam( const string &targetName, float weight )
 		if( _morphers[i].weight > 0 ) _morpherUsed = true;
 	}
 
-	markDirty();
+	if( _morpherDirty ) markDirty();
 
 	return result;
 }
@@ -298,18 +558,26 @@ int ModelNode::getParami( int param )
 		return _geometryRes != 0x0 ? _geometryRes->_handle : 0;
 	case ModelNodeParams::SoftwareSkinning:
 		return _softwareSkinning ? 1 : 0;
+	case ModelNodeParams::DualQuatSkinning:
+		return _dualQuatSkinning ? 1 : 0;
+	case ModelNodeParams::SkinWeightLod:
+		return _skinWeightLod ? 1 : 0;
+	case ModelNodeParams::JointHitboxes:
+		return _jointHitboxes ? 1 : 0;
+	case ModelNodeParams::AnimLodJointDepth:
+		return (int)_animLodJointDepth;
 	default:
 		return SceneNode::getParami( param );
 	}
 }
 
 
-void ModelNode::markMeshBBoxesDirty()
+void ModelNode::markMeshBBoxesDirty( bool geometryChanged )
 {
 	for( size_t i = 0, s = _children.size(); i < s; ++i )
 	{
 		if( _children[i]->getType() == SceneNodeTypes::Mesh )
-			((MeshNode *)_children[i])->markBBoxesDirty();
+			((MeshNode *)_children[i])->markBBoxesDirty( geometryChanged );
 	}
 
 	markDirty();
@@ -328,6 +596,10 @@ float ModelNode::getParamf( int param )
 		return _lodDist3;
 	case ModelNodeParams::LodDist4:
 		return _lodDist4;
+	case ModelNodeParams::AnimLodDist1:
+		return _animLodDist1;
+	case ModelNodeParams::AnimLodDist2:
+		return _animLodDist2;
 	default:
 		return SceneNode::getParamf( param );
 	}
@@ -340,6 +612,15 @@ bool ModelNode::setParamf( int param, float value )
 	{
 	case ModelNodeParams::LodDist1:
 		_lodDist1 = value;
+		// Static batches only contain meshes of models without LOD
+		for( uint32 i = 0; i < _meshCount; ++i )
+		{
+			if( ((MeshNode *)_nodeList[i].node)->isStaticBatched() )
+			{
+				Modules::renderer().clearStaticBatches();
+				break;
+			}
+		}
 		return true;
 	case ModelNodeParams::LodDist2:
 		_lodDist2 = value;
@@ -350,6 +631,12 @@ bool ModelNode::setParamf( int param, float value )
 	case ModelNodeParams::LodDist4:
 		_lodDist4 = value;
 		return true;
+	case ModelNodeParams::AnimLodDist1:
+		_animLodDist1 = std::min( value, _animLodDist2 );
+		return true;
+	case ModelNodeParams::AnimLodDist2:
+		_animLodDist2 = std::max( value, _animLodDist1 );
+		return true;
 	default:	
 		return SceneNode::setParamf( param, value );
 	}
@@ -378,6 +665,8 @@ bool ModelNode::setParami( int param, int value )
 			_skinMatRows[i * 3 + 1] = Vec4f( 0, 1, 0, 0 );
 			_skinMatRows[i * 3 + 2] = Vec4f( 0, 0, 1, 0 );
 		}
+		_skinDualQuatsDirty = true;
+		_skeletonDirty = true;
 
 		// Copy morph targets
 		_morphers.resize( ((GeometryResource *)res)->_morphTargets.size() );
@@ -390,78 +679,543 @@ bool ModelNode::setParami( int param, int value )
 			morpher.weight = 0;
 		}
 
-		if( !_morphers.empty() || _softwareSkinning )
-		{
-			Resource *clonedRes =  Modules::resMan().resolveResHandle(
-				Modules::resMan().cloneResource( res->getHandle(), "" ) );
-			_geometryRes = (GeometryResource *)clonedRes;
-			_baseGeoRes = (GeometryResource *)res;
-		}
-		else
-		{
-			_geometryRes = (GeometryResource *)res;
-			_baseGeoRes = 0x0;
-		}
+		// Resource is shared; private dynamic streams are created on the first geometry update
+		releaseDynVertData();
+		_geometryRes = (GeometryResource *)res;
 
 		_skinningDirty = true;
-		markMeshBBoxesDirty();
+		markMeshBBoxesDirty( true );
 		return true;
 	case ModelNodeParams::SoftwareSkinning:
 		_softwareSkinning = (value != 0);
 		if( _softwareSkinning )
 		{	
 			_skinningDirty = true;
-			markMeshBBoxesDirty();
 		}
-
-		if( _softwareSkinning && _baseGeoRes == 0x0 && _geometryRes != 0x0 )
-			// Create a local resource copy since it is not yet existing
-			setParami( ModelNodeParams::GeometryRes, _geometryRes->getHandle() );
-		else if( !_softwareSkinning && _morphers.empty() && _baseGeoRes != 0x0 )
-			// Remove the local resource copy by removing reference
-			setParami( ModelNodeParams::GeometryRes, _baseGeoRes->getHandle() );
+		else
+		{
+			// Drop skinned streams; they are recreated from base data if morph targets are active
+			releaseDynVertData();
+			_morpherDirty = _morpherUsed;
+		}
+		markMeshBBoxesDirty( true );
 
 		return true;
-
+	case ModelNodeParams::DualQuatSkinning:
+		_dualQuatSkinning = (value != 0);
+		_skinningDirty = true;
+		markMeshBBoxesDirty( true );
+		return true;
+	case ModelNodeParams::SkinWeightLod:
+		_skinWeightLod = (value != 0);
+		_skinningDirty = true;
+		markMeshBBoxesDirty( true );
+		return true;
+	case ModelNodeParams::JointHitboxes:
+		_jointHitboxes = (value != 0);
+		return true;
+	case ModelNodeParams::AnimLodJointDepth:
+		if( value < 0 ) return false;
+		_animLodJointDepth = (uint32)value;
+		return true;
 	default:
 		return SceneNode::setParami( param, value );
 	}
 }
 
 
+bool ModelNode::checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, Vec3f &intsPos ) const
+{
+	// Meshes are tested separately if joint hitboxes are not used
+	if( !usesJointHitboxes() ) return false;
+
+	float nearestT = Math::MaxFloat;
+
+	// Skinned vertices are placed by the transformation of their mesh, so each mesh tests the
+	// hitboxes of its own vertex range
+	for( uint32 i = 0; i < _meshCount; ++i )
+	{
+		MeshNode *meshNode = (MeshNode *)_nodeList[i].node;
+		if( meshNode->getLodLevel() != 0 ) continue;
+		
+		uint32 first, count;
+		_geometryRes->getJointHitboxes( meshNode->getVertRStart(), meshNode->getVertREnd(), first, count );
+		
+		for( uint32 j = first; j < first + count; ++j )
+		{
+			const JointHitbox &hitbox = _geometryRes->_jointHitboxes[j];
+			if( hitbox.jointIndex >= _skinMatRows.size() / 3 ) continue;
+
+			// Hitbox follows the current skinning matrix of the joint
+			Matrix4f skinMat;
+			for( uint32 k = 0; k < 3; ++k )
+			{
+				const Vec4f &row = _skinMatRows[hitbox.jointIndex * 3 + k];
+				skinMat.x[k + 0] = row.x; skinMat.x[k + 4] = row.y;
+				skinMat.x[k + 8] = row.z; skinMat.x[k + 12] = row.w;
+			}
+			
+			// Transform ray to joint space
+			Matrix4f m = (meshNode->_absTrans * skinMat * hitbox.bindMat).inverted();
+			Vec3f orig = m * rayOrig;
+			Vec3f dir = m * (rayOrig + rayDir) - orig;
+
+			float t;
+			if( rayAABBIntersection( orig, dir, hitbox.mins, hitbox.maxs, t ) && t < nearestT )
+				nearestT = t;
+		}
+	}
+
+	if( nearestT == Math::MaxFloat ) return false;
+
+	intsPos = rayOrig + rayDir * nearestT;
+	return true;
+}
+
+
+void ModelNode::releaseDynVertData()
+{
+	if( _dynVertBuffer != 0 )
+	{
+		Modules::renderer().unloadBuffers( _dynVertBuffer, 0 );
+		_dynVertBuffer = 0;
+	}
+	
+	delete _dynVertData; _dynVertData = 0x0;
+}
+
+
+#ifdef PLATFORM_SSE
+
+static inline void blendSkinRows( const Vec4f *rows, const unsigned char *jointIndices,
+                                  const float *weightVec, uint32 influences, __m128 m[3] )
+{
+	const Vec4f *row0 = &rows[jointIndices[0] * 3];
+	
+	if( influences == 1 )
+	{
+		for( uint32 j = 0; j < 3; ++j ) m[j] = _mm_loadu_ps( &row0[j].x );
+	}
+	else if( influences == 2 )
+	{
+		const Vec4f *row1 = &rows[jointIndices[1] * 3];
+		float weightSum = weightVec[0] + weightVec[1];
+		float invSum = weightSum > Math::Epsilon ? 1.0f / weightSum : 1.0f;
+		__m128 w0 = _mm_set1_ps( weightVec[0] * invSum );
+		__m128 w1 = _mm_set1_ps( weightVec[1] * invSum );
+
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			m[j] = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( &row0[j].x ), w0 ),
+			                   _mm_mul_ps( _mm_loadu_ps( &row1[j].x ), w1 ) );
+		}
+	}
+	else
+	{
+		const Vec4f *row1 = &rows[jointIndices[1] * 3];
+		const Vec4f *row2 = &rows[jointIndices[2] * 3];
+		const Vec4f *row3 = &rows[jointIndices[3] * 3];
+
+		__m128 weights = _mm_loadu_ps( weightVec );
+		__m128 w0 = _mm_shuffle_ps( weights, weights, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+		__m128 w1 = _mm_shuffle_ps( weights, weights, _MM_SHUFFLE( 1, 1, 1, 1 ) );
+		__m128 w2 = _mm_shuffle_ps( weights, weights, _MM_SHUFFLE( 2, 2, 2, 2 ) );
+		__m128 w3 = _mm_shuffle_ps( weights, weights, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			m[j] = _mm_add_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( _mm_loadu_ps( &row0[j].x ), w0 ), _mm_mul_ps( _mm_loadu_ps( &row1[j].x ), w1 ) ),
+				_mm_mul_ps( _mm_loadu_ps( &row2[j].x ), w2 ) ), _mm_mul_ps( _mm_loadu_ps( &row3[j].x ), w3 ) );
+		}
+	}
+}
+
+#endif
+
+
+void ModelNode::skinVertices( const Vec4f *rows, const unsigned char *jointIndices,
+                              const VertexDataStatic *staticData, DynVertexData &dvd,
+                              uint32 first, uint32 last, uint32 influences )
+{
+	// Note: We skip the normalization of the tangent space basis for performance reasons;
+	//       the error is usually not huge and should hardly be noticable
+
+	// Note: Influences are sorted by weight, so reduced influence sets just use the first one or two
+	//       of them with renormalized weights
+	
+	uint32 i = first;
+	
+#ifdef PLATFORM_SSE
+	// Skin four vertices per iteration: the blended matrices are transposed so that each register
+	// holds one matrix element of all four vertices and the vectors are processed in SoA form
+	for( ; i + 4 <= last; i += 4 )
+	{
+		__m128 m[4][3];
+		for( uint32 k = 0; k < 4; ++k )
+			blendSkinRows( rows, &jointIndices[(i + k) * 4], staticData[i + k].weightVec, influences, m[k] );
+
+		__m128 c[3][4];  // c[row][col], lanes are vertices
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			c[j][0] = m[0][j]; c[j][1] = m[1][j]; c[j][2] = m[2][j]; c[j][3] = m[3][j];
+			_MM_TRANSPOSE4_PS( c[j][0], c[j][1], c[j][2], c[j][3] );
+		}
+
+		// Skin positions
+		__m128 x, y, z;
+		loadVec3x4( &dvd.positions[i], x, y, z );
+		storeVec3x4( &dvd.positions[i],
+			_mm_add_ps( _mm_add_ps( _mm_mul_ps( c[0][0], x ), _mm_mul_ps( c[0][1], y ) ),
+			            _mm_add_ps( _mm_mul_ps( c[0][2], z ), c[0][3] ) ),
+			_mm_add_ps( _mm_add_ps( _mm_mul_ps( c[1][0], x ), _mm_mul_ps( c[1][1], y ) ),
+			            _mm_add_ps( _mm_mul_ps( c[1][2], z ), c[1][3] ) ),
+			_mm_add_ps( _mm_add_ps( _mm_mul_ps( c[2][0], x ), _mm_mul_ps( c[2][1], y ) ),
+			            _mm_add_ps( _mm_mul_ps( c[2][2], z ), c[2][3] ) ) );
+
+		// Skin tangent space basis
+		Vec3f *basis[3] = { &dvd.normals[i], &dvd.tangents[i], &dvd.bitangents[i] };
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			loadVec3x4( basis[j], x, y, z );
+			storeVec3x4( basis[j],
+				_mm_add_ps( _mm_add_ps( _mm_mul_ps( c[0][0], x ), _mm_mul_ps( c[0][1], y ) ), _mm_mul_ps( c[0][2], z ) ),
+				_mm_add_ps( _mm_add_ps( _mm_mul_ps( c[1][0], x ), _mm_mul_ps( c[1][1], y ) ), _mm_mul_ps( c[1][2], z ) ),
+				_mm_add_ps( _mm_add_ps( _mm_mul_ps( c[2][0], x ), _mm_mul_ps( c[2][1], y ) ), _mm_mul_ps( c[2][2], z ) ) );
+		}
+	}
+#endif
+
+	// Remaining vertices
+	Vec4f m[3];
+	
+	for( ; i < last; ++i )
+	{
+		const Vec4f *row0 = &rows[jointIndices[i * 4 + 0] * 3];
+		const float *w = staticData[i].weightVec;
+
+		// Blend skinning matrix rows
+		if( influences == 1 )
+		{
+			for( uint32 j = 0; j < 3; ++j ) m[j] = row0[j];
+		}
+		else if( influences == 2 )
+		{
+			const Vec4f *row1 = &rows[jointIndices[i * 4 + 1] * 3];
+			float weightSum = w[0] + w[1];
+			float invSum = weightSum > Math::Epsilon ? 1.0f / weightSum : 1.0f;
+			float w0 = w[0] * invSum, w1 = w[1] * invSum;
+			
+			for( uint32 j = 0; j < 3; ++j )
+			{
+				m[j].x = row0[j].x * w0 + row1[j].x * w1;
+				m[j].y = row0[j].y * w0 + row1[j].y * w1;
+				m[j].z = row0[j].z * w0 + row1[j].z * w1;
+				m[j].w = row0[j].w * w0 + row1[j].w * w1;
+			}
+		}
+		else
+		{
+			const Vec4f *row1 = &rows[jointIndices[i * 4 + 1] * 3];
+			const Vec4f *row2 = &rows[jointIndices[i * 4 + 2] * 3];
+			const Vec4f *row3 = &rows[jointIndices[i * 4 + 3] * 3];
+			
+			for( uint32 j = 0; j < 3; ++j )
+			{
+				m[j].x = row0[j].x * w[0] + row1[j].x * w[1] + row2[j].x * w[2] + row3[j].x * w[3];
+				m[j].y = row0[j].y * w[0] + row1[j].y * w[1] + row2[j].y * w[2] + row3[j].y * w[3];
+				m[j].z = row0[j].z * w[0] + row1[j].z * w[1] + row2[j].z * w[2] + row3[j].z * w[3];
+				m[j].w = row0[j].w * w[0] + row1[j].w * w[1] + row2[j].w * w[2] + row3[j].w * w[3];
+			}
+		}
+
+		// Skin position
+		Vec3f &pos = dvd.positions[i];
+		pos = Vec3f( pos.x * m[0].x + pos.y * m[0].y + pos.z * m[0].z + m[0].w,
+		             pos.x * m[1].x + pos.y * m[1].y + pos.z * m[1].z + m[1].w,
+		             pos.x * m[2].x + pos.y * m[2].y + pos.z * m[2].z + m[2].w );
+
+		// Skin tangent space basis
+		Vec3f *basis[3] = { &dvd.normals[i], &dvd.tangents[i], &dvd.bitangents[i] };
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			Vec3f &vec = *basis[j];
+			vec = Vec3f( vec.x * m[0].x + vec.y * m[0].y + vec.z * m[0].z,
+			             vec.x * m[1].x + vec.y * m[1].y + vec.z * m[1].z,
+			             vec.x * m[2].x + vec.y * m[2].y + vec.z * m[2].z );
+		}
+	}
+}
+
+
+void ModelNode::skinVerticesDualQuat( const Vec4f *dualQuats, const unsigned char *jointIndices,
+                                      const VertexDataStatic *staticData, DynVertexData &dvd,
+                                      uint32 first, uint32 last, uint32 influences )
+{
+	Vec4f m[3];
+	
+	for( uint32 i = first; i < last; ++i )
+	{
+		const unsigned char *indices = &jointIndices[i * 4];
+		const float *w = staticData[i].weightVec;
+		const Vec4f &q0 = dualQuats[indices[0] * 2];
+		Vec4f r, d;
+
+		// Blend dual quaternions; quaternions in the opposite hemisphere of the first one are negated
+		// so that the blend takes the shortest path; normalization renormalizes reduced influence sets
+		for( uint32 j = 0; j < influences; ++j )
+		{
+			const Vec4f &q = dualQuats[indices[j] * 2];
+			float weight = w[j];
+			if( q.x * q0.x + q.y * q0.y + q.z * q0.z + q.w * q0.w < 0 ) weight = -weight;
+
+			r = r + q * weight;
+			d = d + dualQuats[indices[j] * 2 + 1] * weight;
+		}
+
+		float len = sqrtf( r.x * r.x + r.y * r.y + r.z * r.z + r.w * r.w );
+		if( len < Math::Epsilon ) continue;
+		r = r * (1.0f / len);
+		d = d * (1.0f / len);
+
+		// Convert to matrix rows; translation is 2 * d * conjugate( r )
+		m[0] = Vec4f( 1 - 2 * (r.y * r.y + r.z * r.z), 2 * (r.x * r.y - r.w * r.z), 2 * (r.x * r.z + r.w * r.y),
+		              2 * (r.w * d.x - d.w * r.x + r.y * d.z - r.z * d.y) );
+		m[1] = Vec4f( 2 * (r.x * r.y + r.w * r.z), 1 - 2 * (r.x * r.x + r.z * r.z), 2 * (r.y * r.z - r.w * r.x),
+		              2 * (r.w * d.y - d.w * r.y + r.z * d.x - r.x * d.z) );
+		m[2] = Vec4f( 2 * (r.x * r.z - r.w * r.y), 2 * (r.y * r.z + r.w * r.x), 1 - 2 * (r.x * r.x + r.y * r.y),
+		              2 * (r.w * d.z - d.w * r.z + r.x * d.y - r.y * d.x) );
+
+		// Skin position
+		Vec3f &pos = dvd.positions[i];
+		pos = Vec3f( pos.x * m[0].x + pos.y * m[0].y + pos.z * m[0].z + m[0].w,
+		             pos.x * m[1].x + pos.y * m[1].y + pos.z * m[1].z + m[1].w,
+		             pos.x * m[2].x + pos.y * m[2].y + pos.z * m[2].z + m[2].w );
+
+		// Skin tangent space basis
+		Vec3f *basis[3] = { &dvd.normals[i], &dvd.tangents[i], &dvd.bitangents[i] };
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			Vec3f &vec = *basis[j];
+			vec = Vec3f( vec.x * m[0].x + vec.y * m[0].y + vec.z * m[0].z,
+			             vec.x * m[1].x + vec.y * m[1].y + vec.z * m[1].z,
+			             vec.x * m[2].x + vec.y * m[2].y + vec.z * m[2].z );
+		}
+	}
+}
+
+
+void ModelNode::updateSkinDualQuats()
+{
+	// Note: Dual quaternions can only represent rotation and translation, so joint scale is lost
+	
+	if( !_skinDualQuatsDirty ) return;
+	_skinDualQuatsDirty = false;
+	
+	uint32 numJoints = (uint32)_skinMatRows.size() / 3, i = 0;
+	_skinDualQuats.resize( numJoints * 2 );
+	if( numJoints == 0 ) return;
+
+	// The rotation is converted with Shepperd's method: the quaternion component with the largest
+	// magnitude is found from the trace and the diagonal and the others are derived from it, which
+	// is stable for all angles; the result is the quaternion scaled by four times that component,
+	// where the squared component terms are signed sums of the diagonal, so it is just normalized
+#ifdef PLATFORM_SSE
+	const __m128 half = _mm_set1_ps( 0.5f ), one = _mm_set1_ps( 1.0f ), zero = _mm_setzero_ps();
+	
+	// Four joints are converted at once; after transposing, each register holds one matrix
+	// element of all four joints
+	for( ; i + 4 <= numJoints; i += 4 )
+	{
+		__m128 e[3][4];
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			for( uint32 k = 0; k < 4; ++k ) e[j][k] = _mm_loadu_ps( &_skinMatRows[(i + k) * 3 + j].x );
+			_MM_TRANSPOSE4_PS( e[j][0], e[j][1], e[j][2], e[j][3] );
+		}
+
+		__m128 m00 = e[0][0], m11 = e[1][1], m22 = e[2][2];
+		__m128 sxw = _mm_sub_ps( e[2][1], e[1][2] ), syw = _mm_sub_ps( e[0][2], e[2][0] );
+		__m128 szw = _mm_sub_ps( e[1][0], e[0][1] ), sxy = _mm_add_ps( e[0][1], e[1][0] );
+		__m128 sxz = _mm_add_ps( e[0][2], e[2][0] ), syz = _mm_add_ps( e[1][2], e[2][1] );
+		__m128 diagW = _mm_add_ps( _mm_add_ps( one, m00 ), _mm_add_ps( m11, m22 ) );
+		__m128 diagX = _mm_sub_ps( _mm_add_ps( one, m00 ), _mm_add_ps( m11, m22 ) );
+		__m128 diagY = _mm_sub_ps( _mm_add_ps( one, m11 ), _mm_add_ps( m00, m22 ) );
+		__m128 diagZ = _mm_sub_ps( _mm_add_ps( one, m22 ), _mm_add_ps( m00, m11 ) );
+
+		// Select case of largest component per joint
+		__m128 selW = _mm_cmpge_ps( diagW, _mm_max_ps( diagX, _mm_max_ps( diagY, diagZ ) ) );
+		__m128 selX = _mm_andnot_ps( selW, _mm_cmpge_ps( diagX, _mm_max_ps( diagY, diagZ ) ) );
+		__m128 selY = _mm_andnot_ps( _mm_or_ps( selW, selX ), _mm_cmpge_ps( diagY, diagZ ) );
+		__m128 selZ = _mm_andnot_ps( _mm_or_ps( _mm_or_ps( selW, selX ), selY ), _mm_cmpeq_ps( one, one ) );
+		
+		__m128 qx = _mm_or_ps( _mm_or_ps( _mm_and_ps( selW, sxw ), _mm_and_ps( selX, diagX ) ),
+		                       _mm_or_ps( _mm_and_ps( selY, sxy ), _mm_and_ps( selZ, sxz ) ) );
+		__m128 qy = _mm_or_ps( _mm_or_ps( _mm_and_ps( selW, syw ), _mm_and_ps( selX, sxy ) ),
+		                       _mm_or_ps( _mm_and_ps( selY, diagY ), _mm_and_ps( selZ, syz ) ) );
+		__m128 qz = _mm_or_ps( _mm_or_ps( _mm_and_ps( selW, szw ), _mm_and_ps( selX, sxz ) ),
+		                       _mm_or_ps( _mm_and_ps( selY, syz ), _mm_and_ps( selZ, diagZ ) ) );
+		__m128 qw = _mm_or_ps( _mm_or_ps( _mm_and_ps( selW, diagW ), _mm_and_ps( selX, sxw ) ),
+		                       _mm_or_ps( _mm_and_ps( selY, syw ), _mm_and_ps( selZ, szw ) ) );
+
+		// Normalize to reduce numerical error
+		__m128 invLen = _mm_div_ps( one, _mm_sqrt_ps( _mm_add_ps(
+			_mm_add_ps( _mm_mul_ps( qx, qx ), _mm_mul_ps( qy, qy ) ),
+			_mm_add_ps( _mm_mul_ps( qz, qz ), _mm_mul_ps( qw, qw ) ) ) ) );
+		qx = _mm_mul_ps( qx, invLen ); qy = _mm_mul_ps( qy, invLen );
+		qz = _mm_mul_ps( qz, invLen ); qw = _mm_mul_ps( qw, invLen );
+
+		// Dual part: 0.5 * translation * rotation
+		__m128 tx = _mm_mul_ps( half, e[0][3] ), ty = _mm_mul_ps( half, e[1][3] ), tz = _mm_mul_ps( half, e[2][3] );
+		__m128 dw = _mm_sub_ps( zero, _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, qx ), _mm_mul_ps( ty, qy ) ),
+		                                          _mm_mul_ps( tz, qz ) ) );
+		__m128 dx = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( tx, qw ), _mm_mul_ps( ty, qz ) ), _mm_mul_ps( tz, qy ) );
+		__m128 dy = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( ty, qw ), _mm_mul_ps( tz, qx ) ), _mm_mul_ps( tx, qz ) );
+		__m128 dz = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( tx, qy ), _mm_mul_ps( tz, qw ) ), _mm_mul_ps( ty, qx ) );
+
+		_MM_TRANSPOSE4_PS( qx, qy, qz, qw );
+		_MM_TRANSPOSE4_PS( dx, dy, dz, dw );
+		_mm_storeu_ps( &_skinDualQuats[(i + 0) * 2].x, qx );
+		_mm_storeu_ps( &_skinDualQuats[(i + 1) * 2].x, qy );
+		_mm_storeu_ps( &_skinDualQuats[(i + 2) * 2].x, qz );
+		_mm_storeu_ps( &_skinDualQuats[(i + 3) * 2].x, qw );
+		_mm_storeu_ps( &_skinDualQuats[(i + 0) * 2 + 1].x, dx );
+		_mm_storeu_ps( &_skinDualQuats[(i + 1) * 2 + 1].x, dy );
+		_mm_storeu_ps( &_skinDualQuats[(i + 2) * 2 + 1].x, dz );
+		_mm_storeu_ps( &_skinDualQuats[(i + 3) * 2 + 1].x, dw );
+	}
+#endif
+
+	for( ; i < numJoints; ++i )
+	{
+		const Vec4f *rows = &_skinMatRows[i * 3];
+		Vec4f q;
+		
+		float diagW = 1 + rows[0].x + rows[1].y + rows[2].z, diagX = 1 + rows[0].x - rows[1].y - rows[2].z;
+		float diagY = 1 - rows[0].x + rows[1].y - rows[2].z, diagZ = 1 - rows[0].x - rows[1].y + rows[2].z;
+		
+		if( diagW >= maxf( diagX, maxf( diagY, diagZ ) ) )
+			q = Vec4f( rows[2].y - rows[1].z, rows[0].z - rows[2].x, rows[1].x - rows[0].y, diagW );
+		else if( diagX >= maxf( diagY, diagZ ) )
+			q = Vec4f( diagX, rows[0].y + rows[1].x, rows[0].z + rows[2].x, rows[2].y - rows[1].z );
+		else if( diagY >= diagZ )
+			q = Vec4f( rows[0].y + rows[1].x, diagY, rows[1].z + rows[2].y, rows[0].z - rows[2].x );
+		else
+			q = Vec4f( rows[0].z + rows[2].x, rows[1].z + rows[2].y, diagZ, rows[1].x - rows[0].y );
+		q = q * (1.0f / sqrtf( q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w ));
+
+		float tx = 0.5f * rows[0].w, ty = 0.5f * rows[1].w, tz = 0.5f * rows[2].w;
+		_skinDualQuats[i * 2] = q;
+		_skinDualQuats[i * 2 + 1] = Vec4f( tx * q.w + ty * q.z - tz * q.y, ty * q.w + tz * q.x - tx * q.z,
+		                                   tx * q.y + tz * q.w - ty * q.x, -(tx * q.x + ty * q.y + tz * q.z) );
+	}
+}
+
+
+static void addMorphDiffs( Vec3f *stream, const uint32 *vertIndices, const short *values,
+                           uint32 count, float weight )
+{
+	uint32 k = 0;
+
+#ifdef PLATFORM_SSE2
+	// Dequantize four difference vectors per iteration and add them with unaligned four component
+	// accesses; the fourth lane is masked out and rewrites the following value unchanged, which
+	// requires the stream to be padded by one component (see DynVertexData)
+	const __m128 mask = _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) );
+	const __m128 w = _mm_set1_ps( weight );
+	
+	for( ; k + 4 <= count; k += 4 )
+	{
+		// x0 y0 z0 x1 y1 z1 x2 y2 | z2 x3 y3 z3
+		__m128i s0 = _mm_loadu_si128( (const __m128i *)&values[k * 3] );
+		__m128i s1 = _mm_loadl_epi64( (const __m128i *)&values[k * 3 + 8] );
+
+		// Sign extend to 32 bit by shifting the duplicated words
+		__m128 a = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s0, s0 ), 16 ) ), w );
+		__m128 b = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( s0, s0 ), 16 ) ), w );
+		__m128 c = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s1, s1 ), 16 ) ), w );
+
+		__m128 d[4];
+		d[0] = _mm_and_ps( a, mask );
+		d[1] = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 0, 3, 3 ) );
+		d[1] = _mm_and_ps( _mm_shuffle_ps( d[1], d[1], _MM_SHUFFLE( 3, 3, 2, 0 ) ), mask );
+		d[2] = _mm_and_ps( _mm_shuffle_ps( b, c, _MM_SHUFFLE( 0, 0, 3, 2 ) ), mask );
+		d[3] = _mm_and_ps( _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 3, 2, 1 ) ), mask );
+
+		// Vertices are processed one after another, so duplicate and adjacent indices are fine
+		for( uint32 j = 0; j < 4; ++j )
+		{
+			float *v = &stream[vertIndices[k + j]].x;
+			_mm_storeu_ps( v, _mm_add_ps( _mm_loadu_ps( v ), d[j] ) );
+		}
+	}
+#endif
+
+	for( ; k < count; ++k )
+	{
+		Vec3f &v = stream[vertIndices[k]];
+		v.x += values[k * 3 + 0] * weight;
+		v.y += values[k * 3 + 1] * weight;
+		v.z += values[k * 3 + 2] * weight;
+	}
+}
+
+
 bool ModelNode::updateGeometry()
 {
 	_skinningDirty |= _morpherDirty;
 	_skinningDirty &= _softwareSkinning;
 	
 	if( !_skinningDirty && !_morpherDirty ) return false;
+	bool morphChanged = _morpherDirty;
 
-	if( _baseGeoRes == 0x0 || _baseGeoRes->getVertData() == 0x0 ) return false;
 	if( _geometryRes == 0x0 || _geometryRes->getVertData() == 0x0 ) return false;
 	
-	// Reset vertices to base data
-	memcpy( _geometryRes->_vertData->memory, _baseGeoRes->_vertData->memory,
-			_geometryRes->_vertCount * sizeof( Vec3f ) * 4 );
+	VertexData &baseVD = *_geometryRes->getVertData();
+	uint32 vertCount = _geometryRes->getVertCount();
+	
+	// Create private copy of dynamic streams; static data, indices and morph targets stay shared
+	if( _dynVertData == 0x0 || _dynVertData->vertCount != vertCount )
+	{
+		releaseDynVertData();
+		_dynVertData = new DynVertexData( baseVD, vertCount );
+		_dynVertBuffer = Modules::renderer().uploadVertices( _dynVertData->memory,
+			vertCount * sizeof( Vec3f ) * 4 );
+	}
+	
+	// Reset vertices to base data; without skinning only the range affected by morph targets is reset
+	DynVertexData &vd = *_dynVertData;
+	uint32 first = 0, count = vertCount;
+	if( !_skinningDirty )
+	{
+		first = _geometryRes->_minMorphIndex;
+		count = _geometryRes->_maxMorphIndex - _geometryRes->_minMorphIndex + 1;
+	}
+	
+	std::copy( &baseVD.positions[first], &baseVD.positions[first] + count, &vd.positions[first] );
+	std::copy( &baseVD.normals[first], &baseVD.normals[first] + count, &vd.normals[first] );
+	std::copy( &baseVD.tangents[first], &baseVD.tangents[first] + count, &vd.tangents[first] );
+	std::copy( &baseVD.bitangents[first], &baseVD.bitangents[first] + count, &vd.bitangents[first] );
 
 	if( _morpherUsed )
 	{
+		Vec3f *streams[4] = { vd.positions, vd.normals, vd.tangents, vd.bitangents };
+		
 		// Recalculate vertex positions for morph targets
 		for( uint32 i = 0; i < _morphers.size(); ++i )
 		{
 			if( _morphers[i].weight > Math::Epsilon )
 			{
 				MorphTarget &mt = _geometryRes->_morphTargets[_morphers[i].index];
-				float weight = _morphers[i].weight;
+				const uint32 *vertIndices = mt.vertIndices.empty() ? 0x0 : &mt.vertIndices[0];
 				
-				for( uint32 j = 0; j < mt.diffs.size(); ++j )
+				for( uint32 j = 0; j < 4; ++j )
 				{
-					MorphDiff &md = mt.diffs[j];
-					VertexData &vd = *_geometryRes->getVertData();
-					
-					vd.positions[md.vertIndex] += md.posDiff * weight;
-					vd.normals[md.vertIndex] += md.normDiff * weight;
-					vd.tangents[md.vertIndex] += md.tanDiff * weight;
-					vd.bitangents[md.vertIndex] += md.bitanDiff * weight;
+					MorphDiffStream &ds = mt.diffStreams[j];
+					if( ds.values.empty() ) continue;
+
+					addMorphDiffs( streams[j], vertIndices, &ds.values[0], (uint32)mt.vertIndices.size(),
+					               _morphers[i].weight * ds.scale );
 				}
 			}
 		}
@@ -472,41 +1226,19 @@ bool ModelNode::updateGeometry()
 		//Timer *timer = Modules::stats().getTimer( EngineStats::CustomTime );
 		//timer->setEnabled( true );
 		
-		Matrix4f skinningMat;
-		Vec4f *rows = &_skinMatRows[0];
-		VertexData &vd = *_geometryRes->_vertData;
-
-		for( uint32 i = 0, s = _geometryRes->getVertCount(); i < s; ++i )
-		{
-			Vec4f *row0 = &rows[ftoi_r( vd.staticData[i].jointVec[0] ) * 3];
-			Vec4f *row1 = &rows[ftoi_r( vd.staticData[i].jointVec[1] ) * 3];
-			Vec4f *row2 = &rows[ftoi_r( vd.staticData[i].jointVec[2] ) * 3];
-			Vec4f *row3 = &rows[ftoi_r( vd.staticData[i].jointVec[3] ) * 3];
-
-			Vec4f weights = *((Vec4f*)&vd.staticData[i].weightVec[0]);
-
-			skinningMat.x[0] = (row0)->x * weights.x + (row1)->x * weights.y + (row2)->x * weights.z + (row3)->x * weights.w;
-			skinningMat.x[1] = (row0+1)->x * weights.x + (row1+1)->x * weights.y + (row2+1)->x * weights.z + (row3+1)->x * weights.w;
-			skinningMat.x[2] = (row0+2)->x * weights.x + (row1+2)->x * weights.y + (row2+2)->x * weights.z + (row3+2)->x * weights.w;
-			skinningMat.x[4] = (row0)->y * weights.x + (row1)->y * weights.y + (row2)->y * weights.z + (row3)->y * weights.w;
-			skinningMat.x[5] = (row0+1)->y * weights.x + (row1+1)->y * weights.y + (row2+1)->y * weights.z + (row3+1)->y * weights.w;
-			skinningMat.x[6] = (row0+2)->y * weights.x + (row1+2)->y * weights.y + (row2+2)->y * weights.z + (row3+2)->y * weights.w;
-			skinningMat.x[8] = (row0)->z * weights.x + (row1)->z * weights.y + (row2)->z * weights.z + (row3)->z * weights.w;
-			skinningMat.x[9] = (row0+1)->z * weights.x + (row1+1)->z * weights.y + (row2 + 1)->z * weights.z + (row3+1)->z * weights.w;
-			skinningMat.x[10] = (row0+2)->z * weights.x + (row1+2)->z * weights.y + (row2+2)->z * weights.z + (row3+2)->z * weights.w;
-			skinningMat.x[12] = (row0)->w * weights.x + (row1)->w * weights.y + (row2)->w * weights.z + (row3)->w * weights.w;
-			skinningMat.x[13] = (row0+1)->w * weights.x + (row1+1)->w * weights.y + (row2+1)->w * weights.z + (row3+1)->w * weights.w;
-			skinningMat.x[14] = (row0+2)->w * weights.x + (row1+2)->w * weights.y + (row2+2)->w * weights.z + (row3+2)->w * weights.w;
-
-			// Skin position
-			vd.positions[i] = skinningMat * vd.positions[i];
-
-			// Skin tangent space basis
-			// Note: We skip the normalization of the tangent space basis for performance reasons;
-			//       the error is usually not huge and should hardly be noticable
-			vd.normals[i] = skinningMat.mult33Vec( vd.normals[i] ); //.normalized();
-			vd.tangents[i] = skinningMat.mult33Vec( vd.tangents[i] ); //.normalized();
-			vd.bitangents[i] = skinningMat.mult33Vec( vd.bitangents[i] ); //.normalized();
+		_skinInfluences = calcSkinInfluences( calcLodLevelForDist( _viewDist ) );
+		
+		// Vertex ranges are independent of each other and could be skinned in parallel
+		if( _dualQuatSkinning )
+		{
+			updateSkinDualQuats();
+			skinVerticesDualQuat( &_skinDualQuats[0], &_geometryRes->_jointIndices[0], baseVD.staticData,
+			                      vd, 0, vertCount, _skinInfluences );
+		}
+		else
+		{
+			skinVertices( &_skinMatRows[0], &_geometryRes->_jointIndices[0], baseVD.staticData, vd,
+			              0, vertCount, _skinInfluences );
 		}
 
 		//timer->setEnabled( false );
@@ -514,10 +1246,8 @@ bool ModelNode::updateGeometry()
 	else if( _morpherUsed )
 	{
 		// Renormalize tangent space basis
-		for( uint32 i = 0, s = _geometryRes->getVertCount(); i < s; ++i )
+		for( uint32 i = first, s = first + count; i < s; ++i )
 		{
-			VertexData &vd = *_geometryRes->getVertData();
-			
 			vd.normals[i].normalize();
 			vd.tangents[i].normalize();
 			vd.bitangents[i].normalize();
@@ -528,8 +1258,21 @@ bool ModelNode::updateGeometry()
 	_skinningDirty = false;
 	
 	// Upload geometry
-	_geometryRes->updateDynamicVertData();
-	markMeshBBoxesDirty();
+	if( count == vertCount )
+	{
+		Modules::renderer().updateVertices( vd.memory, 0, vertCount * sizeof( Vec3f ) * 4,
+		                                    _dynVertBuffer, true );
+	}
+	else
+	{
+		// Only upload range affected by morph targets in each stream
+		for( uint32 i = 0; i < 4; ++i )
+		{
+			Modules::renderer().updateVertices( vd.memory + i * vertCount + first,
+				(i * vertCount + first) * sizeof( Vec3f ), count * sizeof( Vec3f ), _dynVertBuffer );
+		}
+	}
+	markMeshBBoxesDirty( morphChanged );
 
 	return true;
 }
@@ -538,7 +1281,13 @@ bool ModelNode::updateGeometry()
 uint32 ModelNode::calcLodLevel( const Vec3f &viewPoint )
 {
 	Vec3f pos( _absTrans.c[3][0], _absTrans.c[3][1], _absTrans.c[3][2] );
-	float dist = (pos - viewPoint).length();
+	
+	return calcLodLevelForDist( (pos - viewPoint).length() );
+}
+
+
+uint32 ModelNode::calcLodLevelForDist( float dist )
+{
 	uint32 curLod = 4;
 	
 	if( dist < _lodDist1 ) curLod = 0;
@@ -550,12 +1299,61 @@ uint32 ModelNode::calcLodLevel( const Vec3f &viewPoint )
 }
 
 
+uint32 ModelNode::calcSkinInfluences( uint32 lodLevel )
+{
+	if( !_skinWeightLod ) return 4;
+	
+	// Influences are sorted by weight, so lower LODs just drop the smallest ones
+	if( lodLevel == 0 ) return 4;
+	else if( lodLevel == 1 ) return 2;
+	else return 1;
+}
+
+
+AnimLodLevels::List ModelNode::calcAnimLodLevel()
+{
+	uint32 frameID = Modules::renderer().getFrameID();
+
+	// Models that were not drawn in the current or previous frame keep their last pose
+	if( Modules::config().animationCulling && frameID - _visibleFrame > 1 )
+		return AnimLodLevels::Skipped;
+	
+	if( _viewDist >= _animLodDist2 ) return AnimLodLevels::Skipped;
+	if( _viewDist >= _animLodDist1 )
+	{
+		// Evaluate animation at most every second frame
+		if( frameID - _animFrame < 2 ) return AnimLodLevels::Skipped;
+		return AnimLodLevels::Reduced;
+	}
+
+	return AnimLodLevels::Full;
+}
+
+
 void ModelNode::onPostUpdate()
 {
 	if( _nodeListDirty ) recreateNodeList();
+
+	// Transformations set manually on joint nodes need to be applied to the skeleton
+	for( size_t i = 0, s = _skeleton.size(); i < s && !_skeletonDirty; ++i )
+	{
+		JointNode *node = _skeleton[i].node;
+		if( node != 0x0 && node->_ignoreAnim && node->_dirty ) _skeletonDirty = true;
+	}
 	
-	if( _animDirty )
-	{	
+	// Animation LOD: skipped animation remains dirty and is caught up later
+	AnimLodLevels::List animLod = _animDirty ? calcAnimLodLevel() : AnimLodLevels::Skipped;
+	
+	if( _animDirty && animLod != AnimLodLevels::Skipped )
+	{
+		Modules::stats().incStat( animLod == AnimLodLevels::Reduced ?
+			EngineStats::AnimReducedCount : EngineStats::AnimFullCount, 1 );
+		
+		// At reduced rate only nodes up to the specified hierarchy depth are animated
+		uint32 maxDepth = (uint32)-1;
+		if( animLod == AnimLodLevels::Reduced && _animLodJointDepth > 0 ) maxDepth = _animLodJointDepth;
+		
+		_animFrame = Modules::renderer().getFrameID();
 		_skinningDirty = true;
 		_animDirty = false;
 		
@@ -569,178 +1367,239 @@ void ModelNode::onPostUpdate()
 				activeStages.push_back( i );
 		}
 
-		// Animate
-		if( Modules::config().fastAnimation && activeStages.size() == 1 )
+		// Animate nodes and skeleton joints
+		for( size_t i = 0, s = _nodeList.size(); i < s; ++i )
 		{
-			uint32 firstStage = activeStages[0];
-			
-			// Fast animation path
-			for( size_t i = 0, s =_nodeList.size(); i < s; ++i )
+			// Ignore animation if node transformation was set manually
+			if( _nodeList[i].node->_ignoreAnim )
 			{
-				// Ignore animation if node transformation was set manually
-				if( _nodeList[i].node->_ignoreAnim )
-				{
-					_nodeList[i].node->_ignoreAnim = false;
-					continue;
-				}
-				
-				AnimResEntity *ae = _nodeList[i].animEntities[firstStage];
-				if( ae != 0x0 && !ae->frames.empty() )
-				{
-					uint32 frame = (uint32)ftoi_t( _animStages[firstStage]->animTime ) % ae->frames.size();
-					if( ae->frames.size() == 1 ) frame = 0;		// Animation compression
-					_nodeList[i].node->getRelTrans() = ae->frames[frame].bakedTransMat;
-				}
+				_nodeList[i].node->_ignoreAnim = false;
+				continue;
 			}
+			if( _nodeList[i].depth > maxDepth ) continue;
+
+			animateEntity( _nodeList[i].animEntities, activeStages, _nodeList[i].node->_relTrans );
 		}
-		else
+
+		for( size_t i = 0, s = _skeleton.size(); i < s; ++i )
 		{
-			Quaternion nodeRotQuat;
-			Vec3f nodeTransVec, nodeScaleVec;
+			SkelJoint &joint = _skeleton[i];
 			
-			for( size_t i = 0, s = _nodeList.size(); i < s; ++i )
+			if( joint.node != 0x0 && joint.node->_ignoreAnim )
 			{
-				// Ignore animation if node transformation was set manually
-				if( _nodeList[i].node->_ignoreAnim )
+				joint.node->_ignoreAnim = false;
+				joint.relTrans = joint.node->_relTrans;
+				continue;
+			}
+			if( joint.depth > maxDepth ) continue;
+
+			animateEntity( joint.animEntities, activeStages, joint.relTrans );
+		}
+
+		_skeletonDirty = true;
+	}
+	else if( _animDirty )
+	{
+		Modules::stats().incStat( EngineStats::AnimSkippedCount, 1 );
+	}
+
+	// Skinning matrices and bounding boxes are adapted in the skeleton pass
+	if( _skeletonDirty ) updateSkeleton();
+}
+
+
+void ModelNode::animateEntity( AnimResEntity **animEntities, const vector< uint32 > &activeStages,
+                               Matrix4f &relTrans )
+{
+	if( Modules::config().fastAnimation && activeStages.size() == 1 )
+	{
+		// Fast animation path
+		AnimResEntity *ae = animEntities[activeStages[0]];
+		if( ae != 0x0 && !ae->frames.empty() )
+		{
+			uint32 frame = (uint32)ftoi_t( _animStages[activeStages[0]]->animTime ) % ae->frames.size();
+			if( ae->frames.size() == 1 ) frame = 0;		// Animation compression
+			relTrans = ae->frames[frame].bakedTransMat;
+		}
+		return;
+	}
+	
+	Quaternion nodeRotQuat;
+	Vec3f nodeTransVec, nodeScaleVec;
+	bool firstStage = true;
+	float weightAccum = 0.0f;
+
+	for( size_t j = 0, s = activeStages.size(); j < s; ++j )
+	{
+		uint32 stageIdx = activeStages[j];
+		AnimStage &curStage = *_animStages[stageIdx];
+	
+		// Ignore stages with a blend weight near zero
+		if( curStage.blendWeight < 0.0001f && !curStage.additive ) continue;
+
+		if( animEntities[stageIdx] == 0x0 ) continue;
+		uint32 numFrames = (uint32)animEntities[stageIdx]->frames.size();
+		
+		if( numFrames > 0 )
+		{
+			float weight = curStage.blendWeight;
+			if( weightAccum + weight > 1.0f ) weight = 1.0f - weightAccum;
+
+			// Fast animation with sampled frame data
+			if( Modules::config().fastAnimation )
+			{
+				uint32 f0 = ftoi_t( curStage.animTime ) % numFrames;
+				if( numFrames == 1 ) f0 = 0;	// Animation compression
+				Frame &frame = animEntities[stageIdx]->frames[f0];
+				
+				if( firstStage )
 				{
-					_nodeList[i].node->_ignoreAnim = false;
-					continue;
+					// Ignore additive stages that are before a non-additive one
+					if( !curStage.additive )
+					{
+						firstStage = false;
+						weightAccum = curStage.blendWeight;
+						nodeRotQuat = frame.rotQuat;
+						nodeTransVec = frame.transVec;
+						nodeScaleVec = frame.scaleVec;
+					}
 				}
+				else
+				{
+					if( curStage.additive )
+					{
+						// Add the difference to the first frame of the animation
+						Frame &firstFrame = animEntities[stageIdx]->frames[0];
+						
+						nodeRotQuat *= firstFrame.rotQuat.inverted() * frame.rotQuat;
+						nodeTransVec += frame.transVec - firstFrame.transVec;
+						nodeScaleVec.x *= 1 / firstFrame.scaleVec.x * frame.scaleVec.x;
+						nodeScaleVec.y *= 1 / firstFrame.scaleVec.y * frame.scaleVec.y;
+						nodeScaleVec.z *= 1 / firstFrame.scaleVec.z * frame.scaleVec.z;
+					}
+					else if( weightAccum < 1.0f )
+					{
+						float blend = weightAccum / (weightAccum + weight);
 				
-				bool firstStage = true;
-				float weightAccum = 0.0f;
+						nodeRotQuat = frame.rotQuat.slerp( nodeRotQuat, blend );
+						nodeTransVec = frame.transVec.lerp( nodeTransVec, blend );
+						nodeScaleVec = frame.scaleVec.lerp( nodeScaleVec, blend );
 
-				for( size_t j = 0, s = activeStages.size(); j < s; ++j )
-				{
-					uint32 stageIdx = activeStages[j];
-					AnimStage &curStage = *_animStages[stageIdx];
+						weightAccum += curStage.blendWeight;
+					}
+				}
+			}
+			else	// Animation with inter-frame interpolation
+			{
+				uint32 f0 = ftoi_t( curStage.animTime );
+				float amount = curStage.animTime - f0;
+				f0 = f0 % numFrames;
+				uint32 f1 = f0 + 1;
+				if( f1 > numFrames - 1 ) f1 = numFrames - 1;
+
+				if( numFrames == 1 ) f0 = f1 = 0;	// Animation compression
+				
+				Frame &frame0 = animEntities[stageIdx]->frames[f0];
+				Frame &frame1 = animEntities[stageIdx]->frames[f1];
 				
-					// Ignore stages with a blend weight near zero
-					if( curStage.blendWeight < 0.0001f && !curStage.additive ) continue;
+				// Inter-frame interpolation
+				Vec3f transVec( frame0.transVec.lerp( frame1.transVec, amount ) );
+				Vec3f scaleVec( frame0.scaleVec.lerp( frame1.scaleVec, amount ) );
+				Quaternion rotQuat( frame0.rotQuat.slerp( frame1.rotQuat, amount ) );
 
-					if( _nodeList[i].animEntities[stageIdx] == 0x0 ) continue;
-					uint32 numFrames = (uint32)_nodeList[i].animEntities[stageIdx]->frames.size();
-					
-					if( numFrames > 0 )
+				if( firstStage )
+				{
+					// Ignore additive stages that are before a non-additive one
+					if( !curStage.additive )
 					{
-						float weight = curStage.blendWeight;
-						if( weightAccum + weight > 1.0f ) weight = 1.0f - weightAccum;
-
-						// Fast animation with sampled frame data
-						if( Modules::config().fastAnimation )
-						{
-							uint32 f0 = ftoi_t( curStage.animTime ) % numFrames;
-							if( numFrames == 1 ) f0 = 0;	// Animation compression
-							Frame &frame = _nodeList[i].animEntities[stageIdx]->frames[f0];
-							
-							if( firstStage )
-							{
-								// Ignore additive stages that are before a non-additive one
-								if( !curStage.additive )
-								{
-									firstStage = false;
-									weightAccum = curStage.blendWeight;
-									nodeRotQuat = frame.rotQuat;
-									nodeTransVec = frame.transVec;
-									nodeScaleVec = frame.scaleVec;
-								}
-							}
-							else
-							{
-								if( curStage.additive )
-								{
-									// Add the difference to the first frame of the animation
-									Frame &firstFrame = _nodeList[i].animEntities[stageIdx]->frames[0];
-									
-									nodeRotQuat *= firstFrame.rotQuat.inverted() * frame.rotQuat;
-									nodeTransVec += frame.transVec - firstFrame.transVec;
-									nodeScaleVec.x *= 1 / firstFrame.scaleVec.x * frame.scaleVec.x;
-									nodeScaleVec.y *= 1 / firstFrame.scaleVec.y * frame.scaleVec.y;
-									nodeScaleVec.z *= 1 / firstFrame.scaleVec.z * frame.scaleVec.z;
-								}
-								else if( weightAccum < 1.0f )
-								{
-									float blend = weightAccum / (weightAccum + weight);
-							
-									nodeRotQuat = frame.rotQuat.slerp( nodeRotQuat, blend );
-									nodeTransVec = frame.transVec.lerp( nodeTransVec, blend );
-									nodeScaleVec = frame.scaleVec.lerp( nodeScaleVec, blend );
-
-									weightAccum += curStage.blendWeight;
-								}
-							}
-						}
-						else	// Animation with inter-frame interpolation
-						{
-							uint32 f0 = ftoi_t( curStage.animTime );
-							float amount = curStage.animTime - f0;
-							f0 = f0 % numFrames;
-							uint32 f1 = f0 + 1;
-							if( f1 > numFrames - 1 ) f1 = numFrames - 1;
-
-							if( numFrames == 1 ) f0 = f1 = 0;	// Animation compression
-							
-							Frame &frame0 = _nodeList[i].animEntities[stageIdx]->frames[f0];
-							Frame &frame1 = _nodeList[i].animEntities[stageIdx]->frames[f1];
-							
-							// Inter-frame interpolation
-							Vec3f transVec( frame0.transVec.lerp( frame1.transVec, amount ) );
-							Vec3f scaleVec( frame0.scaleVec.lerp( frame1.scaleVec, amount ) );
-							Quaternion rotQuat( frame0.rotQuat.slerp( frame1.rotQuat, amount ) );
-
-							if( firstStage )
-							{
-								// Ignore additive stages that are before a non-additive one
-								if( !curStage.additive )
-								{
-									firstStage = false;
-									weightAccum = curStage.blendWeight;
-									nodeRotQuat = rotQuat;
-									nodeTransVec = transVec;
-									nodeScaleVec = scaleVec;
-								}
-							}
-							else
-							{
-								if( curStage.additive )
-								{
-									// Add the difference to the first frame of the animation
-									Frame &firstFrame = _nodeList[i].animEntities[stageIdx]->frames[0];
-									
-									nodeRotQuat *= firstFrame.rotQuat.inverted() * rotQuat;
-									nodeTransVec += transVec - firstFrame.transVec;
-									nodeScaleVec.x *= 1 / firstFrame.scaleVec.x * scaleVec.x;
-									nodeScaleVec.y *= 1 / firstFrame.scaleVec.y * scaleVec.y;
-									nodeScaleVec.z *= 1 / firstFrame.scaleVec.z * scaleVec.z;
-								}
-								else if( weightAccum < 1.0f )
-								{
-									// Interpolate between animation and current state from previous animations
-									float blend = weightAccum / (weightAccum + weight);
-									
-									nodeRotQuat = rotQuat.slerp( nodeRotQuat, blend );
-									nodeTransVec = transVec.lerp( nodeTransVec, blend );
-									nodeScaleVec = scaleVec.lerp( nodeScaleVec, blend );
-
-									weightAccum += curStage.blendWeight;
-								}
-							}
-						}
+						firstStage = false;
+						weightAccum = curStage.blendWeight;
+						nodeRotQuat = rotQuat;
+						nodeTransVec = transVec;
+						nodeScaleVec = scaleVec;
+					}
+				}
+				else
+				{
+					if( curStage.additive )
+					{
+						// Add the difference to the first frame of the animation
+						Frame &firstFrame = animEntities[stageIdx]->frames[0];
+						
+						nodeRotQuat *= firstFrame.rotQuat.inverted() * rotQuat;
+						nodeTransVec += transVec - firstFrame.transVec;
+						nodeScaleVec.x *= 1 / firstFrame.scaleVec.x * scaleVec.x;
+						nodeScaleVec.y *= 1 / firstFrame.scaleVec.y * scaleVec.y;
+						nodeScaleVec.z *= 1 / firstFrame.scaleVec.z * scaleVec.z;
+					}
+					else if( weightAccum < 1.0f )
+					{
+						// Interpolate between animation and current state from previous animations
+						float blend = weightAccum / (weightAccum + weight);
+						
+						nodeRotQuat = rotQuat.slerp( nodeRotQuat, blend );
+						nodeTransVec = transVec.lerp( nodeTransVec, blend );
+						nodeScaleVec = scaleVec.lerp( nodeScaleVec, blend );
+
+						weightAccum += curStage.blendWeight;
 					}
 				}
-
-				// Build matrix from animation data
-				Matrix4f mat( Math::NO_INIT );
-				Matrix4f::fastMult43( mat, Matrix4f( nodeRotQuat ),
-				                      Matrix4f::ScaleMat( nodeScaleVec.x, nodeScaleVec.y, nodeScaleVec.z ) );
-				Matrix4f::fastMult43( _nodeList[i].node->_relTrans,
-				                      Matrix4f::TransMat( nodeTransVec.x, nodeTransVec.y, nodeTransVec.z ), mat );
 			}
 		}
+	}
 
-		// Mark transformed nodes as dirty
-		markDirty();
+	// Nodes without entities in any non-additive stage keep their transformation
+	if( firstStage ) return;
+
+	// Build matrix from animation data
+	Matrix4f mat( Math::NO_INIT );
+	Matrix4f::fastMult43( mat, Matrix4f( nodeRotQuat ),
+	                      Matrix4f::ScaleMat( nodeScaleVec.x, nodeScaleVec.y, nodeScaleVec.z ) );
+	Matrix4f::fastMult43( relTrans, Matrix4f::TransMat( nodeTransVec.x, nodeTransVec.y, nodeTransVec.z ), mat );
+}
+
+
+void ModelNode::updateSkeleton()
+{
+	_skeletonDirty = false;
+	
+	for( size_t i = 0, s = _skeleton.size(); i < s; ++i )
+	{
+		SkelJoint &joint = _skeleton[i];
+
+		// Transformation was set manually on joint node
+		if( joint.node != 0x0 && joint.node->_ignoreAnim ) joint.relTrans = joint.node->_relTrans;
+		
+		// Parents are stored before their children, so a single pass is enough
+		if( joint.parent == (uint32)-1 )
+			joint.relModelMat = joint.relTrans;
+		else
+			Matrix4f::fastMult43( joint.relModelMat, _skeleton[joint.parent].relModelMat, joint.relTrans );
+
+		if( _geometryRes != 0x0 && jointExists( joint.jointIndex ) )
+		{
+			Matrix4f mat( Math::NO_INIT );
+			Matrix4f::fastMult43( mat, joint.relModelMat, _geometryRes->getInvBindMat( joint.jointIndex ) );
+			setSkinningMat( joint.jointIndex, mat );
+		}
+
+		// Sync scene node of joint
+		if( joint.node != 0x0 )
+		{
+			joint.node->_relTrans = joint.relTrans;
+			joint.node->_relModelMat = joint.relModelMat;
+			if( !joint.node->_dirty )
+			{
+				joint.node->_dirty = true;
+				joint.node->_transformed = true;
+				joint.node->markChildrenDirty();
+			}
+		}
 	}
+
+	// Mark transformed nodes as dirty and adapt bounding boxes to new skinning matrices
+	_skinningDirty = true;
+	markMeshBBoxesDirty( false );
 }
 
 
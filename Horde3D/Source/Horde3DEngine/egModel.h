@@ -50,7 +50,13 @@ struct ModelNodeParams
 		LodDist1,
 		LodDist2,
 		LodDist3,
-		LodDist4
+		LodDist4,
+		AnimLodDist1,
+		AnimLodDist2,
+		AnimLodJointDepth,
+		DualQuatSkinning,
+		SkinWeightLod,
+		JointHitboxes
 	};
 };
 
@@ -60,12 +66,16 @@ struct ModelNodeTpl : public SceneNodeTpl
 {
 	PGeometryResource  geoRes;
 	float              lodDist1, lodDist2, lodDist3, lodDist4;
-	bool               softwareSkinning;
+	float              animLodDist1, animLodDist2;
+	int                animLodJointDepth;
+	bool               softwareSkinning, dualQuatSkinning, skinWeightLod, jointHitboxes;
 
 	ModelNodeTpl( const std::string &name, GeometryResource *geoRes ) :
-		SceneNodeTpl( SceneNodeTypes::Model, name ), geoRes( geoRes ), softwareSkinning( false ),
+		SceneNodeTpl( SceneNodeTypes::Model, name ), geoRes( geoRes ),
 			lodDist1( Math::MaxFloat ), lodDist2( Math::MaxFloat ),
-			lodDist3( Math::MaxFloat ), lodDist4( Math::MaxFloat )
+			lodDist3( Math::MaxFloat ), lodDist4( Math::MaxFloat ),
+			animLodDist1( Math::MaxFloat ), animLodDist2( Math::MaxFloat ), animLodJointDepth( 0 ),
+			softwareSkinning( false ), dualQuatSkinning( false ), skinWeightLod( false ), jointHitboxes( false )
 	{
 	}
 };
@@ -86,24 +96,67 @@ struct AnimStage
 	float               blendWeight;
 	std::string         startNode;
 	bool                additive;
+
+	// Engine playback
+	float               speed;  // Frames per second (0: time is set by application)
+	bool                loop;
+	float               fadeTarget, fadeSpeed;  // Blend weight fading (speed 0: no fading)
+
+
+	AnimStage() :
+		animTime( 0 ), blendWeight( 0 ), additive( false ), speed( 0 ), loop( true ),
+		fadeTarget( 0 ), fadeSpeed( 0 )
+	{
+	}
+};
+
+struct AnimLodLevels
+{
+	enum List
+	{
+		Full = 0,
+		Reduced,
+		Skipped
+	};
 };
 
 struct NodeListEntry
 {
 	AnimatableSceneNode  *node;
 	AnimResEntity        *animEntities[MaxNumAnimStages];
+	uint32               depth;  // Depth of node in hierarchy below model
 
 
 	NodeListEntry()
 	{
 		node = 0x0;
+		depth = 0;
 		for( uint32 i = 0; i < MaxNumAnimStages; ++i ) animEntities[i] = 0x0;
 	}
 
-	NodeListEntry( AnimatableSceneNode *node )
+	NodeListEntry( AnimatableSceneNode *node, uint32 depth )
 	{
-		NodeListEntry();
 		this->node = node;
+		this->depth = depth;
+		for( uint32 i = 0; i < MaxNumAnimStages; ++i ) animEntities[i] = 0x0;
+	}
+};
+
+struct SkelJoint	// Joint of flat skeleton; parents are always stored before their children
+{
+	std::string    name;
+	uint32         parent;  // Index of parent joint in skeleton (-1: model)
+	uint32         jointIndex;  // Index of joint in Geometry resource
+	uint32         depth;  // Depth of joint in hierarchy below model
+	Matrix4f       relTrans, relModelMat;  // Transformation relative to parent and to model
+	JointNode      *node;  // Scene node of joint, only created on demand
+	AnimResEntity  *animEntities[MaxNumAnimStages];
+
+
+	SkelJoint( const std::string &name, uint32 parent, uint32 jointIndex, uint32 depth ) :
+		name( name ), parent( parent ), jointIndex( jointIndex ), depth( depth ), node( 0x0 )
+	{
+		for( uint32 i = 0; i < MaxNumAnimStages; ++i ) animEntities[i] = 0x0;
 	}
 };
 
@@ -114,30 +167,55 @@ class ModelNode : public SceneNode
 protected:
 
 	PGeometryResource             _geometryRes;
-	PGeometryResource             _baseGeoRes;	// NULL if model does not have a private geometry copy
+	DynVertexData                 *_dynVertData;  // NULL if model does not have private dynamic streams
+	uint32                        _dynVertBuffer;  // GPU buffer holding private dynamic streams
 	float                         _lodDist1, _lodDist2, _lodDist3, _lodDist4;
+	float                         _animLodDist1, _animLodDist2;
+	uint32                        _animLodJointDepth;  // Max joint depth animated at reduced rate (0: all)
 	std::vector< Vec4f >          _skinMatRows;
+	std::vector< Vec4f >          _skinDualQuats;  // Real and dual part for each joint
 	
 	uint32                        _meshCount;  // Number of meshes in _animatedNodes
-	std::vector< NodeListEntry >  _nodeList;  // List of the model's meshes followed by joints
+	std::vector< NodeListEntry >  _nodeList;  // List of the model's meshes followed by joint nodes
+	std::vector< SkelJoint >      _skeleton;  // Joints loaded with the model
+	bool                          _skeletonDirty;
 	AnimStage                     *_animStages[MaxNumAnimStages];
 
 	std::vector< Morpher >        _morphers;
 	bool                          _softwareSkinning, _skinningDirty;
+	bool                          _dualQuatSkinning, _skinDualQuatsDirty;
+	bool                          _skinWeightLod;  // Reduce joint influences per vertex for LOD levels
+	uint32                        _skinInfluences;  // Influences per vertex used for software skinning
+	bool                          _jointHitboxes;  // Use joint hitboxes of geometry for ray tests
 	bool                          _animDirty;  // Animation has changed	
 	bool                          _nodeListDirty;  // An animatable node has been attached to model
 	bool                          _morpherUsed, _morpherDirty;
 	
 	std::vector< uint32 >         _occQueries;
 	std::vector< uint32 >         _lastVisited;
+	uint32                        _visibleFrame;  // Last frame in which model was drawn
+	float                         _viewDist;  // Distance to camera when model was drawn last time
+	uint32                        _animFrame;  // Last frame in which animation was evaluated
 
 	ModelNode( const ModelNodeTpl &modelTpl );
-	void recreateNodeListRec( SceneNode *node, bool firstCall );
+	void recreateNodeListRec( SceneNode *node, uint32 depth );
 	void updateStageAnimations( uint32 stage, const std::string &startNode );
-	void markMeshBBoxesDirty();
+	void addSkeletonJointsRec( JointNodeTpl &jointTpl, uint32 parent, uint32 depth );
+	void animateEntity( AnimResEntity **animEntities, const std::vector< uint32 > &activeStages,
+	                    Matrix4f &relTrans );
+	void updateSkeleton();
+	void markMeshBBoxesDirty( bool geometryChanged );
+	void releaseDynVertData();
+	static void skinVertices( const Vec4f *rows, const unsigned char *jointIndices,
+	                          const VertexDataStatic *staticData, DynVertexData &dvd,
+	                          uint32 first, uint32 last, uint32 influences );
+	static void skinVerticesDualQuat( const Vec4f *dualQuats, const unsigned char *jointIndices,
+	                                  const VertexDataStatic *staticData, DynVertexData &dvd,
+	                                  uint32 first, uint32 last, uint32 influences );
 
 	void onPostUpdate();
 	void onFinishedUpdate();
+	bool onAdvanceTime( float timeDelta );
 
 public:
 
@@ -149,26 +227,49 @@ public:
 	void recreateNodeList();
 	bool setupAnimStage( int stage, uint32 animRes, const std::string &startNode, bool additive );
 	bool setAnimParams( int stage, float time, float weight );
+	bool setAnimPlayback( int stage, float speed, bool loop );
+	bool fadeAnimStage( int stage, float weight, float fadeTime );
 	bool setMorphParam( const std::string &targetName, float weight );
+	JointNode *createJointNode( uint32 skelIndex );
+	void createJointNodes( const std::string &name );
+	void createChildJointNodes( uint32 parentSkelIndex );
 
 	float getParamf( int param );
 	bool setParamf( int param, float value );
 	int getParami( int param );
 	bool setParami( int param, int value );
+	bool checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, Vec3f &intsPos ) const;
 
 	bool updateGeometry();
+	void updateSkinDualQuats();
 	uint32 calcLodLevel( const Vec3f &viewPoint );
+	uint32 calcLodLevelForDist( float dist );
+	uint32 calcSkinInfluences( uint32 lodLevel );
+	AnimLodLevels::List calcAnimLodLevel();
+	bool checkAnimPending() { return _animDirty && calcAnimLodLevel() != AnimLodLevels::Skipped; }
+	bool usesJointHitboxes() const
+		{ return _jointHitboxes && _geometryRes != 0x0 && _geometryRes->_joints.size() > 1; }
+	bool checkSkinLodChanged()
+		{ return _softwareSkinning && calcSkinInfluences( calcLodLevelForDist( _viewDist ) ) != _skinInfluences; }
 
 	GeometryResource *getGeometryResource() { return _geometryRes; }
+	Vec3f *getVertPositions()
+		{ if( _geometryRes == 0x0 || _geometryRes->getVertData() == 0x0 ) return 0x0;
+		  if( _dynVertData != 0x0 && _dynVertData->vertCount == _geometryRes->getVertCount() )
+			  return _dynVertData->positions;
+		  return _geometryRes->getVertData()->positions; }
 	bool jointExists( uint32 jointIndex ) { return jointIndex < _skinMatRows.size() / 3; }
 	void setSkinningMat( uint32 index, const Matrix4f &mat )
 		{ _skinMatRows[index * 3 + 0] = mat.getRow( 0 );
 		  _skinMatRows[index * 3 + 1] = mat.getRow( 1 );
-		  _skinMatRows[index * 3 + 2] = mat.getRow( 2 ); }
+		  _skinMatRows[index * 3 + 2] = mat.getRow( 2 );
+		  _skinDualQuatsDirty = true; }
 	void markNodeListDirty() { _nodeListDirty = true; }
 
 	friend class SceneManager;
 	friend class Renderer;
+	friend class MeshNode;
+	friend class JointNode;
 };
 
 #endif // _egModel_H_
@@ -50,8 +50,13 @@ void Modules::init()
 
 void Modules::release()
 {
-	// Remove overlays since they reference resources and resource manager is removed before renderer
-	if( _renderer ) _renderer->clearOverlays();
+	// Remove overlays since they reference resources and resource manager is removed before renderer;
+	// static batches reference meshes and own geometry that needs the renderer for releasing its buffers
+	if( _renderer )
+	{
+		_renderer->clearOverlays();
+		_renderer->clearStaticBatches();
+	}
 	
 	// Order of destruction is important
 	delete _extensionManager; _extensionManager = 0x0;
@@ -314,6 +314,7 @@ EmitterNode::EmitterNode( const EmitterNodeTpl &emitterTpl ) :
 
 	_timeDelta = 0;
 	_emissionAccum = 0;
+	_playbackRate = 0;
 
 	_particles = 0x0;
 	_parPositions = 0x0;
@@ -444,6 +445,8 @@ float EmitterNode::getParamf( int param )
 		return _force.y;
 	case EmitterNodeParams::ForceZ:
 		return _force.z;
+	case EmitterNodeParams::PlaybackRate:
+		return _playbackRate;
 	default:
 		return SceneNode::getParamf( param );
 	}
@@ -472,6 +475,11 @@ bool EmitterNode::setParamf( int param, float value )
 	case EmitterNodeParams::ForceZ:
 		_force.z = value;
 		return true;
+	case EmitterNodeParams::PlaybackRate:
+		if( value < 0 ) return false;
+		_playbackRate = value;
+		if( value > 0 ) Modules::sceneMan().addPlaybackNode( *this );
+		return true;
 	default:
 		return SceneNode::setParamf( param, value );
 	}
@@ -551,6 +559,17 @@ void EmitterNode::advanceTime( float timeDelta )
 }
 
 
+bool EmitterNode::onAdvanceTime( float timeDelta )
+{
+	if( _playbackRate <= 0 ) return false;
+
+	// Finished emitters stay registered since changing their parameters can restart them
+	if( !hasFinished() ) advanceTime( timeDelta * _playbackRate );
+
+	return true;
+}
+
+
 bool EmitterNode::hasFinished()
 {
 	if( _respawnCount < 0 ) return false;
@@ -130,7 +130,8 @@ struct EmitterNodeParams
 		SpreadAngle,
 		ForceX,
 		ForceY,
-		ForceZ
+		ForceZ,
+		PlaybackRate
 	};
 };
 
@@ -178,6 +179,7 @@ protected:
 	// Emitter data
 	float                    _timeDelta;
 	float                    _emissionAccum;
+	float                    _playbackRate;  // Time scale for engine playback (0: advanced by application)
 	
 	// Emitter params
 	PMaterialResource        _materialRes;
@@ -200,6 +202,7 @@ protected:
 	void setMaxParticleCount( uint32 maxParticleCount );
 
 	void onPostUpdate();
+	bool onAdvanceTime( float timeDelta );
 
 public:
 	
@@ -55,24 +55,15 @@ void PipelineResource::release()
 {
 	destroyRenderTargets();
 
-	for( uint32 i = 0; i < _stages.size(); ++i )
+	for( uint32 i = 0; i < _cmdResources.size(); ++i )
 	{
-		for( uint32 j = 0; j < _stages[i].commands.size(); ++j )
-		{
-			for( uint32 k = 0; k < _stages[i].commands[j].valParams.size(); ++k )
-			{
-				delete _stages[i].commands[j].valParams[k];
-			}
-
-			for( uint32 k = 0; k < _stages[i].commands[j].resParams.size(); ++k )
-			{
-				Modules::resMan().removeResource( _stages[i].commands[j].resParams[k], false );
-			}
-		}
+		Modules::resMan().removeResource( _cmdResources[i], false );
 	}
 
 	_renderTargets.clear();
 	_stages.clear();
+	_strings.clear();
+	_cmdResources.clear();
 }
 
 
@@ -91,6 +82,32 @@ bool PipelineResource::raiseError( const string &msg, int line )
 }
 
 
+uint32 PipelineResource::addString( const string &str )
+{
+	for( uint32 i = 0; i < _strings.size(); ++i )
+		if( _strings[i] == str ) return i;
+
+	_strings.push_back( str );
+	return (uint32)_strings.size() - 1;
+}
+
+
+RenderingOrder::List PipelineResource::parseRenderingOrder( const char *order )
+{
+	if( strcmp( order, "FRONT_TO_BACK" ) == 0 ) return RenderingOrder::FrontToBack;
+	else if( strcmp( order, "BACK_TO_FRONT" ) == 0 ) return RenderingOrder::BackToFront;
+	else if( strcmp( order, "STATECHANGES" ) == 0 ) return RenderingOrder::StateChanges;
+	else return RenderingOrder::None;
+}
+
+
+static bool parseFlag( XMLNode &node, const char *name )
+{
+	return _stricmp( node.getAttribute( name, "false" ), "true" ) == 0 ||
+	       _stricmp( node.getAttribute( name, "0" ), "1" ) == 0;
+}
+
+
 const string PipelineResource::parseStage( XMLNode &node, PipelineStage &stage )
 {
 	stage.id = node.getAttribute( "id", "" );
@@ -116,29 +133,29 @@ const string PipelineResource::parseStage( XMLNode &node, PipelineStage &stage )
 		{
 			if( node1.getAttribute( "target" ) == 0x0 ) return "Missing SwitchTarget attribute 'target'";
 			
-			if( strcmp( node1.getAttribute( "target" ), "" ) == 0 )
+			PipelineCommand cmd( PipelineCommands::SwitchTarget );
+			if( strcmp( node1.getAttribute( "target" ), "" ) != 0 )
 			{
-				stage.commands.push_back( PipelineCommand( PipelineCommands::SwitchTarget ) );
-				stage.commands.back().refParams.push_back( 0x0 );
-			}
-			else
-			{
-				if( findRenderTarget( node1.getAttribute( "target" ) ) == 0x0 ) return "Reference to undefined render target in SwitchTarget";
-				stage.commands.push_back( PipelineCommand( PipelineCommands::SwitchTarget ) );
-				stage.commands.back().refParams.push_back( findRenderTarget( node1.getAttribute( "target" ) ) );
+				cmd.params.switchTarget.target = findRenderTarget( node1.getAttribute( "target" ) );
+				if( cmd.params.switchTarget.target == 0x0 )
+					return "Reference to undefined render target in SwitchTarget";
 			}
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "BindBuffer" ) == 0 )
 		{
 			if( node1.getAttribute( "sampler" ) == 0x0 || node1.getAttribute( "sourceRT" ) == 0x0 ||
 				node1.getAttribute( "bufIndex" ) == 0x0 ) return "Missing BindBuffer attribute";
-			if( findRenderTarget( node1.getAttribute( "sourceRT" ) ) == 0x0 ) return "Reference to undefined render target in BindBuffer";
-			stage.commands.push_back( PipelineCommand( PipelineCommands::BindBuffer ) );
-			stage.commands.back().refParams.push_back( findRenderTarget( node1.getAttribute( "sourceRT" ) ) );
-			vector< PCParam * > &valParams = stage.commands.back().valParams;
-			valParams.resize( 2 );
-			valParams[0] = new PCStringParam( node1.getAttribute( "sampler" ) );
-			valParams[1] = new PCIntParam( atoi( node1.getAttribute( "bufIndex" ) ) );
+			
+			PipelineCommand cmd( PipelineCommands::BindBuffer );
+			cmd.params.bindBuffer.target = findRenderTarget( node1.getAttribute( "sourceRT" ) );
+			if( cmd.params.bindBuffer.target == 0x0 ) return "Reference to undefined render target in BindBuffer";
+			cmd.params.bindBuffer.sampler = addString( node1.getAttribute( "sampler" ) );
+			cmd.params.bindBuffer.bufIndex = (uint32)atoi( node1.getAttribute( "bufIndex" ) );
+			if( cmd.params.bindBuffer.bufIndex >= RenderBuffer::MaxColorAttachmentCount &&
+			    cmd.params.bindBuffer.bufIndex != 32 )
+				return "Invalid BindBuffer attribute 'bufIndex'";
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "UnbindBuffers" ) == 0 )
 		{
@@ -146,108 +163,84 @@ const string PipelineResource::parseStage( XMLNode &node, PipelineStage &stage )
 		}
 		else if( strcmp( node1.getName(), "ClearTarget" ) == 0 )
 		{
-			stage.commands.push_back( PipelineCommand( PipelineCommands::ClearTarget ) );
-			
-			vector< PCParam * > &valParams = stage.commands.back().valParams;
-			valParams.resize( 9 );
-			valParams[0] = new PCBoolParam( false );
-			valParams[1] = new PCBoolParam( false );
-			valParams[2] = new PCBoolParam( false );
-			valParams[3] = new PCBoolParam( false );
-			valParams[4] = new PCBoolParam( false );
-			valParams[5] = new PCFloatParam( (float)atof( node1.getAttribute( "col_R", "0" ) ) );
-			valParams[6] = new PCFloatParam( (float)atof( node1.getAttribute( "col_G", "0" ) ) );
-			valParams[7] = new PCFloatParam( (float)atof( node1.getAttribute( "col_B", "0" ) ) );
-			valParams[8] = new PCFloatParam( (float)atof( node1.getAttribute( "col_A", "0" ) ) );
-			
-			if( _stricmp( node1.getAttribute( "depthBuf", "false" ), "true" ) == 0 ||
-				_stricmp( node1.getAttribute( "depthBuf", "0" ), "1" ) == 0 )
-				((PCBoolParam *)valParams[0])->set( true );
-			
-			if( _stricmp( node1.getAttribute( "colBuf0", "false" ), "true" ) == 0 ||
-				_stricmp( node1.getAttribute( "colBuf0", "0" ), "1" ) == 0 )
-				((PCBoolParam *)valParams[1])->set( true );
-
-			if( _stricmp( node1.getAttribute( "colBuf1", "false" ), "true" ) == 0 ||
-				_stricmp( node1.getAttribute( "colBuf1", "0" ), "1" ) == 0 )
-				((PCBoolParam *)valParams[2])->set( true );
-
-			if( _stricmp( node1.getAttribute( "colBuf2", "false" ), "true" ) == 0 ||
-				_stricmp( node1.getAttribute( "colBuf2", "0" ), "1" ) == 0 )
-				((PCBoolParam *)valParams[3])->set( true );
-
-			if( _stricmp( node1.getAttribute( "colBuf3", "false" ), "true" ) == 0 ||
-				_stricmp( node1.getAttribute( "colBuf3", "0" ), "1" ) == 0 )
-				((PCBoolParam *)valParams[4])->set( true );
+			PipelineCommand cmd( PipelineCommands::ClearTarget );
+			cmd.params.clearTarget.depthBuf = parseFlag( node1, "depthBuf" );
+			cmd.params.clearTarget.colBufs[0] = parseFlag( node1, "colBuf0" );
+			cmd.params.clearTarget.colBufs[1] = parseFlag( node1, "colBuf1" );
+			cmd.params.clearTarget.colBufs[2] = parseFlag( node1, "colBuf2" );
+			cmd.params.clearTarget.colBufs[3] = parseFlag( node1, "colBuf3" );
+			cmd.params.clearTarget.col[0] = (float)atof( node1.getAttribute( "col_R", "0" ) );
+			cmd.params.clearTarget.col[1] = (float)atof( node1.getAttribute( "col_G", "0" ) );
+			cmd.params.clearTarget.col[2] = (float)atof( node1.getAttribute( "col_B", "0" ) );
+			cmd.params.clearTarget.col[3] = (float)atof( node1.getAttribute( "col_A", "0" ) );
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "DrawGeometry" ) == 0 )
 		{
 			if( node1.getAttribute( "context" ) == 0x0 ) return "Missing DrawGeometry attribute 'context'";
-			stage.commands.push_back( PipelineCommand( PipelineCommands::DrawGeometry ) );
-			stage.commands.back().valParams.push_back( new PCStringParam( node1.getAttribute( "context" ) ) );
-			stage.commands.back().valParams.push_back( new PCStringParam( node1.getAttribute( "class", "" ) ) );
 			
-			string orderString = node1.getAttribute( "order", "" );
-			int order = RenderingOrder::None;
-			if( orderString == "FRONT_TO_BACK" ) order = RenderingOrder::FrontToBack;
-			else if( orderString == "BACK_TO_FRONT" ) order = RenderingOrder::BackToFront;
-			else if( orderString == "STATECHANGES" ) order = RenderingOrder::StateChanges;
-			stage.commands.back().valParams.push_back( new PCIntParam( order ) );
+			PipelineCommand cmd( PipelineCommands::DrawGeometry );
+			cmd.params.drawGeometry.context = ShaderResource::getContextID( node1.getAttribute( "context" ) );
+			cmd.params.drawGeometry.theClass = MaterialResource::getClassID( node1.getAttribute( "class", "" ) );
+			cmd.params.drawGeometry.order = parseRenderingOrder( node1.getAttribute( "order", "" ) );
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "DrawOverlays" ) == 0 )
 		{
 			if( node1.getAttribute( "context" ) == 0x0 ) return "Missing DrawOverlays attribute 'context'";
-			stage.commands.push_back( PipelineCommand( PipelineCommands::DrawOverlays ) );
-			stage.commands.back().valParams.push_back( new PCStringParam( node1.getAttribute( "context" ) ) );
+			
+			PipelineCommand cmd( PipelineCommands::DrawOverlays );
+			cmd.params.drawOverlays.context = ShaderResource::getContextID( node1.getAttribute( "context" ) );
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "DrawQuad" ) == 0 )
 		{
 			if( node1.getAttribute( "material" ) == 0x0 ) return "Missing DrawQuad attribute 'material'";
 			if( node1.getAttribute( "context" ) == 0x0 ) return "Missing DrawQuad attribute 'context'";
-			stage.commands.push_back( PipelineCommand( PipelineCommands::DrawQuad ) );
+			
+			PipelineCommand cmd( PipelineCommands::DrawQuad );
 			uint32 matRes = Modules::resMan().addResource(
 				ResourceTypes::Material, node1.getAttribute( "material" ), 0, false );
-			stage.commands.back().resParams.push_back( Modules::resMan().resolveResHandle( matRes ) );
-			stage.commands.back().valParams.push_back( new PCStringParam( node1.getAttribute( "context" ) ) );
+			cmd.params.drawQuad.matRes = (MaterialResource *)Modules::resMan().resolveResHandle( matRes );
+			if( cmd.params.drawQuad.matRes == 0x0 ) return "Invalid DrawQuad attribute 'material'";
+			_cmdResources.push_back( cmd.params.drawQuad.matRes );
+			cmd.params.drawQuad.context = ShaderResource::getContextID( node1.getAttribute( "context" ) );
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "DoForwardLightLoop" ) == 0 )
 		{
-		    stage.commands.push_back( PipelineCommand( PipelineCommands::DoForwardLightLoop ) );
-		    stage.commands.back().valParams.push_back( new PCStringParam( node1.getAttribute( "context", "" ) ) );
-			stage.commands.back().valParams.push_back( new PCStringParam( node1.getAttribute( "class", "" ) ) );
-			stage.commands.back().valParams.push_back( new PCBoolParam(
-				_stricmp( node1.getAttribute( "noShadows", "false" ), "true" ) == 0 ) );
-
-			string orderString = node1.getAttribute( "order", "" );
-			int order = RenderingOrder::None;
-			if( orderString == "FRONT_TO_BACK" ) order = RenderingOrder::FrontToBack;
-			else if( orderString == "BACK_TO_FRONT" ) order = RenderingOrder::BackToFront;
-			else if( orderString == "STATECHANGES" ) order = RenderingOrder::StateChanges;
-			stage.commands.back().valParams.push_back( new PCIntParam( order ) );
+			PipelineCommand cmd( PipelineCommands::DoForwardLightLoop );
+			cmd.params.forwardLightLoop.context = ShaderResource::getContextID( node1.getAttribute( "context", "" ) );
+			cmd.params.forwardLightLoop.theClass = MaterialResource::getClassID( node1.getAttribute( "class", "" ) );
+			cmd.params.forwardLightLoop.noShadows = _stricmp( node1.getAttribute( "noShadows", "false" ), "true" ) == 0;
+			cmd.params.forwardLightLoop.order = parseRenderingOrder( node1.getAttribute( "order", "" ) );
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "DoDeferredLightLoop" ) == 0 )
 		{
-			stage.commands.push_back( PipelineCommand( PipelineCommands::DoDeferredLightLoop ) );
-			stage.commands.back().valParams.push_back( new PCStringParam( node1.getAttribute( "context", "" ) ) );
-			stage.commands.back().valParams.push_back( new PCBoolParam(
-				_stricmp( node1.getAttribute( "noShadows", "false" ), "true" ) == 0 ) );
+			PipelineCommand cmd( PipelineCommands::DoDeferredLightLoop );
+			cmd.params.deferredLightLoop.context = ShaderResource::getContextID( node1.getAttribute( "context", "" ) );
+			cmd.params.deferredLightLoop.noShadows =
+				_stricmp( node1.getAttribute( "noShadows", "false" ), "true" ) == 0;
+			stage.commands.push_back( cmd );
 		}
 		else if( strcmp( node1.getName(), "SetUniform" ) == 0 )
 		{
 			if( node1.getAttribute( "material" ) == 0x0 ) return "Missing SetUniform attribute 'material'";
 			if( node1.getAttribute( "uniform" ) == 0x0 ) return "Missing SetUniform attribute 'uniform'";
-			stage.commands.push_back( PipelineCommand( PipelineCommands::SetUniform ) );
+			
+			PipelineCommand cmd( PipelineCommands::SetUniform );
 			uint32 matRes = Modules::resMan().addResource(
 				ResourceTypes::Material, node1.getAttribute( "material" ), 0, false );
-			stage.commands.back().resParams.push_back( Modules::resMan().resolveResHandle( matRes ) );
-
-			vector< PCParam * > &valParams = stage.commands.back().valParams;
-			valParams.resize( 5 );
-			valParams[0] = new PCStringParam( node1.getAttribute( "uniform" ) );
-			valParams[1] = new PCFloatParam( (float)atof( node1.getAttribute( "a", "0" ) ) );
-			valParams[2] = new PCFloatParam( (float)atof( node1.getAttribute( "b", "0" ) ) );
-			valParams[3] = new PCFloatParam( (float)atof( node1.getAttribute( "c", "0" ) ) );
-			valParams[4] = new PCFloatParam( (float)atof( node1.getAttribute( "d", "0" ) ) );
+			cmd.params.setUniform.matRes = (MaterialResource *)Modules::resMan().resolveResHandle( matRes );
+			if( cmd.params.setUniform.matRes == 0x0 ) return "Invalid SetUniform attribute 'material'";
+			_cmdResources.push_back( cmd.params.setUniform.matRes );
+			cmd.params.setUniform.uniform = addString( node1.getAttribute( "uniform" ) );
+			cmd.params.setUniform.values[0] = (float)atof( node1.getAttribute( "a", "0" ) );
+			cmd.params.setUniform.values[1] = (float)atof( node1.getAttribute( "b", "0" ) );
+			cmd.params.setUniform.values[2] = (float)atof( node1.getAttribute( "c", "0" ) );
+			cmd.params.setUniform.values[3] = (float)atof( node1.getAttribute( "d", "0" ) );
+			stage.commands.push_back( cmd );
 		}
 
 		node1 = node.getChildNode( ++nodeItr1 );
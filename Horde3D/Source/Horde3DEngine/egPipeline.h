@@ -68,64 +68,31 @@ struct RenderingOrder
 };
 
 
-class PCParam
-{
-public:
-	virtual ~PCParam() { }
-};
-
-class PCBoolParam : public PCParam
-{
-protected:
-	bool  _value;
-public:
-	PCBoolParam( bool value ) { _value = value; }
-	bool get() { return _value; }
-	void set( bool value ) { _value = value; }
-};
-
-class PCIntParam : public PCParam
-{
-protected:
-	int  _value;
-public:
-	PCIntParam( int value ) { _value = value; }
-	int get() { return _value; }
-	void set( int value ) { _value = value; }
-};
-
-class PCFloatParam : public PCParam
-{
-protected:
-	float  _value;
-public:
-	PCFloatParam( float value ) { _value = value; }
-	float get() { return _value; }
-	void set( float value ) { _value = value; }
-};
-
-class PCStringParam : public PCParam
-{
-protected:
-	std::string  _value;
-public:
-	PCStringParam( const std::string &value ) { _value = value; }
-	const std::string &get() { return _value; }
-	void set( const std::string &value ) { _value = value; }
-};
-
+struct RenderTarget;
 
 struct PipelineCommand
 {
-	PipelineCommands::List    command;
-	std::vector< void * >     refParams;  // Pointer to object
-	std::vector< PCParam * >  valParams;  // Newly created object
-	std::vector< PResource >  resParams;  // Pointers to used resources
+	PipelineCommands::List  command;
 
-
-	PipelineCommand( PipelineCommands::List	command )
+	// Parameters are resolved at load time and stored inline; only the member
+	// matching the command is valid. Names are indices into the pipeline string table.
+	union Params
+	{
+		struct { RenderTarget *target; } switchTarget;
+		struct { RenderTarget *target; uint32 sampler; uint32 bufIndex; } bindBuffer;
+		struct { bool depthBuf, colBufs[4]; float col[4]; } clearTarget;
+		struct { uint32 context, theClass; RenderingOrder::List order; } drawGeometry;
+		struct { uint32 context; } drawOverlays;
+		struct { MaterialResource *matRes; uint32 context; } drawQuad;
+		struct { uint32 context, theClass; bool noShadows; RenderingOrder::List order; } forwardLightLoop;
+		struct { uint32 context; bool noShadows; } deferredLightLoop;
+		struct { MaterialResource *matRes; uint32 uniform; float values[4]; } setUniform;
+	} params;
+
+
+	PipelineCommand( PipelineCommands::List	command ) :
+		command( command ), params()
 	{
-		this->command = command;
 	}
 };
 
@@ -168,8 +135,12 @@ private:
 
 	std::vector< RenderTarget >   _renderTargets;
 	std::vector< PipelineStage >  _stages;
+	std::vector< std::string >    _strings;  // Names referenced by commands
+	std::vector< PResource >      _cmdResources;  // Resources referenced by commands
 	
 	bool raiseError( const std::string &msg, int line = -1 );
+	uint32 addString( const std::string &str );
+	RenderingOrder::List parseRenderingOrder( const char *order );
 	const std::string parseStage( XMLNode &node, PipelineStage &stage );
 
 	void addRenderTarget( const std::string &id, bool depthBuffer, uint32 numBuffers,
@@ -32,6 +32,8 @@
 #include "egTextures.h"
 #include "egShader.h"
 #include "egLight.h"
+#include "utPlatform.h"
+#include "utMathSSE.h"
 
 #include "utDebug.h"
 
@@ -78,6 +80,8 @@ Renderer::Renderer() : RendererBase()
 	_curShader = 0x0;
 	_curRenderTarget = 0x0;
 	_curUpdateStamp = 1;
+	_dynBatchVertBuffer = 0; _dynBatchIndexBuffer = 0;
+	_instanceBuffer = 0;
 }
 
 
@@ -86,6 +90,8 @@ Renderer::~Renderer()
 	destroyShadowBuffer();
 	unloadTexture( _defShadowMap, TextureTypes::Tex2D );
 	if( _particleVBO != 0 ) unloadBuffers( _particleVBO, 0 );
+	unloadBuffers( _dynBatchVertBuffer, _dynBatchIndexBuffer );
+	unloadBuffers( _instanceBuffer, 0 );
 }
 
 
@@ -188,7 +194,8 @@ bool Renderer::init()
 	                      1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
 	                      1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
 	glGenTextures( 1, &_defShadowMap );
-	glBindTexture( GL_TEXTURE_2D, _defShadowMap );
+	setActiveTexUnit( 0 );
+	setTexture( 0, GL_TEXTURE_2D, _defShadowMap );
 	glTexImage2D( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, 8, 8, 0,
 	              GL_DEPTH_COMPONENT, GL_FLOAT, shadowTex );
 
@@ -287,6 +294,9 @@ bool Renderer::uploadShader( const char *vertexShader, const char *fragmentShade
 	glBindAttribLocation( shaderId, 5, "weights" );
 	glBindAttribLocation( shaderId, 6, "texCoords0" );
 	glBindAttribLocation( shaderId, 7, "texCoords1" );
+	// Instancing (matrices occupy one location per column)
+	glBindAttribLocation( shaderId, 8, "instWorldMat" );
+	glBindAttribLocation( shaderId, 12, "instWorldNormalMat" );
 	
 	// Particles
 	glBindAttribLocation( shaderId, 1, "parIdx" );
@@ -294,7 +304,7 @@ bool Renderer::uploadShader( const char *vertexShader, const char *fragmentShade
 
 	// Link shader
 	if( !linkShader( shaderId ) ) return false;
-	glUseProgram( shaderId );
+	setProgram( shaderId );
 	sc.shaderObject = shaderId;
 	
 	// Set standard uniforms
@@ -315,6 +325,8 @@ bool Renderer::uploadShader( const char *vertexShader, const char *fragmentShade
 	sc.uni_shadowMapSize = glGetUniformLocation( shaderId, "shadowMapSize" );
 	sc.uni_shadowBias = glGetUniformLocation( shaderId, "shadowBias" );
 	sc.uni_skinMatRows = glGetUniformLocation( shaderId, "skinMatRows[0]" );
+	sc.uni_skinDualQuats = glGetUniformLocation( shaderId, "skinDualQuats[0]" );
+	sc.uni_skinInfluences = glGetUniformLocation( shaderId, "skinInfluences" );
 	sc.uni_parCorners = glGetUniformLocation( shaderId, "parCorners" );
 	sc.uni_parPosArray = glGetUniformLocation( shaderId, "parPosArray" );
 	sc.uni_parSizeAndRotArray = glGetUniformLocation( shaderId, "parSizeAndRotArray" );
@@ -329,6 +341,8 @@ bool Renderer::uploadShader( const char *vertexShader, const char *fragmentShade
 	sc.attrib_weights = glGetAttribLocation( shaderId, "weights" );
 	sc.attrib_texCoords0 = glGetAttribLocation( shaderId, "texCoords0" );
 	sc.attrib_texCoords1 = glGetAttribLocation( shaderId, "texCoords1" );
+	sc.attrib_instWorldMat = glGetAttribLocation( shaderId, "instWorldMat" );
+	sc.attrib_instWorldNormalMat = glGetAttribLocation( shaderId, "instWorldNormalMat" );
 
 	return true;
 }
@@ -339,17 +353,18 @@ void Renderer::setShader( ShaderCombination *sc )
 	if( sc == 0x0 || sc->shaderObject == 0 )
 	{
 		_curShader = 0x0;
-		glUseProgram( 0 );
+		setProgram( 0 );
 	}
 	else
 	{
 		_curShader = sc;
-		glUseProgram( sc->shaderObject );
+		setProgram( sc->shaderObject );
+		Modules::stats().incStat( EngineStats::ShaderBindCount, 1 );
 	}
 }
 
 
-bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shaderContext,
+bool Renderer::setMaterialRec( MaterialResource *materialRes, uint32 shaderContext,
                                ShaderResource *shaderRes )
 {
 	if( materialRes == 0x0 ) return false;
@@ -373,30 +388,29 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 		if( _curShader == 0x0 ) return false;
 
 		// Configure depth mask
-		if( context->writeDepth ) glDepthMask( GL_TRUE );
-		else glDepthMask( GL_FALSE );
+		setDepthMask( context->writeDepth );
 
 		// Configure blending
 		switch( context->blendMode )
 		{
 		case BlendModes::Replace:
-			glDisable( GL_BLEND );
+			setBlending( false );
 			break;
 		case BlendModes::Blend:
-			glEnable( GL_BLEND );
-			glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+			setBlending( true );
+			setBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 			break;
 		case BlendModes::Add:
-			glEnable( GL_BLEND );
-			glBlendFunc( GL_ONE, GL_ONE );
+			setBlending( true );
+			setBlendFunc( GL_ONE, GL_ONE );
 			break;
 		case BlendModes::AddBlended:
-			glEnable( GL_BLEND );
-			glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+			setBlending( true );
+			setBlendFunc( GL_SRC_ALPHA, GL_ONE );
 			break;
 		case BlendModes::Mult:
-			glEnable( GL_BLEND );
-			glBlendFunc( GL_DST_COLOR, GL_ZERO );
+			setBlending( true );
+			setBlendFunc( GL_DST_COLOR, GL_ZERO );
 			break;
 		}
 
@@ -404,64 +418,64 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 		switch( context->depthTest )
 		{
 		case TestModes::LessEqual:
-			glEnable( GL_DEPTH_TEST );
-			glDepthFunc( GL_LEQUAL );
+			setDepthTest( true );
+			setDepthFunc( GL_LEQUAL );
 			break;
 		case TestModes::Equal:
-			glEnable( GL_DEPTH_TEST );
-			glDepthFunc( GL_EQUAL );
+			setDepthTest( true );
+			setDepthFunc( GL_EQUAL );
 			break;
 		case TestModes::Always:
-			glDisable( GL_DEPTH_TEST );
+			setDepthTest( false );
 			break;
 		case TestModes::Less:
-			glEnable( GL_DEPTH_TEST );
-			glDepthFunc( GL_LESS );
+			setDepthTest( true );
+			setDepthFunc( GL_LESS );
 			break;
 		case TestModes::Greater:
-			glEnable( GL_DEPTH_TEST );
-			glDepthFunc( GL_GREATER );
+			setDepthTest( true );
+			setDepthFunc( GL_GREATER );
 			break;
 		case TestModes::GreaterEqual:
-			glEnable( GL_DEPTH_TEST );
-			glDepthFunc( GL_GEQUAL );
+			setDepthTest( true );
+			setDepthFunc( GL_GEQUAL );
 			break;
 		}
 
 		// Configure alpha test and alpha-to-coverage
 		if( context->alphaToCoverage && Modules::config().sampleCount > 0 )
 		{
-			glDisable( GL_ALPHA_TEST );
-			glEnable( GL_SAMPLE_ALPHA_TO_COVERAGE );
+			setAlphaTest( false );
+			setAlphaToCoverage( true );
 		}
 		else
 		{
-			glDisable( GL_SAMPLE_ALPHA_TO_COVERAGE );
+			setAlphaToCoverage( false );
 			
 			switch( context->alphaTest )
 			{
 			case TestModes::Always:
-				glDisable( GL_ALPHA_TEST );
+				setAlphaTest( false );
 				break;
 			case TestModes::Less:
-				glEnable( GL_ALPHA_TEST );
-				glAlphaFunc( GL_LESS, context->alphaRef );
+				setAlphaTest( true );
+				setAlphaFunc( GL_LESS, context->alphaRef );
 				break;
 			case TestModes::LessEqual:
-				glEnable( GL_ALPHA_TEST );
-				glAlphaFunc( GL_LEQUAL, context->alphaRef );
+				setAlphaTest( true );
+				setAlphaFunc( GL_LEQUAL, context->alphaRef );
 				break;
 			case TestModes::Greater:
-				glEnable( GL_ALPHA_TEST );
-				glAlphaFunc( GL_GREATER, context->alphaRef );
+				setAlphaTest( true );
+				setAlphaFunc( GL_GREATER, context->alphaRef );
 				break;
 			case TestModes::GreaterEqual:
-				glEnable( GL_ALPHA_TEST );
-				glAlphaFunc( GL_GEQUAL, context->alphaRef );
+				setAlphaTest( true );
+				setAlphaFunc( GL_GEQUAL, context->alphaRef );
 				break;
 			case TestModes::Equal:
-				glEnable( GL_ALPHA_TEST );
-				glAlphaFunc( GL_EQUAL, context->alphaRef );
+				setAlphaTest( true );
+				setAlphaFunc( GL_EQUAL, context->alphaRef );
 				break;
 			}
 		}
@@ -511,39 +525,36 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 		_curShader->lastUpdateStamp = _curUpdateStamp;
 	}
 
+	// Samplers and uniforms are matched by name only once per material and shader combination
+	MatBindingTable &bindings = materialRes->getBindingTable( *shaderRes, *_curShader );
+	
 	// Setup texture samplers
-	for( size_t i = 0, s = shaderRes->_samplers.size(); i < s; ++i )
+	for( size_t i = 0, s = bindings.samplers.size(); i < s; ++i )
 	{
-		if( _curShader->customSamplers[i] < 0 ) continue;
-		
-		glActiveTexture( GL_TEXTURE0 + shaderRes->_samplers[i].texUnit );
+		TextureResource *texRes = bindings.samplers[i].texRes;
+		if( texRes == 0x0 && _pipeSamplerBindings.empty() ) continue;
 		
-		ShaderSampler &sampler = shaderRes->_samplers[i];
+		ShaderSampler &sampler = *bindings.samplers[i].sampler;
+		uint32 texUnit = sampler.texUnit;
+		setActiveTexUnit( texUnit );  // Sampler parameters below apply to the active unit
 		int target = 0;
 		bool mips = false;
 
-		// Find sampler in material
-		for( size_t j = 0, s = materialRes->_samplers.size(); j < s; ++j )
+		// Texture from material
+		if( texRes != 0x0 )
 		{
-			MatSampler &matSampler = materialRes->_samplers[j];
-			
-			if( matSampler.name == sampler.id )
+			if( texRes->getTexType() == TextureTypes::Tex2D )
 			{
-				if( matSampler.texRes->getTexType() == TextureTypes::Tex2D )
-				{
-					target = GL_TEXTURE_2D;
-					mips = matSampler.texRes->hasMipMaps();
-					glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
-					glBindTexture( GL_TEXTURE_2D, matSampler.texRes->getTexObject() );
-				}
-				else if( matSampler.texRes->getTexType() == TextureTypes::TexCube )
-				{
-					target = GL_TEXTURE_CUBE_MAP;
-					mips = matSampler.texRes->hasMipMaps();
-					glBindTexture( GL_TEXTURE_CUBE_MAP, matSampler.texRes->getTexObject() );
-				}
-
-				break;
+				target = GL_TEXTURE_2D;
+				mips = texRes->hasMipMaps();
+				setTexture( texUnit, GL_TEXTURE_CUBE_MAP, 0 );
+				setTexture( texUnit, GL_TEXTURE_2D, texRes->getTexObject() );
+			}
+			else if( texRes->getTexType() == TextureTypes::TexCube )
+			{
+				target = GL_TEXTURE_CUBE_MAP;
+				mips = texRes->hasMipMaps();
+				setTexture( texUnit, GL_TEXTURE_CUBE_MAP, texRes->getTexObject() );
 			}
 		}
 
@@ -554,18 +565,18 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 			{
 				target = GL_TEXTURE_2D;
 				mips = false;
-				glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
+				setTexture( texUnit, GL_TEXTURE_CUBE_MAP, 0 );
 
 				uint32 bufIndex = _pipeSamplerBindings[j].bufIndex;
 				RenderBuffer *rb = _pipeSamplerBindings[j].rb;
 				
 				if( bufIndex < 4 && rb->colBufs[bufIndex] != 0 )
 				{
-					glBindTexture( GL_TEXTURE_2D, rb->colBufs[bufIndex] );
+					setTexture( texUnit, GL_TEXTURE_2D, rb->colBufs[bufIndex] );
 				}
 				else if( bufIndex == 32 && rb->depthBuf != 0 )
 				{
-					glBindTexture( GL_TEXTURE_2D, rb->depthBuf );
+					setTexture( texUnit, GL_TEXTURE_2D, rb->depthBuf );
 					glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE );
 					glTexParameteri( GL_TEXTURE_2D, GL_DEPTH_TEXTURE_MODE, GL_LUMINANCE );
 				}
@@ -575,6 +586,7 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 		}
 
 		if( target == 0 ) continue;  // Texture for sampler not found (maybe in linked material)
+		Modules::stats().incStat( EngineStats::TextureBindCount, 1 );
 
 		// Address mode
 		switch( sampler.addressMode )
@@ -631,36 +643,11 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 			glTexParameteri( target, GL_TEXTURE_MAX_ANISOTROPY_EXT, 1 );
 		}
 	}
-	glActiveTexture( GL_TEXTURE0 );
 
 	// Set custom uniforms
-	for( size_t i = 0, s = shaderRes->_uniforms.size(); i < s; ++i )
+	for( size_t i = 0, s = bindings.uniforms.size(); i < s; ++i )
 	{
-		if( _curShader->customUniforms[i] < 0 ) continue;
-		
-		bool found = false;
-
-		// Find uniform in material
-		for( size_t j = 0, s = materialRes->_uniforms.size(); j < s; ++j )
-		{
-			MatUniform &matUniform = materialRes->_uniforms[j];
-			
-			if( matUniform.name == shaderRes->_uniforms[i].id )
-			{
-				glUniform4f( _curShader->customUniforms[i], matUniform.values[0], matUniform.values[1],
-				             matUniform.values[2], matUniform.values[3] );
-				found = true;
-				break;
-			}
-		}
-
-		// Use default values if not found
-		if( !found )
-		{
-			ShaderUniform &uniform = shaderRes->_uniforms[i];
-			glUniform4f( _curShader->customUniforms[i], uniform.defValues[0], uniform.defValues[1],
-				         uniform.defValues[2], uniform.defValues[3] );
-		}
+		glUniform4fv( bindings.uniforms[i].location, 1, bindings.uniforms[i].values );
 	}
 
 	if( firstRec )
@@ -682,22 +669,23 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 }
 
 
-bool Renderer::setMaterial( MaterialResource *materialRes, const string &shaderContext )
+bool Renderer::setMaterial( MaterialResource *materialRes, uint32 shaderContext )
 {
 	if( materialRes == 0x0 )
 	{	
 		_curMatRes = 0x0;
 		_curShader = 0x0;
-		glDisable( GL_BLEND );
-		glDisable( GL_ALPHA_TEST );
-		glEnable( GL_DEPTH_TEST );
-		glDepthFunc( GL_LEQUAL );
-		glDepthMask( 1 );
+		setBlending( false );
+		setAlphaTest( false );
+		setDepthTest( true );
+		setDepthFunc( GL_LEQUAL );
+		setDepthMask( true );
 		return false;
 	}
 	else if( _curShader != 0x0 && materialRes == _curMatRes ) return true;
 		
 	_curMatRes = materialRes;
+	Modules::stats().incStat( EngineStats::MaterialBindCount, 1 );
 	
 	bool result = setMaterialRec( materialRes, shaderContext, 0x0 );
 
@@ -728,7 +716,8 @@ bool Renderer::createShadowBuffer( uint32 width, uint32 height )
 
 	// Attach renderable textures
 	glGenTextures( 1, &_smTex );
-	glBindTexture( GL_TEXTURE_2D, _smTex );
+	setActiveTexUnit( 0 );
+	setTexture( 0, GL_TEXTURE_2D, _smTex );
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
 	glTexImage2D( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0x0 );
 	glFramebufferTexture2DEXT( GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_TEXTURE_2D, _smTex, 0 );
@@ -752,7 +741,11 @@ bool Renderer::createShadowBuffer( uint32 width, uint32 height )
 
 void Renderer::destroyShadowBuffer()
 {
-	if( _smTex != 0 ) glDeleteTextures( 1, &_smTex );
+	if( _smTex != 0 )
+	{
+		glDeleteTextures( 1, &_smTex );
+		releaseCachedTexture( _smTex );
+	}
 	if( _smFBO != 0 ) glDeleteFramebuffersEXT( 1, &_smFBO );
 
 	_smTex = 0; _smFBO = 0;
@@ -762,10 +755,10 @@ void Renderer::destroyShadowBuffer()
 void Renderer::setupShadowMap( bool noShadows )
 {
 	// Bind shadow map
-	glActiveTexture( GL_TEXTURE12 );
+	setActiveTexUnit( 12 );
 
-	if( !noShadows && _curLight->_shadowMapCount > 0 )glBindTexture( GL_TEXTURE_2D, _smTex );
-	else glBindTexture( GL_TEXTURE_2D, _defShadowMap );
+	if( !noShadows && _curLight->_shadowMapCount > 0 ) setTexture( 12, GL_TEXTURE_2D, _smTex );
+	else setTexture( 12, GL_TEXTURE_2D, _defShadowMap );
 
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 1 );
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
@@ -776,8 +769,6 @@ void Renderer::setupShadowMap( bool noShadows )
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE );
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
-	
-	glActiveTexture( GL_TEXTURE0 );
 }
 
 
@@ -881,7 +872,7 @@ void Renderer::updateShadowMap()
 	_fbWidth = Modules::config().shadowMapSize;
 	_fbHeight = Modules::config().shadowMapSize;
 	
-	glDepthMask( GL_TRUE );
+	setDepthMask( true );
 	glClearDepth( 1.0f );
     glClear( GL_DEPTH_BUFFER_BIT );
 
@@ -931,7 +922,7 @@ void Renderer::updateShadowMap()
 	}
 	
 	// Prepare shadow map rendering
-	glEnable( GL_DEPTH_TEST );
+	setDepthTest( true );
 	//glCullFace( GL_FRONT );	// Front face culling reduces artefacts but produces more "peter-panning"
 	glMatrixMode( GL_MODELVIEW );
 	glLoadMatrixf( _curLight->getViewMat().x );
@@ -982,9 +973,9 @@ void Renderer::updateShadowMap()
 			glViewport( 0, 0, sh, sh );
 		}
 	
-		// Render
-		drawRenderables( _curLight->_shadowContext, "", false, &_curLight->getFrustum(), 0x0,
-		                 RenderingOrder::None, -1 );
+		// Render; order does not matter for depth-only passes, so state changes are minimized
+		drawRenderables( _curLight->_shadowContext, 0, false, &_curLight->getFrustum(), 0x0,
+		                 RenderingOrder::StateChanges, -1 );
 	}
 
 	// Setup light matrices for rendering:
@@ -1100,9 +1091,9 @@ void Renderer::drawDebugAABB( const Vec3f &bbMin, const Vec3f &bbMax, bool saveS
 	// Prepare rendering box
 	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
 	glDisable( GL_CULL_FACE );
-	glUseProgram( defColorShader.shaderObject );
-	glBindBuffer( GL_ARRAY_BUFFER, 0 );
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	setProgram( defColorShader.shaderObject );
+	setVertexBuffer( 0 );
+	setIndexBuffer( 0 );
 	glColor4f( 1, 1, 1, 1 );
 	glVertexPointer( 3, GL_FLOAT, 0, corners );
 	glEnableClientState( GL_VERTEX_ARRAY );
@@ -1114,9 +1105,9 @@ void Renderer::drawDebugAABB( const Vec3f &bbMin, const Vec3f &bbMax, bool saveS
 	
 	if( saveStates )
 	{
-		glUseProgram( shader );
-		glBindBuffer( GL_ARRAY_BUFFER, array_buffer );
-		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, element_buffer );
+		setProgram( shader );
+		setVertexBuffer( array_buffer );
+		setIndexBuffer( element_buffer );
 		if( vertexArray ) glVertexPointer( vSize, vType, vStride, vArray );
 		glPopClientAttrib();
 	}
@@ -1139,9 +1130,9 @@ void Renderer::clearOverlays()
 }
 
 
-void Renderer::drawOverlays( const string &shaderContext )
+void Renderer::drawOverlays( uint32 shaderContext )
 {
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, 0 );
 	++_curUpdateStamp;
 	
 	glMatrixMode( GL_PROJECTION );
@@ -1187,10 +1178,8 @@ void Renderer::bindBuffer( RenderBuffer *rb, const string &sampler, uint32 bufIn
 		// Make sure all render buffers are unbound
 		for( uint32 i = 0; i < 12; ++i )
 		{
-			glActiveTexture( GL_TEXTURE0 + i );
-			glBindTexture( GL_TEXTURE_2D, 0 );
+			setTexture( i, GL_TEXTURE_2D, 0 );
 		}
-		glActiveTexture( GL_TEXTURE0 );
 	}
 	else
 	{
@@ -1224,7 +1213,7 @@ void Renderer::clear( bool depth, bool buf0, bool buf1, bool buf2, bool buf3,
 	glPushAttrib( GL_COLOR_BUFFER_BIT );	// Store state of glDrawBuffers
 	
 	glDisable( GL_BLEND );	// Clearing floating point buffers causes problems when blending is enabled on Radeon 9600
-	glDepthMask( GL_TRUE );
+	setDepthMask( true );
 	glClearColor( r, g, b, a );
 
 	if( _curRendBuf != 0x0 )
@@ -1258,15 +1247,15 @@ void Renderer::clear( bool depth, bool buf0, bool buf1, bool buf2, bool buf3,
 }
 
 
-void Renderer::drawFSQuad( Resource *matRes, const string &shaderContext )
+void Renderer::drawFSQuad( MaterialResource *matRes, uint32 shaderContext )
 {
-	if( matRes == 0x0 || matRes->getType() != ResourceTypes::Material ) return;
+	if( matRes == 0x0 ) return;
 	
 	// Reset current material
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, 0 );
 	++_curUpdateStamp;
 
-	if( !setMaterial( (MaterialResource *)matRes, shaderContext ) ) return;
+	if( !setMaterial( matRes, shaderContext ) ) return;
 	
 	glMatrixMode( GL_PROJECTION );
 	glLoadIdentity();
@@ -1286,7 +1275,7 @@ void Renderer::drawFSQuad( Resource *matRes, const string &shaderContext )
 }
 
 
-void Renderer::drawGeometry( const string &shaderContext, const string &theClass,
+void Renderer::drawGeometry( uint32 shaderContext, uint32 theClass,
                              RenderingOrder::List order, int occSet )
 {
 	if( _curCamera == 0x0 ) return;
@@ -1301,12 +1290,12 @@ void Renderer::drawGeometry( const string &shaderContext, const string &theClass
 }
 
 
-void Renderer::drawLightGeometry( const string shaderContext, const string &theClass,
+void Renderer::drawLightGeometry( uint32 shaderContext, uint32 theClass,
                                   bool noShadows, RenderingOrder::List order, int occSet )
 {
 	if( _curCamera == 0x0 ) return;
 	
-	string context = shaderContext;
+	uint32 context = shaderContext;
 	
 	Modules::sceneMan().updateQueues( _curCamera->getFrustum(), 0x0, RenderingOrder::None, true, false );
 	
@@ -1346,16 +1335,16 @@ void Renderer::drawLightGeometry( const string shaderContext, const string &theC
 					if( nearestDistToAABB( _curCamera->getFrustum().getOrigin(), mins, maxs ) )
 					{
 						// Draw occlusion box
-						Modules::renderer().setMaterial( 0x0, "" );
-						glColorMask( 0, 0, 0, 0 );
-						glDepthMask( 0 );
+						Modules::renderer().setMaterial( 0x0, 0 );
+						Modules::renderer().setColorMask( false );
+						Modules::renderer().setDepthMask( false );
 						Modules::renderer().beginOccQuery( _curLight->_occQueries[occSet] );
 						Modules::renderer().setShader( &Modules::renderer().occShader );
 						Modules::renderer().drawAABB( mins, maxs );
 						Modules::renderer().endOccQuery( _curLight->_occQueries[occSet] );
-						glDepthMask( 1 );
-						glColorMask( 1, 1, 1, 1 );
-						Modules::renderer().setMaterial( 0x0, "" );
+						Modules::renderer().setDepthMask( true );
+						Modules::renderer().setColorMask( true );
+						Modules::renderer().setMaterial( 0x0, 0 );
 
 						// Check query result from previous frame
 						if( Modules::renderer().getOccQueryResult( _curLight->_occQueries[occSet] ) < 1 )
@@ -1385,7 +1374,7 @@ void Renderer::drawLightGeometry( const string shaderContext, const string &theC
 		
 		setupShadowMap( noShadows );
 
-		if( shaderContext == "" ) context = _curLight->_lightingContext;
+		if( shaderContext == 0 ) context = _curLight->_lightingContext;
 		
 		// Render
 		Modules::sceneMan().updateQueues( _curCamera->getFrustum(), &_curLight->getFrustum(),
@@ -1397,20 +1386,18 @@ void Renderer::drawLightGeometry( const string shaderContext, const string &theC
 
 		// Reset
 		glDisable( GL_SCISSOR_TEST );
-		glActiveTexture( GL_TEXTURE12 );
-		glBindTexture( GL_TEXTURE_2D, 0 );
-		glActiveTexture( GL_TEXTURE0 );
+		setTexture( 12, GL_TEXTURE_2D, 0 );
 	}
 
 	_curLight = 0x0;
 }
 
 
-void Renderer::drawLightShapes( const string shaderContext, bool noShadows, int occSet )
+void Renderer::drawLightShapes( uint32 shaderContext, bool noShadows, int occSet )
 {
 	if( _curCamera == 0x0 ) return;
 	
-	string context = shaderContext;
+	uint32 context = shaderContext;
 	
 	Modules::sceneMan().updateQueues( _curCamera->getFrustum(), 0x0, RenderingOrder::None, true, false );
 	
@@ -1450,16 +1437,16 @@ void Renderer::drawLightShapes( const string shaderContext, bool noShadows, int
 					if( nearestDistToAABB( _curCamera->getFrustum().getOrigin(), mins, maxs ) )
 					{
 						// Draw occlusion box
-						Modules::renderer().setMaterial( 0x0, "" );
-						glColorMask( 0, 0, 0, 0 );
-						glDepthMask( 0 );
+						Modules::renderer().setMaterial( 0x0, 0 );
+						Modules::renderer().setColorMask( false );
+						Modules::renderer().setDepthMask( false );
 						Modules::renderer().beginOccQuery( _curLight->_occQueries[occSet] );
 						Modules::renderer().setShader( &Modules::renderer().occShader );
 						Modules::renderer().drawAABB( mins, maxs );
 						Modules::renderer().endOccQuery( _curLight->_occQueries[occSet] );
-						glDepthMask( 1 );
-						glColorMask( 1, 1, 1, 1 );
-						Modules::renderer().setMaterial( 0x0, "" );
+						Modules::renderer().setDepthMask( true );
+						Modules::renderer().setColorMask( true );
+						Modules::renderer().setMaterial( 0x0, 0 );
 
 						// Check query result from previous frame
 						if( Modules::renderer().getOccQueryResult( _curLight->_occQueries[occSet] ) < 1 )
@@ -1488,9 +1475,9 @@ void Renderer::drawLightShapes( const string shaderContext, bool noShadows, int
 		
 		setupShadowMap( noShadows );
 
-		if( shaderContext == "" ) context = _curLight->_lightingContext;
+		if( shaderContext == 0 ) context = _curLight->_lightingContext;
 
-		setMaterial( 0x0, "" );		// Reset material
+		setMaterial( 0x0, 0 );		// Reset material
 		if( !setMaterial( _curLight->_materialRes, context ) ) continue;
 		
 		// Draw quad
@@ -1503,26 +1490,259 @@ void Renderer::drawLightShapes( const string shaderContext, bool noShadows, int
 		Modules().stats().incStat( EngineStats::LightPassCount, 1 );
 
 		// Reset
-		glActiveTexture( GL_TEXTURE12 );
-		glBindTexture( GL_TEXTURE_2D, 0 );
-		glActiveTexture( GL_TEXTURE0 );
+		setTexture( 12, GL_TEXTURE_2D, 0 );
 	}
 
 	_curLight = 0x0;
 }
 
 
+// =================================================================================================
+// Static Batching
+// =================================================================================================
+
+struct StaticBatchMesh
+{
+	MeshNode  *node;
+	Vec3f     center;
+	uint32    vertCount;
+};
+
+
+struct StaticBatchMeshOrder
+{
+	uint32  axis;
+
+	StaticBatchMeshOrder( uint32 axis ) : axis( axis ) {}
+	bool operator()( const StaticBatchMesh &m1, const StaticBatchMesh &m2 ) const
+		{ return (&m1.center.x)[axis] < (&m2.center.x)[axis]; }
+};
+
+
+static void collectStaticBatchMeshes( SceneNode *node, map< MaterialResource *, vector< StaticBatchMesh > > &groups,
+                                      vector< GeometryResource * > &restoredGeos )
+{
+	if( node->getType() == SceneNodeTypes::Mesh )
+	{
+		MeshNode *meshNode = (MeshNode *)node;
+		
+		// Geometry without CPU copy is read back temporarily since the meshes are merged on the CPU
+		GeometryResource *geoRes = meshNode->getParentModel() != 0x0 ?
+			meshNode->getParentModel()->getGeometryResource() : 0x0;
+		if( geoRes != 0x0 && !geoRes->hasCPUData() )
+		{
+			geoRes->getVertData();
+			restoredGeos.push_back( geoRes );
+		}
+		
+		if( meshNode->isStaticBatchable() )
+		{
+			StaticBatchMesh mesh;
+			mesh.node = meshNode;
+			mesh.center = (meshNode->getBBox().getMinCoords() + meshNode->getBBox().getMaxCoords()) * 0.5f;
+			mesh.vertCount = meshNode->getVertREnd() - meshNode->getVertRStart() + 1;
+			groups[meshNode->getMaterialRes()].push_back( mesh );
+		}
+	}
+
+	for( uint32 i = 0; i < node->getChildren().size(); ++i )
+	{
+		collectStaticBatchMeshes( node->getChildren()[i], groups, restoredGeos );
+	}
+}
+
+
+static void splitStaticBatchCells( vector< StaticBatchMesh > &meshes, uint32 first, uint32 count,
+                                   float maxCellSize, vector< uint32 > &cellEnds )
+{
+	// Cells are split at the median mesh along the longest axis until they are small enough
+	BoundingBox bBox = meshes[first].node->getBBox();
+	Vec3f cMin = meshes[first].center, cMax = meshes[first].center;
+	uint32 vertCount = 0;
+	for( uint32 i = first; i < first + count; ++i )
+	{
+		bBox.makeUnion( meshes[i].node->getBBox() );
+		const Vec3f &c = meshes[i].center;
+		cMin.x = minf( cMin.x, c.x ); cMin.y = minf( cMin.y, c.y ); cMin.z = minf( cMin.z, c.z );
+		cMax.x = maxf( cMax.x, c.x ); cMax.y = maxf( cMax.y, c.y ); cMax.z = maxf( cMax.z, c.z );
+		vertCount += meshes[i].vertCount;
+	}
+
+	Vec3f extent = bBox.getMaxCoords() - bBox.getMinCoords();
+	float cellSize = maxf( extent.x, maxf( extent.y, extent.z ) );
+	if( count < 2 || (vertCount <= MaxStaticBatchVerts && (maxCellSize <= 0 || cellSize <= maxCellSize)) )
+	{
+		cellEnds.push_back( first + count );
+		return;
+	}
+
+	Vec3f centerExtent = cMax - cMin;
+	uint32 axis = 0;
+	if( centerExtent.y > centerExtent.x ) axis = 1;
+	if( centerExtent.z > (&centerExtent.x)[axis] ) axis = 2;
+	
+	uint32 half = count / 2;
+	std::nth_element( meshes.begin() + first, meshes.begin() + first + half, meshes.begin() + first + count,
+	                  StaticBatchMeshOrder( axis ) );
+	
+	splitStaticBatchCells( meshes, first, half, maxCellSize, cellEnds );
+	splitStaticBatchCells( meshes, first + half, count - half, maxCellSize, cellEnds );
+}
+
+
+static Vec3f transformDirection( const Matrix4f &m, const Vec3f &v )
+{
+	Vec3f dir = m.mult33Vec( v );
+	float len = dir.length();
+	return len > 0 ? dir * (1.0f / len) : dir;
+}
+
+
+int Renderer::buildStaticBatches( SceneNode *startNode, float maxCellSize )
+{
+	clearStaticBatches();
+	Modules::sceneMan().updateNodes();
+	
+	map< MaterialResource *, vector< StaticBatchMesh > > groups;
+	vector< GeometryResource * > restoredGeos;
+	collectStaticBatchMeshes( startNode, groups, restoredGeos );
+
+	vector< unsigned short > indices16;
+	vector< uint32 > cellEnds;
+	uint32 numMeshes = 0;
+	
+	for( map< MaterialResource *, vector< StaticBatchMesh > >::iterator itr = groups.begin();
+	     itr != groups.end(); ++itr )
+	{
+		vector< StaticBatchMesh > &meshes = itr->second;
+		if( meshes.size() < 2 ) continue;  // Nothing to merge
+
+		cellEnds.resize( 0 );
+		splitStaticBatchCells( meshes, 0, (uint32)meshes.size(), maxCellSize, cellEnds );
+
+		uint32 vertCount = 0, indexCount = 0;
+		for( uint32 i = 0; i < meshes.size(); ++i )
+		{
+			vertCount += meshes[i].vertCount;
+			indexCount += meshes[i].node->getBatchCount();
+		}
+		
+		// All cells of a material share one geometry; each cell is a range of 16 bit indices
+		// relative to its first vertex
+		GeometryResource *batchGeo = new GeometryResource( "", 0 );
+		batchGeo->_vertCount = vertCount;
+		batchGeo->_vertData = new VertexData( vertCount, false );
+		batchGeo->_jointIndices.resize( vertCount * 4, 0 );
+		batchGeo->_indices.reserve( indexCount );
+		batchGeo->_16BitIndices = true;
+		indices16.resize( 0 );
+		indices16.reserve( indexCount );
+		VertexData &vd = *batchGeo->_vertData;
+
+		uint32 vertOffset = 0, first = 0;
+		for( uint32 i = 0; i < cellEnds.size(); ++i )
+		{
+			StaticBatch batch;
+			batch.geoRes = batchGeo;
+			batch.matRes = itr->first;
+			batch.bBox = meshes[first].node->getBBox();
+			batch.batchStart = (uint32)batchGeo->_indices.size();
+			batch.baseVertex = vertOffset;
+			
+			for( uint32 j = first; j < cellEnds[i]; ++j )
+			{
+				MeshNode *meshNode = meshes[j].node;
+				GeometryResource *geoRes = meshNode->getParentModel()->getGeometryResource();
+				VertexData &srcVD = *geoRes->getVertData();
+				
+				const Matrix4f &absTrans = meshNode->getAbsTrans();
+				Matrix4f normalMat = absTrans.inverted().transposed();
+				for( uint32 k = meshNode->getVertRStart(); k <= meshNode->getVertREnd(); ++k )
+				{
+					uint32 v = vertOffset + k - meshNode->getVertRStart();
+					vd.positions[v] = absTrans * srcVD.positions[k];
+					vd.normals[v] = transformDirection( normalMat, srcVD.normals[k] );
+					vd.tangents[v] = transformDirection( absTrans, srcVD.tangents[k] );
+					vd.bitangents[v] = transformDirection( absTrans, srcVD.bitangents[k] );
+					
+					vd.staticData[v] = srcVD.staticData[k];
+					for( uint32 l = 0; l < 4; ++l )
+					{
+						vd.staticData[v].jointVec[l] = 0;
+						vd.staticData[v].weightVec[l] = l == 0 ? 1.0f : 0.0f;
+					}
+				}
+
+				// Mirroring transformations flip the winding order
+				bool flip = absTrans.determinant() < 0;
+				for( uint32 k = 0; k < meshNode->getBatchCount(); ++k )
+				{
+					uint32 src = k;
+					if( flip && k % 3 != 0 ) src = k % 3 == 1 ? k + 1 : k - 1;
+					uint32 index = geoRes->_indices[meshNode->getBatchStart() + src];
+					index = index - meshNode->getVertRStart() + vertOffset;
+					batchGeo->_indices.push_back( index );
+					indices16.push_back( (unsigned short)(index - batch.baseVertex) );
+				}
+
+				batch.bBox.makeUnion( meshNode->getBBox() );
+				vertOffset += meshes[j].vertCount;
+				meshNode->_staticBatched = true;
+				_staticBatchedMeshes.push_back( meshNode );
+			}
+			
+			batch.batchCount = (uint32)batchGeo->_indices.size() - batch.batchStart;
+			batch.vertCount = vertOffset - batch.baseVertex;
+			_staticBatches.push_back( batch );
+
+			IndexBase ib = { batch.batchStart, batch.batchCount, batch.baseVertex };
+			batchGeo->_indexBases.push_back( ib );
+			first = cellEnds[i];
+		}
+
+		batchGeo->finishLoading( &indices16[0], false );  // World space positions need float precision
+		_staticBatchGeos.push_back( batchGeo );
+		numMeshes += (uint32)meshes.size();
+	}
+
+	for( uint32 i = 0; i < restoredGeos.size(); ++i ) restoredGeos[i]->releaseCPUData();
+
+	Modules::log().writeInfo( "Static batching: %i meshes merged into %i batches",
+	                          numMeshes, (int)_staticBatches.size() );
+	
+	return (int)_staticBatches.size();
+}
+
+
+void Renderer::clearStaticBatches()
+{
+	for( uint32 i = 0; i < _staticBatchedMeshes.size(); ++i )
+	{
+		_staticBatchedMeshes[i]->_staticBatched = false;
+	}
+	
+	for( uint32 i = 0; i < _staticBatchGeos.size(); ++i )
+	{
+		delete _staticBatchGeos[i];
+	}
+
+	_staticBatchedMeshes.clear();
+	_staticBatches.clear();
+	_staticBatchGeos.clear();
+}
+
+
 // =================================================================================================
 // Scene Node Rendering Functions
 // =================================================================================================
 
-void Renderer::drawRenderables( const string &shaderContext, const string &theClass, bool debugView,
+void Renderer::drawRenderables( uint32 shaderContext, uint32 theClass, bool debugView,
                                 const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
                                 int occSet )
 {
 	if( Modules::config().wireframeMode && !Modules::config().debugViewMode )
 	{
-		glDisable( GL_CULL_FACE );
+		setCulling( false );
 		glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
 	}
 	
@@ -1537,13 +1757,751 @@ void Renderer::drawRenderables( const string &shaderContext, const string &theCl
 
 	if( Modules::config().wireframeMode && !Modules::config().debugViewMode )
 	{
-		glEnable( GL_CULL_FACE );
+		setCulling( true );
 		glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
 	}
 }
 
 
-void Renderer::drawModels( const string &shaderContext, const string &theClass, bool debugView,
+void Renderer::bindModelVertices( GeometryResource *geoRes, uint32 dynVertBuffer, uint32 baseVertex )
+{
+	// Dynamic streams are taken from the private copy of the model if it has one
+	// (private copies always use the float layout)
+	uint32 vertCount = geoRes->_vertCount;
+	Modules::renderer().setVertexBuffer( dynVertBuffer != 0 ? dynVertBuffer : geoRes->getDynVertBuffer() );
+	if( dynVertBuffer == 0 && geoRes->_compactVertData )
+	{
+		// Quantized positions are mapped to geometry space by the world transformation
+		uint32 posSize = geoRes->getCompactPosSize(), basisSize = geoRes->getCompactBasisSize();
+		if( geoRes->_quantizedPositions )
+			glVertexPointer( 3, GL_SHORT, posSize, (char *)0 + baseVertex * posSize );
+		else
+			glVertexPointer( 3, GL_FLOAT, 0, (char *)0 + baseVertex * posSize );
+		
+		uint32 basisType = geoRes->_packedBasis ? GL_INT_2_10_10_10_REV : GL_SHORT;
+		int basisComps = geoRes->_packedBasis ? 4 : 3;
+		const char *basis = (char *)0 + vertCount * posSize + baseVertex * basisSize;
+		glVertexAttribPointer( 1, basisComps, basisType, GL_TRUE, basisSize, basis );
+		glVertexAttribPointer( 2, basisComps, basisType, GL_TRUE, basisSize, basis + vertCount * basisSize );
+		glVertexAttribPointer( 3, basisComps, basisType, GL_TRUE, basisSize, basis + vertCount * basisSize * 2 );
+	}
+	else
+	{
+		glVertexPointer( 3, GL_FLOAT, 0, (char *)0 + baseVertex * 12 );
+		glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + (vertCount + baseVertex) * 12 );
+		glVertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + (vertCount * 2 + baseVertex) * 12 );
+		glVertexAttribPointer( 3, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + (vertCount * 3 + baseVertex) * 12 );
+	}
+	
+	Modules::renderer().setVertexBuffer( geoRes->getStaticVertBuffer() );
+	Modules::stats().incStat( EngineStats::BufferBindCount, 2 );
+	if( geoRes->_compactVertData )
+	{
+		const char *base = (char *)0 + baseVertex * sizeof( VertexDataStaticCompact );
+		glVertexAttribPointer( 4, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof( VertexDataStaticCompact ), base + 8 );
+		glVertexAttribPointer( 5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( VertexDataStaticCompact ), base + 12 );
+		glVertexAttribPointer( 6, 2, GL_FLOAT, GL_FALSE, sizeof( VertexDataStaticCompact ), base );
+		glVertexAttribPointer( 7, 2, GL_FLOAT, GL_FALSE, sizeof( VertexDataStaticCompact ), base + 16 );
+	}
+	else
+	{
+		const char *base = (char *)0 + baseVertex * sizeof( VertexDataStatic );
+		glVertexAttribPointer( 4, 4, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base + 8 );
+		glVertexAttribPointer( 5, 4, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base + 24 );
+		glVertexAttribPointer( 6, 2, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base );
+		glVertexAttribPointer( 7, 2, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base + 40 );
+	}
+}
+
+
+void Renderer::setupVertexStreams( ShaderCombination *sc )
+{
+	// Enable required vertex streams and disable others to save bandwidth
+	if( sc->attrib_normal >= 0 ) glEnableVertexAttribArray( 1 );
+	else glDisableVertexAttribArray( 1 );
+	if( sc->attrib_tangent >= 0 ) glEnableVertexAttribArray( 2 );
+	else glDisableVertexAttribArray( 2 );
+	if( sc->attrib_bitangent >= 0 ) glEnableVertexAttribArray( 3 );
+	else glDisableVertexAttribArray( 3 );
+	if( sc->attrib_joints >= 0 ) glEnableVertexAttribArray( 4 );
+	else glDisableVertexAttribArray( 4 );
+	if( sc->attrib_weights >= 0 ) glEnableVertexAttribArray( 5 );
+	else glDisableVertexAttribArray( 5 );
+	if( sc->attrib_texCoords0 >= 0 ) glEnableVertexAttribArray( 6 );
+	else glDisableVertexAttribArray( 6 );
+	if( sc->attrib_texCoords1 >= 0 ) glEnableVertexAttribArray( 7 );
+	else glDisableVertexAttribArray( 7 );
+}
+
+
+void Renderer::setBatchUniforms( ShaderCombination *sc )
+{
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	static const float identity33[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+	static const Vec4f identityJoint[3] = { Vec4f( 1, 0, 0, 0 ), Vec4f( 0, 1, 0, 0 ), Vec4f( 0, 0, 1, 0 ) };
+	static const Vec4f identityDualQuat[2] = { Vec4f( 0, 0, 0, 1 ), Vec4f( 0, 0, 0, 0 ) };
+	
+	// Batched vertices are already in world space and bound to the default joint
+	if( sc->uni_worldMat >= 0 )
+		glUniformMatrix4fv( sc->uni_worldMat, 1, false, identity );
+	if( sc->uni_worldNormalMat >= 0 )
+		glUniformMatrix3fv( sc->uni_worldNormalMat, 1, false, identity33 );
+	if( sc->uni_skinDualQuats >= 0 )
+		glUniform4fv( sc->uni_skinDualQuats, 2, (float *)identityDualQuat );
+	else if( sc->uni_skinMatRows >= 0 )
+		glUniform4fv( sc->uni_skinMatRows, 3, (float *)identityJoint );
+	if( sc->uni_skinInfluences >= 0 )
+		glUniform1f( sc->uni_skinInfluences, 1 );
+	setInstanceAttribs( sc, identity, identity33 );
+}
+
+
+void Renderer::setInstanceAttribs( ShaderCombination *sc, const float *worldMat, const float *worldNormalMat )
+{
+	// Instance transformations are passed as constant attributes when no instance stream is bound;
+	// matrix attributes occupy one location per column
+	if( sc->attrib_instWorldMat >= 0 )
+	{
+		for( uint32 i = 0; i < 4; ++i ) glVertexAttrib4fv( 8 + i, worldMat + i * 4 );
+	}
+	if( sc->attrib_instWorldNormalMat >= 0 )
+	{
+		for( uint32 i = 0; i < 3; ++i ) glVertexAttrib3fv( 12 + i, worldNormalMat + i * 3 );
+	}
+}
+
+
+static void calcWorldNormalMat( const Matrix4f &absTrans, float *normalMat )
+{
+	Matrix4f normalMat4 = absTrans.inverted().transposed();
+	normalMat[0] = normalMat4.x[0]; normalMat[1] = normalMat4.x[1]; normalMat[2] = normalMat4.x[2];
+	normalMat[3] = normalMat4.x[4]; normalMat[4] = normalMat4.x[5]; normalMat[5] = normalMat4.x[6];
+	normalMat[6] = normalMat4.x[8]; normalMat[7] = normalMat4.x[9]; normalMat[8] = normalMat4.x[10];
+}
+
+
+#ifdef PLATFORM_SSE
+
+static inline void transformVec3x4( const __m128 *m, __m128 &x, __m128 &y, __m128 &z, bool normalize )
+{
+	__m128 tx = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0], x ), _mm_mul_ps( m[4], y ) ), _mm_mul_ps( m[8], z ) );
+	__m128 ty = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[1], x ), _mm_mul_ps( m[5], y ) ), _mm_mul_ps( m[9], z ) );
+	__m128 tz = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[2], x ), _mm_mul_ps( m[6], y ) ), _mm_mul_ps( m[10], z ) );
+
+	if( normalize )
+	{
+		// Zero vectors stay zero
+		__m128 len2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, tx ), _mm_mul_ps( ty, ty ) ), _mm_mul_ps( tz, tz ) );
+		__m128 invLen = _mm_and_ps( _mm_cmpgt_ps( len2, _mm_setzero_ps() ),
+		                            _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_sqrt_ps( len2 ) ) );
+		tx = _mm_mul_ps( tx, invLen ); ty = _mm_mul_ps( ty, invLen ); tz = _mm_mul_ps( tz, invLen );
+	}
+	else
+	{
+		tx = _mm_add_ps( tx, m[12] ); ty = _mm_add_ps( ty, m[13] ); tz = _mm_add_ps( tz, m[14] );
+	}
+
+	x = tx; y = ty; z = tz;
+}
+
+#endif
+
+
+static void transformBatchVertices( const Matrix4f &m, const Matrix4f &normalMat, const VertexData &src,
+                                    uint32 first, uint32 count, Vec3f *positions, Vec3f *normals,
+                                    Vec3f *tangents, Vec3f *bitangents )
+{
+	uint32 i = 0;
+	
+#ifdef PLATFORM_SSE
+	// Process four vertices at once with the matrix elements broadcast to all lanes
+	__m128 mv[16], nv[16];
+	for( uint32 j = 0; j < 16; ++j )
+	{
+		mv[j] = _mm_set1_ps( m.x[j] );
+		nv[j] = _mm_set1_ps( normalMat.x[j] );
+	}
+
+	__m128 x, y, z;
+	for( ; i + 4 <= count; i += 4 )
+	{
+		loadVec3x4( &src.positions[first + i], x, y, z );
+		transformVec3x4( mv, x, y, z, false );
+		storeVec3x4( &positions[i], x, y, z );
+
+		loadVec3x4( &src.normals[first + i], x, y, z );
+		transformVec3x4( nv, x, y, z, true );
+		storeVec3x4( &normals[i], x, y, z );
+
+		loadVec3x4( &src.tangents[first + i], x, y, z );
+		transformVec3x4( mv, x, y, z, true );
+		storeVec3x4( &tangents[i], x, y, z );
+
+		loadVec3x4( &src.bitangents[first + i], x, y, z );
+		transformVec3x4( mv, x, y, z, true );
+		storeVec3x4( &bitangents[i], x, y, z );
+	}
+#endif
+	
+	for( ; i < count; ++i )
+	{
+		positions[i] = m * src.positions[first + i];
+		normals[i] = transformDirection( normalMat, src.normals[first + i] );
+		tangents[i] = transformDirection( m, src.tangents[first + i] );
+		bitangents[i] = transformDirection( m, src.bitangents[first + i] );
+	}
+}
+
+
+void Renderer::drawDynamicBatches( uint32 shaderContext )
+{
+	Renderer &renderer = Modules::renderer();
+	vector< DynBatchEntry > &queue = renderer._dynBatchQueue;
+	
+	// Meshes keep their relative order within a material
+	std::stable_sort( queue.begin(), queue.end(), dynBatchMaterialOrder );
+
+	size_t first = 0;
+	while( first < queue.size() )
+	{
+		// Merge meshes of the same material as long as they are addressable with 16 bit indices
+		MaterialResource *matRes = queue[first].node->getMaterialRes();
+		uint32 vertCount = 0, indexCount = 0;
+		size_t last = first;
+		while( last < queue.size() && queue[last].node->getMaterialRes() == matRes )
+		{
+			MeshNode *meshNode = queue[last].node;
+			uint32 meshVerts = meshNode->getVertREnd() - meshNode->getVertRStart() + 1;
+			if( vertCount + meshVerts > 65536 ) break;
+			
+			vertCount += meshVerts;
+			indexCount += meshNode->getBatchCount();
+			++last;
+		}
+
+		ShaderCombination *prevShader = renderer.getCurShader();
+		if( !renderer.setMaterial( matRes, shaderContext ) )
+		{
+			first = last;
+			continue;
+		}
+		
+		Modules::stats().getTimer( EngineStats::DynBatchTime )->setEnabled( true );
+
+		// Pre-transform vertices into the layout of a float geometry
+		uint32 staticOffset = vertCount * sizeof( Vec3f ) * 4;
+		renderer._dynBatchData.resize( staticOffset + vertCount * sizeof( VertexDataStatic ) );
+		renderer._dynBatchIndices.resize( 0 );
+		Vec3f *streams = (Vec3f *)&renderer._dynBatchData[0];
+		VertexDataStatic *staticData = (VertexDataStatic *)&renderer._dynBatchData[staticOffset];
+		
+		uint32 vertOffset = 0;
+		for( size_t i = first; i < last; ++i )
+		{
+			MeshNode *meshNode = queue[i].node;
+			const VertexData &vd = *queue[i].geoRes->getVertData();
+			const vector< uint32 > &indices = queue[i].geoRes->_indices;
+			uint32 vertRStart = meshNode->getVertRStart(), meshVerts = meshNode->getVertREnd() - vertRStart + 1;
+			
+			const Matrix4f &absTrans = meshNode->getAbsTrans();
+			transformBatchVertices( absTrans, absTrans.inverted().transposed(), vd, vertRStart, meshVerts,
+			                        streams + vertOffset, streams + vertCount + vertOffset,
+			                        streams + vertCount * 2 + vertOffset, streams + vertCount * 3 + vertOffset );
+			
+			for( uint32 j = 0; j < meshVerts; ++j )
+			{
+				VertexDataStatic &sd = staticData[vertOffset + j];
+				sd = vd.staticData[vertRStart + j];
+				sd.jointVec[0] = 0; sd.jointVec[1] = 0; sd.jointVec[2] = 0; sd.jointVec[3] = 0;
+				sd.weightVec[0] = 1; sd.weightVec[1] = 0; sd.weightVec[2] = 0; sd.weightVec[3] = 0;
+			}
+
+			// Mirroring transformations flip the winding order; meshes with indices outside of their
+			// vertex range are dropped
+			bool flip = absTrans.determinant() < 0;
+			size_t meshIndexStart = renderer._dynBatchIndices.size();
+			for( uint32 j = 0; j < meshNode->getBatchCount(); ++j )
+			{
+				uint32 src = j;
+				if( flip && j % 3 != 0 ) src = j % 3 == 1 ? j + 1 : j - 1;
+				uint32 index = indices[meshNode->getBatchStart() + src] - vertRStart;
+				if( index >= meshVerts )
+				{
+					renderer._dynBatchIndices.resize( meshIndexStart );
+					break;
+				}
+				renderer._dynBatchIndices.push_back( (unsigned short)(vertOffset + index) );
+			}
+
+			vertOffset += meshVerts;
+		}
+
+		indexCount = (uint32)renderer._dynBatchIndices.size();
+		if( indexCount > 0 )
+		{
+			renderer._dynBatchVertBuffer = renderer.uploadVertices( &renderer._dynBatchData[0],
+				(uint32)renderer._dynBatchData.size(), renderer._dynBatchVertBuffer );
+			renderer._dynBatchIndexBuffer = renderer.uploadIndices( &renderer._dynBatchIndices[0],
+				indexCount * sizeof( short ), renderer._dynBatchIndexBuffer );
+			Modules::stats().incStat( EngineStats::GeoUploadSize,
+				(float)(renderer._dynBatchData.size() + indexCount * sizeof( short )) );
+			Modules::stats().incStat( EngineStats::BufferBindCount, 2 );
+		}
+		
+		Modules::stats().getTimer( EngineStats::DynBatchTime )->setEnabled( false );
+		
+		if( indexCount == 0 )
+		{
+			first = last;
+			continue;
+		}
+
+		ShaderCombination *curShader = renderer.getCurShader();
+		setBatchUniforms( curShader );
+		if( curShader != prevShader ) setupVertexStreams( curShader );
+
+		glVertexPointer( 3, GL_FLOAT, 0, (char *)0 );
+		glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + vertCount * 12 );
+		glVertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + vertCount * 24 );
+		glVertexAttribPointer( 3, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + vertCount * 36 );
+		const char *base = (char *)0 + staticOffset;
+		glVertexAttribPointer( 4, 4, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base + 8 );
+		glVertexAttribPointer( 5, 4, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base + 24 );
+		glVertexAttribPointer( 6, 2, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base );
+		glVertexAttribPointer( 7, 2, GL_FLOAT, GL_FALSE, sizeof( VertexDataStatic ), base + 40 );
+
+		glDrawRangeElements( GL_TRIANGLES, 0, vertCount - 1, indexCount, GL_UNSIGNED_SHORT, (char *)0 );
+		Modules::stats().incStat( EngineStats::BatchCount, 1 );
+		Modules::stats().incStat( EngineStats::TriCount, indexCount / 3.0f );
+		Modules::stats().incStat( EngineStats::DynBatchSavedCount, (float)(last - first - 1) );
+
+		first = last;
+	}
+
+	queue.resize( 0 );
+}
+
+
+void Renderer::drawInstances( uint32 shaderContext )
+{
+	Renderer &renderer = Modules::renderer();
+	vector< InstanceEntry > &queue = renderer._instanceQueue;
+	const uint32 instanceSize = 16 + 9;
+	
+	std::stable_sort( queue.begin(), queue.end(), instanceOrder );
+
+	// Stream transformations of all instances at once
+	renderer._instanceData.resize( queue.size() * instanceSize );
+	for( size_t i = 0; i < queue.size(); ++i )
+	{
+		float *data = &renderer._instanceData[i * instanceSize];
+		const Matrix4f &absTrans = queue[i].node->getAbsTrans();
+		if( queue[i].geoRes->_quantizedPositions )
+			memcpy( data, (absTrans * queue[i].geoRes->_posDequantMat).x, 16 * sizeof( float ) );
+		else
+			memcpy( data, absTrans.x, 16 * sizeof( float ) );
+		calcWorldNormalMat( absTrans, data + 16 );
+	}
+
+	bool hwInstancing = glExt::ARB_instanced_arrays;
+	if( hwInstancing )
+	{
+		renderer._instanceBuffer = renderer.uploadVertices( &renderer._instanceData[0],
+			(uint32)renderer._instanceData.size() * sizeof( float ), renderer._instanceBuffer );
+		Modules::stats().incStat( EngineStats::GeoUploadSize,
+			(float)(renderer._instanceData.size() * sizeof( float )) );
+	}
+	
+	GeometryResource *curGeoRes = 0x0;
+	uint32 curBaseVertex = 0;
+	size_t first = 0;
+	while( first < queue.size() )
+	{
+		// Find run of meshes with identical geometry and material
+		MeshNode *meshNode = queue[first].node;
+		GeometryResource *geoRes = queue[first].geoRes;
+		size_t last = first + 1;
+		while( last < queue.size() && queue[last].geoRes == geoRes &&
+		       queue[last].node->getMaterialRes() == meshNode->getMaterialRes() &&
+		       queue[last].node->getBatchStart() == meshNode->getBatchStart() &&
+		       queue[last].node->getBatchCount() == meshNode->getBatchCount() )
+		{
+			++last;
+		}
+		
+		ShaderCombination *prevShader = renderer.getCurShader();
+		if( !renderer.setMaterial( meshNode->getMaterialRes(), shaderContext ) )
+		{
+			first = last;
+			continue;
+		}
+		
+		ShaderCombination *curShader = renderer.getCurShader();
+		setBatchUniforms( curShader );
+		if( curShader != prevShader ) setupVertexStreams( curShader );
+
+		if( geoRes != curGeoRes || queue[first].baseVertex != curBaseVertex )
+		{
+			curGeoRes = geoRes;
+			curBaseVertex = queue[first].baseVertex;
+			renderer.setIndexBuffer( curGeoRes->getIndexBuffer() );
+			Modules::stats().incStat( EngineStats::BufferBindCount, 1 );
+			bindModelVertices( curGeoRes, 0, curBaseVertex );
+		}
+
+		uint32 indexSize = curGeoRes->_16BitIndices ? sizeof( short ) : sizeof( int );
+		uint32 indexType = curGeoRes->_16BitIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		const char *indexOffset = (char *)0 + meshNode->getBatchStart() * indexSize;
+		uint32 instCount = (uint32)(last - first);
+		
+		if( hwInstancing && curShader->attrib_instWorldMat >= 0 )
+		{
+			// Bind instance streams
+			renderer.setVertexBuffer( renderer._instanceBuffer );
+			Modules::stats().incStat( EngineStats::BufferBindCount, 1 );
+			const char *base = (char *)0 + first * instanceSize * sizeof( float );
+			for( uint32 i = 0; i < 4; ++i )
+			{
+				glVertexAttribPointer( 8 + i, 4, GL_FLOAT, GL_FALSE, instanceSize * sizeof( float ),
+				                       base + i * 4 * sizeof( float ) );
+				glVertexAttribDivisorARB( 8 + i, 1 );
+				glEnableVertexAttribArray( 8 + i );
+			}
+			if( curShader->attrib_instWorldNormalMat >= 0 )
+			{
+				for( uint32 i = 0; i < 3; ++i )
+				{
+					glVertexAttribPointer( 12 + i, 3, GL_FLOAT, GL_FALSE, instanceSize * sizeof( float ),
+					                       base + (16 + i * 3) * sizeof( float ) );
+					glVertexAttribDivisorARB( 12 + i, 1 );
+					glEnableVertexAttribArray( 12 + i );
+				}
+			}
+			
+			glDrawElementsInstancedARB( GL_TRIANGLES, meshNode->getBatchCount(), indexType, indexOffset,
+			                            instCount );
+			
+			for( uint32 i = 8; i < 15; ++i )
+			{
+				glDisableVertexAttribArray( i );
+				glVertexAttribDivisorARB( i, 0 );
+			}
+			
+			Modules::stats().incStat( EngineStats::BatchCount, 1 );
+			Modules::stats().incStat( EngineStats::InstanceSavedCount, (float)(instCount - 1) );
+		}
+		else
+		{
+			// Fall back to one draw call per instance
+			for( size_t i = first; i < last; ++i )
+			{
+				const float *data = &renderer._instanceData[i * instanceSize];
+				if( curShader->uni_worldMat >= 0 )
+					glUniformMatrix4fv( curShader->uni_worldMat, 1, false, data );
+				if( curShader->uni_worldNormalMat >= 0 )
+					glUniformMatrix3fv( curShader->uni_worldNormalMat, 1, false, data + 16 );
+				setInstanceAttribs( curShader, data, data + 16 );
+				
+				glDrawRangeElements( GL_TRIANGLES,
+				                     meshNode->getVertRStart() - std::min( meshNode->getVertRStart(), curBaseVertex ),
+				                     meshNode->getVertREnd() - std::min( meshNode->getVertREnd(), curBaseVertex ),
+				                     meshNode->getBatchCount(), indexType, indexOffset );
+			}
+			Modules::stats().incStat( EngineStats::BatchCount, (float)instCount );
+		}
+		Modules::stats().incStat( EngineStats::TriCount, (float)(meshNode->getBatchCount() / 3 * instCount) );
+
+		first = last;
+	}
+
+	queue.resize( 0 );
+}
+
+
+void Renderer::drawStaticBatches( uint32 shaderContext, uint32 theClass, bool debugView,
+                                  const Frustum *frust1, const Frustum *frust2 )
+{
+	vector< StaticBatch > &batches = Modules::renderer()._staticBatches;
+	GeometryResource *curGeoRes = 0x0;
+	ShaderCombination *uniformShader = 0x0;  // Last shader that got the batch uniforms
+	uint32 curBaseVertex = 0;
+	
+	for( size_t i = 0, s = batches.size(); i < s; ++i )
+	{
+		StaticBatch &batch = batches[i];
+		
+		if( frust1->cullBox( batch.bBox ) || (frust2 != 0x0 && frust2->cullBox( batch.bBox )) ) continue;
+
+		ShaderCombination *prevShader = Modules::renderer().getCurShader();
+		
+		if( !debugView )
+		{
+			if( !batch.matRes->isOfClass( theClass ) ) continue;
+			if( !Modules::renderer().setMaterial( batch.matRes, shaderContext ) ) continue;
+		}
+		else
+		{
+			Modules::renderer().setShader( &defColorShader );
+			glColor3f( 0.5f, 0.75f, 1 );
+		}
+
+		ShaderCombination *curShader = Modules::renderer().getCurShader();
+
+		if( curShader != uniformShader )
+		{
+			setBatchUniforms( curShader );
+			uniformShader = curShader;
+		}
+
+		if( curShader != prevShader ) setupVertexStreams( curShader );
+
+		if( curGeoRes != batch.geoRes || curBaseVertex != batch.baseVertex )
+		{
+			if( curGeoRes != batch.geoRes )
+			{
+				Modules::renderer().setIndexBuffer( batch.geoRes->getIndexBuffer() );
+				Modules::stats().incStat( EngineStats::BufferBindCount, 1 );
+			}
+			
+			curGeoRes = batch.geoRes;
+			curBaseVertex = batch.baseVertex;
+			bindModelVertices( curGeoRes, 0, curBaseVertex );
+		}
+
+		glDrawRangeElements( GL_TRIANGLES, 0, batch.vertCount - 1, batch.batchCount, GL_UNSIGNED_SHORT,
+		                     (char *)0 + batch.batchStart * sizeof( short ) );
+		Modules::stats().incStat( EngineStats::BatchCount, 1 );
+		Modules::stats().incStat( EngineStats::TriCount, batch.batchCount / 3.0f );
+	}
+}
+
+
+void Renderer::calcMaterialKey( MaterialResource *matRes, uint32 shaderContext, DrawListItem &item )
+{
+	item.shaderKey = 0; item.combKey = 0;
+	item.matKey = (uint32)matRes->getHandle();
+	
+	// Materials without valid shader are rejected by setMaterial anyway
+	ShaderResource *shaderRes = matRes->_shaderRes;
+	ShaderContext *context = shaderRes != 0x0 ? shaderRes->findContext( shaderContext ) : 0x0;
+	if( context == 0x0 ) return;
+
+	// Combinations that are not compiled yet get the highest index
+	uint32 combMask = matRes->_combMask & context->flagMask;
+	item.shaderKey = (uint32)shaderRes->getHandle();
+	item.combKey = (uint32)context->shaderCombs.size();
+	for( size_t i = 0, s = context->shaderCombs.size(); i < s; ++i )
+	{
+		if( context->shaderCombs[i].combMask == combMask )
+		{
+			item.combKey = (uint32)i;
+			break;
+		}
+	}
+}
+
+
+void Renderer::drawModelMesh( MeshDrawState &state, ModelNode *modelNode, MeshNode *meshNode, uint32 baseVertex,
+                              uint32 curLod, uint32 shaderContext, uint32 theClass, bool debugView,
+                              const Frustum *frust1, const Frustum *frust2, bool coneCulling )
+{
+	vector< int > &clusterCounts = Modules::renderer()._clusterCounts;
+	vector< const void * > &clusterOffsets = Modules::renderer()._clusterOffsets;
+
+	GeometryResource *geoRes = modelNode->getGeometryResource();
+
+	// Meshes that are not drawn in this pass are rejected before their clusters are culled
+	ShaderCombination *prevShader = Modules::renderer().getCurShader();
+
+	if( !debugView )
+	{
+		if( !meshNode->getMaterialRes()->isOfClass( theClass ) ) return;
+		if( !Modules::renderer().setMaterial( meshNode->getMaterialRes(), shaderContext ) ) return;
+	}
+	else
+	{
+		Modules::renderer().setShader( &defColorShader );
+		if( curLod == 0 ) glColor3f( 0.5f, 0.75f, 1 );
+		else if( curLod == 1 ) glColor3f( 0.25f, 0.75, 0.75f );
+		else if( curLod == 2 ) glColor3f( 0.25f, 0.75, 0.5f );
+		else if( curLod == 3 ) glColor3f( 0.5f, 0.5f, 0.25f );
+		else glColor3f( 0.75f, 0.5, 0.25f );
+	}
+
+	// Cull clusters of large batches separately; adjacent visible clusters are merged
+	uint32 indexSize = geoRes->_16BitIndices ? sizeof( short ) : sizeof( int );
+	uint32 triCount = meshNode->getBatchCount() / 3;
+	uint32 firstCluster, numClusters;
+	clusterCounts.resize( 0 );
+	clusterOffsets.resize( 0 );
+	if( !geoRes->_clusters.empty() && geoRes->findClusters(
+		meshNode->getBatchStart(), meshNode->getBatchCount(), firstCluster, numClusters ) )
+	{
+		Vec3f viewPoint = meshNode->_absTrans.inverted() * frust1->getOrigin();
+		bool meshConeCulling = coneCulling && meshNode->_absTrans.determinant() > 0;
+
+		triCount = 0;
+		for( uint32 k = firstCluster; k < firstCluster + numClusters; ++k )
+		{
+			const GeometryCluster &cluster = geoRes->_clusters[k];
+
+			// Cluster is back facing if its normal cone points away from the view point
+			if( meshConeCulling && cluster.coneCutoff < 1 )
+			{
+				Vec3f center = (cluster.bBMin + cluster.bBMax) * 0.5f;
+				float radius = (cluster.bBMax - cluster.bBMin).length() * 0.5f;
+				Vec3f viewDir = center - viewPoint;
+				if( viewDir.dot( cluster.coneAxis ) >=
+				    cluster.coneCutoff * viewDir.length() + radius * (1 + cluster.coneCutoff) )
+					continue;
+			}
+
+			BoundingBox bBox;
+			bBox.getMinCoords() = cluster.bBMin;
+			bBox.getMaxCoords() = cluster.bBMax;
+			bBox.transform( meshNode->_absTrans );
+			if( frust1->cullBox( bBox ) || (frust2 != 0x0 && frust2->cullBox( bBox )) ) continue;
+
+			const char *offset = (char *)0 + cluster.batchStart * indexSize;
+			if( !clusterCounts.empty() &&
+			    (const char *)clusterOffsets.back() + clusterCounts.back() * indexSize == offset )
+			{
+				clusterCounts.back() += cluster.batchCount;
+			}
+			else
+			{
+				clusterCounts.push_back( cluster.batchCount );
+				clusterOffsets.push_back( offset );
+			}
+			triCount += cluster.batchCount / 3;
+		}
+
+		Modules::stats().incStat( EngineStats::ClusterTriCount, meshNode->getBatchCount() / 3.0f );
+		Modules::stats().incStat( EngineStats::ClusterCullRatio,
+		                          (float)(meshNode->getBatchCount() / 3 - triCount) );
+		if( triCount == 0 ) return;
+	}
+
+	ShaderCombination *curShader = Modules::renderer().getCurShader();
+
+	bool modelChanged = modelNode != state.modelNode;
+	if( modelChanged )
+	{
+		state.modelNode = modelNode;
+		state.paletteUsed = false;
+	}
+
+	// Skeleton; joints are either passed as matrix rows (3 vec4) or dual quaternions (2 vec4)
+	int skinUniform = curShader->uni_skinDualQuats >= 0 ?
+		curShader->uni_skinDualQuats : curShader->uni_skinMatRows;
+	if( skinUniform >= 0 && !modelNode->_skinMatRows.empty() )
+	{
+		// Note:	OpenGL 2.1 supports mat4x3 but it is internally realized as mat4 on most
+		//			hardware so it would require 4 instead of 3 uniform slots per joint
+
+		uint32 vecsPerJoint = 3;
+		std::vector< Vec4f > *skinData = &modelNode->_skinMatRows;
+		if( curShader->uni_skinDualQuats >= 0 )
+		{
+			modelNode->updateSkinDualQuats();
+			vecsPerJoint = 2;
+			skinData = &modelNode->_skinDualQuats;
+		}
+
+		// Meshes with a joint palette only get the data of the joints they reference
+		const JointPalette *palette = geoRes->getJointPalette(
+			meshNode->getVertRStart(), meshNode->getVertREnd() );
+
+		if( palette != 0x0 )
+		{
+			vector< Vec4f > &skinPaletteData = Modules::renderer()._skinPaletteData;
+			skinPaletteData.resize( palette->joints.size() * vecsPerJoint );
+			for( size_t k = 0, s = palette->joints.size(); k < s; ++k )
+			{
+				uint32 jointIndex = palette->joints[k];
+				if( !modelNode->jointExists( jointIndex ) ) jointIndex = 0;
+
+				for( uint32 l = 0; l < vecsPerJoint; ++l )
+					skinPaletteData[k * vecsPerJoint + l] = (*skinData)[jointIndex * vecsPerJoint + l];
+			}
+
+			glUniform4fv( skinUniform, (int)skinPaletteData.size(), (float *)&skinPaletteData[0] );
+			state.paletteUsed = true;
+		}
+		else if( modelChanged || curShader != prevShader || state.paletteUsed )
+		{
+			glUniform4fv( skinUniform, (int)skinData->size(), (float *)&(*skinData)[0] );
+			state.paletteUsed = false;
+		}
+
+		if( curShader->uni_skinInfluences >= 0 && (modelChanged || curShader != prevShader) )
+		{
+			glUniform1f( curShader->uni_skinInfluences,
+			             (float)modelNode->calcSkinInfluences( curLod ) );
+		}
+	}
+
+	// Dynamic streams are taken from the private copy of the model if it has one
+	uint32 dynVertBuffer = modelNode->_dynVertData != 0x0 &&
+		modelNode->_dynVertData->vertCount == geoRes->_vertCount ? modelNode->_dynVertBuffer : 0;
+
+	// World transformation; quantized positions are mapped to geometry space first
+	Matrix4f worldMat = meshNode->_absTrans;
+	if( dynVertBuffer == 0 && geoRes->_quantizedPositions ) worldMat = worldMat * geoRes->_posDequantMat;
+	if( curShader->uni_worldMat >= 0 )
+	{
+		glUniformMatrix4fv( curShader->uni_worldMat, 1, false, &worldMat.x[0] );
+	}
+	float normalMat[9];
+	if( curShader->uni_worldNormalMat >= 0 || curShader->attrib_instWorldNormalMat >= 0 )
+	{
+		// TODO: Optimize this
+		calcWorldNormalMat( meshNode->_absTrans, normalMat );
+		if( curShader->uni_worldNormalMat >= 0 )
+			glUniformMatrix3fv( curShader->uni_worldNormalMat, 1, false, normalMat );
+	}
+	if( curShader->attrib_instWorldMat >= 0 || curShader->attrib_instWorldNormalMat >= 0 )
+		setInstanceAttribs( curShader, &worldMat.x[0], normalMat );
+
+	if( curShader != prevShader ) setupVertexStreams( curShader );
+
+	// Bind geometry
+	if( geoRes != state.geoRes )
+	{
+		Modules::renderer().setIndexBuffer( geoRes->getIndexBuffer() );
+		Modules::stats().incStat( EngineStats::BufferBindCount, 1 );
+	}
+	// Rebased indices require the vertex streams to start at the base vertex
+	if( geoRes != state.geoRes || dynVertBuffer != state.dynVertBuffer || baseVertex != state.baseVertex )
+	{
+		bindModelVertices( geoRes, dynVertBuffer, baseVertex );
+		state.geoRes = geoRes;
+		state.dynVertBuffer = dynVertBuffer;
+		state.baseVertex = baseVertex;
+	}
+
+	// Render
+	if( clusterCounts.size() > 1 )
+	{
+		glMultiDrawElements( GL_TRIANGLES, &clusterCounts[0],
+		                     geoRes->_16BitIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+		                     &clusterOffsets[0], (int)clusterCounts.size() );
+	}
+	else
+	{
+		glDrawRangeElements( GL_TRIANGLES, meshNode->getVertRStart() - std::min( meshNode->getVertRStart(), baseVertex ),
+		                     meshNode->getVertREnd() - std::min( meshNode->getVertREnd(), baseVertex ),
+		                     clusterCounts.empty() ? meshNode->getBatchCount() : clusterCounts[0],
+		                     geoRes->_16BitIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+		                     clusterCounts.empty() ? (char *)0 + meshNode->getBatchStart() * indexSize :
+		                     clusterOffsets[0] );
+	}
+	Modules::stats().incStat( EngineStats::BatchCount, 1 );
+	Modules::stats().incStat( EngineStats::TriCount, (float)triCount );
+}
+
+
+void Renderer::drawModels( uint32 shaderContext, uint32 theClass, bool debugView,
                            const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
                            int occSet )
 {
@@ -1552,10 +2510,28 @@ void Renderer::drawModels( const string &shaderContext, const string &theClass,
 	Vec3f camPos( frust1->getOrigin() );
 	if( Modules::renderer().getCurCamera() != 0x0 )
 		camPos = Modules::renderer().getCurCamera()->getAbsPos();
-	
-	GeometryResource *curGeoRes = 0x0;
 
-	Modules::renderer().setMaterial( 0x0, "" );
+	MeshDrawState state = { 0x0, 0x0, 0, 0, false };
+	uint32 dynBatchSize = (uint32)std::min( std::max( Modules::config().dynamicBatchSize, 0 ), 65536 );
+	MaterialResource *instCheckedMatRes = 0x0, *keyMatRes = 0x0;
+	bool instContext = false;
+	DrawListItem keyItem;
+
+	// Normal cone culling of clusters requires a perspective view point and regular face culling
+	CameraNode *curCam = Modules::renderer().getCurCamera();
+	bool coneCulling = !debugView && !Modules::config().wireframeMode &&
+		!(curCam != 0x0 && curCam->_orthographic && frust1 == &curCam->getFrustum());
+
+	// Meshes of all models are sorted by state into a single draw list; this is not possible
+	// when occlusion queries have to enclose the meshes of each model
+	vector< DrawListItem > &drawList = Modules::renderer()._drawList;
+	bool useDrawList = order == RenderingOrder::StateChanges && occSet < 0 && !debugView;
+	drawList.resize( 0 );
+
+	// Static batches are drawn like dynamic batches; otherwise their meshes are drawn separately
+	bool staticBatching = order != RenderingOrder::BackToFront && occSet < 0;
+
+	Modules::renderer().setMaterial( 0x0, 0 );
 
 	// Enable vertex array
 	glEnableClientState( GL_VERTEX_ARRAY );
@@ -1564,12 +2540,12 @@ void Renderer::drawModels( const string &shaderContext, const string &theClass,
 	for( size_t i = 0, s = Modules::sceneMan().getRenderableQueue().size(); i < s; ++i )
 	{
 		if( Modules::sceneMan().getRenderableQueue()[i].type != SceneNodeTypes::Model ) continue;
-		
+
 		ModelNode *modelNode = (ModelNode *)Modules::sceneMan().getRenderableQueue()[i].node;
-		if( modelNode->getGeometryResource() == 0x0 ) continue;
+		GeometryResource *geoRes = modelNode->getGeometryResource();
+		if( geoRes == 0x0 ) continue;
 
 		bool occCulling = false;
-		bool modelChanged = true;
 
 		// Occlusion culling
 		if( occSet >= 0 )
@@ -1589,24 +2565,24 @@ void Renderer::drawModels( const string &shaderContext, const string &theClass,
 				if( modelNode->_lastVisited[occSet] != Modules::renderer().getFrameID() )
 				{
 					modelNode->_lastVisited[occSet] = Modules::renderer().getFrameID();
-				
+
 					// Check query result (viewer must be outside of bounding box)
 					if( nearestDistToAABB( frust1->getOrigin(), modelNode->getBBox().getMinCoords(),
 					                       modelNode->getBBox().getMaxCoords() ) != 0 &&
 						Modules::renderer().getOccQueryResult( modelNode->_occQueries[occSet] ) < 1 )
 					{
 						// Draw occlusion box
-						Modules::renderer().setMaterial( 0x0, "" );
-						glColorMask( 0, 0, 0, 0 );
-						glDepthMask( 0 );
+						Modules::renderer().setMaterial( 0x0, 0 );
+						Modules::renderer().setColorMask( false );
+						Modules::renderer().setDepthMask( false );
 						Modules::renderer().beginOccQuery( modelNode->_occQueries[occSet] );
 						Modules::renderer().setShader( &Modules::renderer().occShader );
 						Modules::renderer().drawAABB( modelNode->getBBox().getMinCoords(),
 						                              modelNode->getBBox().getMaxCoords() );
 						Modules::renderer().endOccQuery( modelNode->_occQueries[occSet] );
-						glDepthMask( 1 );
-						glColorMask( 1, 1, 1, 1 );
-						Modules::renderer().setMaterial( 0x0, "" );
+						Modules::renderer().setDepthMask( true );
+						Modules::renderer().setColorMask( true );
+						Modules::renderer().setMaterial( 0x0, 0 );
 
 						continue;
 					}
@@ -1615,35 +2591,23 @@ void Renderer::drawModels( const string &shaderContext, const string &theClass,
 				}
 			}
 		}
-		
-		// Bind geometry
-		if( curGeoRes != modelNode->getGeometryResource() )
-		{
-			curGeoRes = modelNode->getGeometryResource();
-			Modules::renderer().setMaterial( 0x0, "" );
-		
-			// Indices
-			glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, curGeoRes->getIndexBuffer() );
-
-			// Vertices
-			uint32 vertCount = curGeoRes->_vertCount;
-			glBindBuffer( GL_ARRAY_BUFFER, curGeoRes->getVertBuffer() );
-			glVertexPointer( 3, GL_FLOAT, 0, (char *)0 );
-			glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + vertCount * 12 );
-			glVertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + vertCount * 24 );
-			glVertexAttribPointer( 3, 3, GL_FLOAT, GL_FALSE, 0, (char *)0 + vertCount * 36 );
-			glVertexAttribPointer( 4, 4, GL_FLOAT, GL_FALSE,
-			                       sizeof( VertexDataStatic ), (char *)0 + vertCount * 48 + 8 );
-			glVertexAttribPointer( 5, 4, GL_FLOAT, GL_FALSE,
-			                       sizeof( VertexDataStatic ), (char *)0 + vertCount * 48 + 24 );
-			glVertexAttribPointer( 6, 2, GL_FLOAT, GL_FALSE,
-			                       sizeof( VertexDataStatic ), (char *)0 + vertCount * 48 );
-			glVertexAttribPointer( 7, 2, GL_FLOAT, GL_FALSE,
-			                       sizeof( VertexDataStatic ), (char *)0 + vertCount * 48 + 40 );
-		}
-		
+
+		bool privateVertData = modelNode->_dynVertData != 0x0 &&
+			modelNode->_dynVertData->vertCount == geoRes->_vertCount;
+
+		// Small meshes are merged into dynamic batches when their vertices only depend on the mesh
+		// transformation; batches would break blending order and occlusion queries
+		bool dynBatching = dynBatchSize > 0 && !debugView && occSet < 0 && order != RenderingOrder::BackToFront &&
+			!privateVertData && modelNode->_skeleton.empty() && !modelNode->_softwareSkinning &&
+			geoRes->_joints.size() <= 1 && geoRes->_morphTargets.empty() && geoRes->hasCPUData();
+
+		// Instancing has the same requirements but does not need the vertex data on the CPU
+		bool instancing = !debugView && occSet < 0 && order != RenderingOrder::BackToFront &&
+			!privateVertData && modelNode->_skeleton.empty() && !modelNode->_softwareSkinning &&
+			geoRes->_joints.size() <= 1 && geoRes->_morphTargets.empty();
+
 		// Sort meshes
-		if( order == RenderingOrder::FrontToBack || order == RenderingOrder::BackToFront && frust1 != 0x0 )
+		if( order == RenderingOrder::FrontToBack || (order == RenderingOrder::BackToFront && frust1 != 0x0) )
 		{
 			for( uint32 j = 0; j < modelNode->_meshCount; ++j )
 			{
@@ -1660,22 +2624,23 @@ void Renderer::drawModels( const string &shaderContext, const string &theClass,
 		else if( order == RenderingOrder::BackToFront )
 			std::sort( modelNode->_nodeList.begin(), modelNode->_nodeList.begin() + modelNode->_meshCount,
 			           nodeBackToFrontOrder );
-		else if( order == RenderingOrder::StateChanges )
+		else if( order == RenderingOrder::StateChanges && !useDrawList )
 			// Sort meshes by material to minimize state changes
 			std::sort( modelNode->_nodeList.begin(), modelNode->_nodeList.begin() + modelNode->_meshCount,
 			           meshMaterialOrder );
-		
+
 		// LOD
 		uint32 curLod = modelNode->calcLodLevel( camPos );
-		
+
 		if( occCulling )
 			Modules::renderer().beginOccQuery( modelNode->_occQueries[occSet] );
-		
+
 		for( uint32 j = 0; j < modelNode->_meshCount; ++j )
 		{
 			MeshNode *meshNode = (MeshNode *)modelNode->_nodeList[j].node;
 
-			if( !meshNode->_active || meshNode->getLodLevel() != curLod ) continue;
+			if( !meshNode->_active || (meshNode->_staticBatched && staticBatching) ||
+			    meshNode->getLodLevel() != curLod ) continue;
 
 			// Frustum culling for meshes
 			if( (frust1 != 0x0 && frust1->cullBox( meshNode->_bBox )) ||
@@ -1683,107 +2648,112 @@ void Renderer::drawModels( const string &shaderContext, const string &theClass,
 			{
 				continue;
 			}
-			
+
 			// Check that mesh is valid
-			if( meshNode->getBatchStart() + meshNode->getBatchCount() > curGeoRes->_indices.size() )
+			uint32 baseVertex;
+			if( meshNode->getBatchStart() + meshNode->getBatchCount() > geoRes->_indexCount ||
+			    !geoRes->getBaseVertex( meshNode->getBatchStart(), meshNode->getBatchCount(), baseVertex ) )
 				continue;
-			
-			ShaderCombination *prevShader = Modules::renderer().getCurShader();
-			
-			if( !debugView )
-			{
-				if( !meshNode->getMaterialRes()->isOfClass( theClass ) ) continue;
-				if( !Modules::renderer().setMaterial( meshNode->getMaterialRes(), shaderContext ) ) continue;
-			}
-			else
-			{
-				Modules::renderer().setShader( &defColorShader );
-				if( curLod == 0 ) glColor3f( 0.5f, 0.75f, 1 );
-				else if( curLod == 1 ) glColor3f( 0.25f, 0.75, 0.75f );
-				else if( curLod == 2 ) glColor3f( 0.25f, 0.75, 0.5f );
-				else if( curLod == 3 ) glColor3f( 0.5f, 0.5f, 0.25f );
-				else glColor3f( 0.75f, 0.5, 0.25f );
-			}
 
-			ShaderCombination *curShader = Modules::renderer().getCurShader();
-
-			if( modelChanged || curShader != prevShader )
+			// Meshes of shader contexts with instancing are drawn later as runs of identical meshes
+			if( instancing )
 			{
-				// Skeleton
-				if( curShader->uni_skinMatRows >= 0 && !modelNode->_skinMatRows.empty() )
+				if( meshNode->getMaterialRes() != instCheckedMatRes )
 				{
-					// Note:	OpenGL 2.1 supports mat4x3 but it is internally realized as mat4 on most
-					//			hardware so it would require 4 instead of 3 uniform slots per joint
-					
-					glUniform4fv( curShader->uni_skinMatRows, (int)modelNode->_skinMatRows.size(),
-					              (float *)&modelNode->_skinMatRows[0] );
+					instCheckedMatRes = meshNode->getMaterialRes();
+					ShaderContext *context = instCheckedMatRes->_shaderRes != 0x0 ?
+						instCheckedMatRes->_shaderRes->findContext( shaderContext ) : 0x0;
+					instContext = context != 0x0 && context->instancing;
+				}
+				if( instContext )
+				{
+					if( meshNode->getMaterialRes()->isOfClass( theClass ) )
+					{
+						InstanceEntry entry = { meshNode, geoRes, baseVertex };
+						Modules::renderer()._instanceQueue.push_back( entry );
+					}
+					continue;
 				}
-
-				modelChanged = false;
 			}
 
-			// World transformation
-			if( curShader->uni_worldMat >= 0 )
-			{
-				glUniformMatrix4fv( curShader->uni_worldMat, 1, false, &meshNode->_absTrans.x[0] );
-			}
-			if( curShader->uni_worldNormalMat >= 0 )
+			if( dynBatching && meshNode->getVertREnd() < geoRes->_vertCount &&
+			    meshNode->getVertREnd() >= meshNode->getVertRStart() &&
+			    meshNode->getVertREnd() - meshNode->getVertRStart() < dynBatchSize )
 			{
-				// TODO: Optimize this
-				Matrix4f normalMat4 = meshNode->_absTrans.inverted().transposed();
-				float normalMat[9] = { normalMat4.x[0], normalMat4.x[1], normalMat4.x[2],
-				                       normalMat4.x[4], normalMat4.x[5], normalMat4.x[6],
-				                       normalMat4.x[8], normalMat4.x[9], normalMat4.x[10] };
-				glUniformMatrix3fv( curShader->uni_worldNormalMat, 1, false, normalMat );
+				if( meshNode->getMaterialRes()->isOfClass( theClass ) )
+				{
+					DynBatchEntry entry = { meshNode, geoRes };
+					Modules::renderer()._dynBatchQueue.push_back( entry );
+				}
+				continue;
 			}
 
-			// Enable required vertex streams and disable others to save bandwidth
-			if( curShader != prevShader )
+			if( useDrawList )
 			{
-				if( curShader->attrib_normal >= 0 ) glEnableVertexAttribArray( 1 );
-				else glDisableVertexAttribArray( 1 );
-				if( curShader->attrib_tangent >= 0 ) glEnableVertexAttribArray( 2 );
-				else glDisableVertexAttribArray( 2 );
-				if( curShader->attrib_bitangent >= 0 ) glEnableVertexAttribArray( 3 );
-				else glDisableVertexAttribArray( 3 );
-				if( curShader->attrib_joints >= 0 ) glEnableVertexAttribArray( 4 );
-				else glDisableVertexAttribArray( 4 );
-				if( curShader->attrib_weights >= 0 ) glEnableVertexAttribArray( 5 );
-				else glDisableVertexAttribArray( 5 );
-				if( curShader->attrib_texCoords0 >= 0 ) glEnableVertexAttribArray( 6 );
-				else glDisableVertexAttribArray( 6 );
-				if( curShader->attrib_texCoords1 >= 0 ) glEnableVertexAttribArray( 7 );
-				else glDisableVertexAttribArray( 7 );
+				if( meshNode->getMaterialRes() != keyMatRes )
+				{
+					keyMatRes = meshNode->getMaterialRes();
+					calcMaterialKey( keyMatRes, shaderContext, keyItem );
+				}
+
+				// Sorted by shader, combination, material, geometry and view distance (the bits of
+				// a positive float keep its order)
+				float dist = nearestDistToAABB( frust1->getOrigin(),
+					meshNode->_bBox.getMinCoords(), meshNode->_bBox.getMaxCoords() );
+
+				DrawListItem item = keyItem;
+				item.geoKey = (uint32)geoRes->getHandle();
+				memcpy( &item.distKey, &dist, sizeof( uint32 ) );
+				item.modelNode = modelNode;
+				item.meshNode = meshNode;
+				item.baseVertex = baseVertex;
+				item.lod = curLod;
+				drawList.push_back( item );
+				continue;
 			}
 
-			// Render
-			glDrawRangeElements( GL_TRIANGLES, meshNode->getVertRStart(), meshNode->getVertREnd(),
-			                     meshNode->getBatchCount(), 
-			                     curGeoRes->_16BitIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
-			                     (char *)0 + meshNode->getBatchStart() *
-			                     (curGeoRes->_16BitIndices ? sizeof( short ) : sizeof( int )) );
-			Modules::stats().incStat( EngineStats::BatchCount, 1 );
-			Modules::stats().incStat( EngineStats::TriCount, meshNode->getBatchCount() / 3.0f );
+			drawModelMesh( state, modelNode, meshNode, baseVertex, curLod, shaderContext, theClass,
+			               debugView, frust1, frust2, coneCulling );
 		}
 
 		if( occCulling )
 			Modules::renderer().endOccQuery( modelNode->_occQueries[occSet] );
 	}
 
+	if( !drawList.empty() )
+	{
+		std::sort( drawList.begin(), drawList.end(), drawListOrder );
+
+		for( size_t i = 0, s = drawList.size(); i < s; ++i )
+		{
+			const DrawListItem &item = drawList[i];
+			drawModelMesh( state, item.modelNode, item.meshNode, item.baseVertex, item.lod,
+			               shaderContext, theClass, debugView, frust1, frust2, coneCulling );
+		}
+		drawList.resize( 0 );
+	}
+
+	if( !Modules::renderer()._instanceQueue.empty() )
+		drawInstances( shaderContext );
+	if( !Modules::renderer()._dynBatchQueue.empty() )
+		drawDynamicBatches( shaderContext );
+	if( staticBatching && !Modules::renderer()._staticBatches.empty() )
+		drawStaticBatches( shaderContext, theClass, debugView, frust1, frust2 );
+
 	// Disable vertex streams
 	glDisableClientState( GL_VERTEX_ARRAY );
 	for( uint32 i = 1; i < 8; ++i ) glDisableVertexAttribArray( i );
 }
 
 
-void Renderer::drawParticles( const string &shaderContext, const string &theClass, bool debugView,
+void Renderer::drawParticles( uint32 shaderContext, uint32 theClass, bool debugView,
                               const Frustum *frust1, const Frustum * /*frust2*/, RenderingOrder::List /*order*/,
                               int occSet )
 {
 	if( frust1 == 0x0 ) return;
 	if( debugView ) return;  // Don't render particles in debug view
 	
-	Modules::renderer().setMaterial( 0x0, "" );
+	Modules::renderer().setMaterial( 0x0, 0 );
 
 	// Calculate right and up vectors for camera alignment
 	float mat[16];
@@ -1793,7 +2763,7 @@ void Renderer::drawParticles( const string &shaderContext, const string &theClas
 	Vec3f corners[4] = { -right - up, right - up, right + up, -right + up };
 
 	// Bind particle geometry arrays
-	glBindBuffer( GL_ARRAY_BUFFER, Modules::renderer().getParticleVBO() );
+	Modules::renderer().setVertexBuffer( Modules::renderer().getParticleVBO() );
 	glVertexPointer( 3, GL_FLOAT, sizeof( ParticleVert ), (char *)0 );
 	glEnableClientState( GL_VERTEX_ARRAY );
 	glVertexAttribPointer( 1, 1, GL_FLOAT, GL_FALSE, sizeof( ParticleVert ), (char *)0 + sizeof( float ) * 6 );
@@ -1839,17 +2809,17 @@ void Renderer::drawParticles( const string &shaderContext, const string &theClas
 						Modules::renderer().getOccQueryResult( emitter->_occQueries[occSet] ) < 1 )
 					{
 						// Draw occlusion box
-						Modules::renderer().setMaterial( 0x0, "" );
-						glColorMask( 0, 0, 0, 0 );
-						glDepthMask( 0 );
+						Modules::renderer().setMaterial( 0x0, 0 );
+						Modules::renderer().setColorMask( false );
+						Modules::renderer().setDepthMask( false );
 						Modules::renderer().beginOccQuery( emitter->_occQueries[occSet] );
 						Modules::renderer().setShader( &Modules::renderer().occShader );
 						Modules::renderer().drawAABB( emitter->getLocalBBox()->getMinCoords(),
 						                              emitter->getLocalBBox()->getMaxCoords() );
 						Modules::renderer().endOccQuery( emitter->_occQueries[occSet] );
-						glDepthMask( 1 );
-						glColorMask( 1, 1, 1, 1 );
-						Modules::renderer().setMaterial( 0x0, "" );
+						Modules::renderer().setDepthMask( true );
+						Modules::renderer().setColorMask( true );
+						Modules::renderer().setMaterial( 0x0, 0 );
 
 						continue;
 					}
@@ -1947,6 +2917,10 @@ bool Renderer::render( CameraNode *camNode )
 	if( _curCamera == 0x0 ) return false;
 
 	++_frameID;
+	beginStateCaching();
+
+	// Catch up with animation that was skipped while models were not visible
+	Modules::sceneMan().updateAnimLod( _curCamera->getFrustum(), _curCamera->getAbsPos() );
 	
 	if( Modules::config().debugViewMode || _curCamera->_pipelineRes == 0x0 )
 	{
@@ -1963,15 +2937,17 @@ bool Renderer::render( CameraNode *camNode )
 		setRenderBuffer( 0x0 );
 
 	// Process pipeline commands
-	for( uint32 i = 0; i < _curCamera->_pipelineRes->_stages.size(); ++i )
+	PipelineResource &pipeRes = *_curCamera->_pipelineRes;
+	
+	for( uint32 i = 0; i < pipeRes._stages.size(); ++i )
 	{
-		PipelineStage &stage = _curCamera->_pipelineRes->_stages[i];
+		PipelineStage &stage = pipeRes._stages[i];
 		if( !stage.enabled ) continue;
 		_curStageMatLink = stage.matLink;
 		
-		for( uint32 j = 0; j < stage.commands.size(); ++j )
+		for( uint32 j = 0, s = (uint32)stage.commands.size(); j < s; ++j )
 		{
-			PipelineCommand &pc = stage.commands[j];
+			const PipelineCommand &pc = stage.commands[j];
 			RenderTarget *rt;
 
 			switch( pc.command )
@@ -1986,7 +2962,7 @@ bool Renderer::render( CameraNode *camNode )
 				}
 				
 				// Bind new render target
-				rt = (RenderTarget *)pc.refParams[0];
+				rt = pc.params.switchTarget.target;
 				_curRenderTarget = rt;
 
 				if( rt != 0x0 )
@@ -2004,10 +2980,8 @@ bool Renderer::render( CameraNode *camNode )
 				break;
 
 			case PipelineCommands::BindBuffer:
-				rt = (RenderTarget *)pc.refParams[0];
-			
-				bindBuffer( &rt->rendBuf, ((PCStringParam *)pc.valParams[0])->get(),
-				            (uint32)((PCIntParam *)pc.valParams[1])->get() );
+				bindBuffer( &pc.params.bindBuffer.target->rendBuf, pipeRes._strings[pc.params.bindBuffer.sampler],
+				            pc.params.bindBuffer.bufIndex );
 				break;
 
 			case PipelineCommands::UnbindBuffers:
@@ -2015,45 +2989,40 @@ bool Renderer::render( CameraNode *camNode )
 				break;
 
 			case PipelineCommands::ClearTarget:
-				clear( ((PCBoolParam *)pc.valParams[0])->get(), ((PCBoolParam *)pc.valParams[1])->get(),
-				       ((PCBoolParam *)pc.valParams[2])->get(), ((PCBoolParam *)pc.valParams[3])->get(),
-				       ((PCBoolParam *)pc.valParams[4])->get(), ((PCFloatParam *)pc.valParams[5])->get(),
-				       ((PCFloatParam *)pc.valParams[6])->get(), ((PCFloatParam *)pc.valParams[7])->get(),
-				       ((PCFloatParam *)pc.valParams[8])->get() );
+				clear( pc.params.clearTarget.depthBuf, pc.params.clearTarget.colBufs[0],
+				       pc.params.clearTarget.colBufs[1], pc.params.clearTarget.colBufs[2],
+				       pc.params.clearTarget.colBufs[3], pc.params.clearTarget.col[0], pc.params.clearTarget.col[1],
+				       pc.params.clearTarget.col[2], pc.params.clearTarget.col[3] );
 				break;
 
 			case PipelineCommands::DrawGeometry:
-				drawGeometry( ((PCStringParam *)pc.valParams[0])->get(), ((PCStringParam *)pc.valParams[1])->get(),
-					(RenderingOrder::List)((PCIntParam *)pc.valParams[2])->get(), _curCamera->_occSet );
+				drawGeometry( pc.params.drawGeometry.context, pc.params.drawGeometry.theClass,
+				              pc.params.drawGeometry.order, _curCamera->_occSet );
 				break;
 
 			case PipelineCommands::DrawOverlays:
-				drawOverlays( ((PCStringParam *)pc.valParams[0])->get() );
+				drawOverlays( pc.params.drawOverlays.context );
 				break;
 
 			case PipelineCommands::DrawQuad:
-				drawFSQuad( pc.resParams[0], ((PCStringParam *)pc.valParams[0])->get() );
-			break;
+				drawFSQuad( pc.params.drawQuad.matRes, pc.params.drawQuad.context );
+				break;
 
 			case PipelineCommands::DoForwardLightLoop:
-				drawLightGeometry( ((PCStringParam *)pc.valParams[0])->get(), ((PCStringParam *)pc.valParams[1])->get(),
-					((PCBoolParam *)pc.valParams[2])->get(), (RenderingOrder::List)((PCIntParam *)pc.valParams[3])->get(),
-					_curCamera->_occSet );
+				drawLightGeometry( pc.params.forwardLightLoop.context, pc.params.forwardLightLoop.theClass,
+				                   pc.params.forwardLightLoop.noShadows, pc.params.forwardLightLoop.order,
+				                   _curCamera->_occSet );
 				break;
 
 			case PipelineCommands::DoDeferredLightLoop:
-				drawLightShapes( ((PCStringParam *)pc.valParams[0])->get(), ((PCBoolParam *)pc.valParams[1])->get(),
-					_curCamera->_occSet );
+				drawLightShapes( pc.params.deferredLightLoop.context, pc.params.deferredLightLoop.noShadows,
+				                 _curCamera->_occSet );
 				break;
 
 			case PipelineCommands::SetUniform:
-				if( pc.resParams[0] != 0x0 && pc.resParams[0]->getType() == ResourceTypes::Material )
-				{
-					((MaterialResource *)pc.resParams[0].getPtr())->setUniform(
-						((PCStringParam *)pc.valParams[0])->get(), ((PCFloatParam *)pc.valParams[1])->get(),
-						((PCFloatParam *)pc.valParams[2])->get(), ((PCFloatParam *)pc.valParams[3])->get(),
-						((PCFloatParam *)pc.valParams[4])->get() );
-				}
+				pc.params.setUniform.matRes->setUniform( pipeRes._strings[pc.params.setUniform.uniform],
+					pc.params.setUniform.values[0], pc.params.setUniform.values[1],
+					pc.params.setUniform.values[2], pc.params.setUniform.values[3] );
 				break;
 			}
 		}
@@ -2080,9 +3049,9 @@ void Renderer::renderDebugView()
 	if( _curCamera == 0x0 ) return;
 	
 	setRenderBuffer( 0x0 );
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, 0 );
 	glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-	glDisable( GL_CULL_FACE );
+	setCulling( false );
 
 	glClearColor( 0, 0, 0, 1 );
 	glClear( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT );
@@ -2092,10 +3061,10 @@ void Renderer::renderDebugView()
 
 	// Draw nodes
 	glColor4f( 0.5f, 0.75f, 1, 1 );
-	drawRenderables( "", "", true, &_curCamera->getFrustum(), 0x0, RenderingOrder::None, -1 );
+	drawRenderables( 0, 0, true, &_curCamera->getFrustum(), 0x0, RenderingOrder::None, -1 );
 
 	// Draw bounding boxes
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, 0 );
 	setShader( &defColorShader );
 	glUniformMatrix4fv( defColorShader.uni_worldMat, 1, false, &Matrix4f().x[0] );
 	glColor4f( 0.4f, 0.4f, 0.4f, 1 );
@@ -2147,8 +3116,8 @@ void Renderer::renderDebugView()
 
 	// Draw screen space projection of light sources
 	glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-	glEnable( GL_BLEND );
-	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+	setBlending( true );
+	setBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 	glColor4f( 1, 1, 1, 0.25f );
 	
 	for( size_t i = 0, s = Modules::sceneMan().getLightQueue().size(); i < s; ++i )
@@ -2176,8 +3145,8 @@ void Renderer::renderDebugView()
 		glEnd();
 	}
 
-	glEnable( GL_CULL_FACE );
-	glDisable( GL_BLEND );
+	setCulling( true );
+	setBlending( false );
 }
 
 
@@ -2186,16 +3155,20 @@ void Renderer::finishRendering()
 	// Reset states for apps using debug mode to draw custom geometry
 	// with direct OpenGL calls (e.g. Horde scene editor)
 	setRenderBuffer( 0x0 );
-	glDisable( GL_BLEND );
-	glDisable( GL_ALPHA_TEST );
-	glDisable( GL_SAMPLE_ALPHA_TO_COVERAGE );
-	glDepthMask( 1 );
-	glEnable( GL_DEPTH_TEST );
-	glDepthFunc( GL_LEQUAL );
+	setBlending( false );
+	setAlphaTest( false );
+	setAlphaToCoverage( false );
+	setDepthMask( true );
+	setDepthTest( true );
+	setDepthFunc( GL_LEQUAL );
 	setShader( 0x0 );
-	glBindBuffer( GL_ARRAY_BUFFER, 0 );
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	setVertexBuffer( 0 );
+	setIndexBuffer( 0 );
+	setActiveTexUnit( 0 );
 	if( _curCamera != 0x0 ) setupViewMatrices( _curCamera );
 
+	// States may be changed by the application until the next frame is rendered
+	endStateCaching();
+
 	ASSERT( glGetError() == GL_NO_ERROR );
 }
@@ -39,6 +39,7 @@ class MaterialResource;
 struct ShaderContext;
 
 const uint32 ParticlesPerBatch = 64;	// Warning: The GPU must have enough registers
+const uint32 MaxStaticBatchVerts = 32768;	// Must be addressable with 16 bit indices
 
 extern const char *vsDefColor;
 extern const char *fsDefColor;
@@ -99,6 +100,50 @@ struct ParticleVert
 
 // =================================================================================================
 
+struct StaticBatch	// Cell of static meshes with the same material that is drawn with a single call
+{
+	GeometryResource   *geoRes;  // Merged geometry of all cells with the material
+	PMaterialResource  matRes;
+	BoundingBox        bBox;
+	uint32             batchStart, batchCount;
+	uint32             baseVertex, vertCount;
+};
+
+
+struct DynBatchEntry	// Visible mesh that is merged into a dynamic batch
+{
+	MeshNode          *node;
+	GeometryResource  *geoRes;
+};
+
+
+struct InstanceEntry	// Visible mesh that is drawn as instance of a mesh with identical geometry and material
+{
+	MeshNode          *node;
+	GeometryResource  *geoRes;
+	uint32            baseVertex;
+};
+
+
+struct DrawListItem	// Visible mesh in the state-sorted draw list of a pass
+{
+	uint32     shaderKey, combKey, matKey;  // Shader handle, combination index and material handle
+	uint32     geoKey, distKey;  // Geometry handle and view distance bits
+	ModelNode  *modelNode;
+	MeshNode   *meshNode;
+	uint32     baseVertex, lod;
+};
+
+
+struct MeshDrawState	// Bindings while drawing model meshes
+{
+	ModelNode         *modelNode;
+	GeometryResource  *geoRes;
+	uint32            dynVertBuffer, baseVertex;
+	bool              paletteUsed;  // Skinning uniform contains only joint palette of a mesh
+};
+
+
 struct PipeSamplerBinding
 {
 	char          sampler[64];
@@ -114,6 +159,20 @@ protected:
 	std::vector< PipeSamplerBinding >  _pipeSamplerBindings;
 	std::vector< char >                _occSets;  // Actually bool
 	std::vector< Overlay >             _overlays;
+	std::vector< StaticBatch >         _staticBatches;
+	std::vector< GeometryResource * >  _staticBatchGeos;  // Owned by renderer
+	std::vector< MeshNode * >          _staticBatchedMeshes;
+	std::vector< DynBatchEntry >       _dynBatchQueue;
+	std::vector< char >                _dynBatchData;  // Vertex data for upload
+	std::vector< unsigned short >      _dynBatchIndices;
+	uint32                             _dynBatchVertBuffer, _dynBatchIndexBuffer;
+	std::vector< InstanceEntry >       _instanceQueue;
+	std::vector< float >               _instanceData;  // World and normal matrix of each instance
+	uint32                             _instanceBuffer;
+	std::vector< Vec4f >               _skinPaletteData;  // Skinning data of joint palette
+	std::vector< int >                 _clusterCounts;  // Index ranges of visible clusters of a mesh
+	std::vector< const void * >        _clusterOffsets;
+	std::vector< DrawListItem >        _drawList;
 	
 	uint32                             _frameID;
 	uint32                             _smFBO, _smTex;
@@ -137,27 +196,58 @@ protected:
 		{ return ((MeshNode *)e1.node)->tmpSortValue > ((MeshNode *)e2.node)->tmpSortValue; }
 	static bool meshMaterialOrder( NodeListEntry e1, NodeListEntry e2 )
 		{ return ((MeshNode *)e1.node)->getMaterialRes() < ((MeshNode *)e2.node)->getMaterialRes(); }
+	static bool dynBatchMaterialOrder( const DynBatchEntry &e1, const DynBatchEntry &e2 )
+		{ return e1.node->getMaterialRes() < e2.node->getMaterialRes(); }
+	static bool instanceOrder( const InstanceEntry &e1, const InstanceEntry &e2 )
+	{
+		if( e1.geoRes != e2.geoRes ) return e1.geoRes < e2.geoRes;
+		if( e1.node->getMaterialRes() != e2.node->getMaterialRes() )
+			return e1.node->getMaterialRes() < e2.node->getMaterialRes();
+		if( e1.node->getBatchStart() != e2.node->getBatchStart() )
+			return e1.node->getBatchStart() < e2.node->getBatchStart();
+		return e1.node->getBatchCount() < e2.node->getBatchCount();
+	}
+	static bool drawListOrder( const DrawListItem &e1, const DrawListItem &e2 )
+	{
+		if( e1.shaderKey != e2.shaderKey ) return e1.shaderKey < e2.shaderKey;
+		if( e1.combKey != e2.combKey ) return e1.combKey < e2.combKey;
+		if( e1.matKey != e2.matKey ) return e1.matKey < e2.matKey;
+		if( e1.geoKey != e2.geoKey ) return e1.geoKey < e2.geoKey;
+		return e1.distKey < e2.distKey;
+	}
 	
 	void setupViewMatrices( CameraNode *cam );
 	
-	bool setMaterialRec( MaterialResource *materialRes, const std::string &shaderContext, ShaderResource *shaderRes );
+	bool setMaterialRec( MaterialResource *materialRes, uint32 shaderContext, ShaderResource *shaderRes );
 	
 	void setupShadowMap( bool noShadows );
 	Matrix4f calcLightMat( const Frustum &frustum );
 	void updateShadowMap();
 
-	void drawOverlays( const std::string &shaderContext );
+	void drawOverlays( uint32 shaderContext );
+	static void bindModelVertices( GeometryResource *geoRes, uint32 dynVertBuffer, uint32 baseVertex );
+	static void setupVertexStreams( ShaderCombination *sc );
+	static void setBatchUniforms( ShaderCombination *sc );
+	static void drawDynamicBatches( uint32 shaderContext );
+	static void setInstanceAttribs( ShaderCombination *sc, const float *worldMat, const float *worldNormalMat );
+	static void drawInstances( uint32 shaderContext );
+	static void calcMaterialKey( MaterialResource *matRes, uint32 shaderContext, DrawListItem &item );
+	static void drawModelMesh( MeshDrawState &state, ModelNode *modelNode, MeshNode *meshNode, uint32 baseVertex,
+		uint32 curLod, uint32 shaderContext, uint32 theClass, bool debugView,
+		const Frustum *frust1, const Frustum *frust2, bool coneCulling );
+	static void drawStaticBatches( uint32 shaderContext, uint32 theClass, bool debugView,
+		const Frustum *frust1, const Frustum *frust2 );
 
 	void bindBuffer( RenderBuffer *rb, const std::string &sampler, uint32 bufIndex );
 	void clear( bool depth, bool buf0, bool buf1, bool buf2, bool buf3, float r, float g, float b, float a );
-	void drawFSQuad( Resource *matRes, const std::string &shaderContext );
-	void drawGeometry( const std::string &shaderContext, const std::string &theClass,
+	void drawFSQuad( MaterialResource *matRes, uint32 shaderContext );
+	void drawGeometry( uint32 shaderContext, uint32 theClass,
 	                   RenderingOrder::List order, int occSet );
-	void drawLightGeometry( const std::string shaderContext, const std::string &theClass,
+	void drawLightGeometry( uint32 shaderContext, uint32 theClass,
 	                        bool noShadows, RenderingOrder::List order, int occSet );
-	void drawLightShapes( const std::string shaderContext, bool noShadows, int occSet );
+	void drawLightShapes( uint32 shaderContext, bool noShadows, int occSet );
 	
-	void drawRenderables( const std::string &shaderContext, const std::string &theClass, bool debugView,
+	void drawRenderables( uint32 shaderContext, uint32 theClass, bool debugView,
 		const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
 	
 	void renderDebugView();
@@ -180,7 +270,7 @@ public:
 
 	bool uploadShader( const char *vertexShader, const char *fragmentShader, ShaderCombination &sc );
 	void setShader( ShaderCombination *sc );
-	bool setMaterial( MaterialResource *materialRes, const std::string &shaderContext );
+	bool setMaterial( MaterialResource *materialRes, uint32 shaderContext );
 	
 	bool createShadowBuffer( uint32 width, uint32 height );
 	void destroyShadowBuffer();
@@ -188,12 +278,15 @@ public:
 	void showOverlay( const Overlay &overlay );
 	void clearOverlays();
 	
+	int buildStaticBatches( SceneNode *startNode, float maxCellSize );
+	void clearStaticBatches();
+	
 	void drawAABB( const Vec3f &bbMin, const Vec3f &bbMax );
 	void drawDebugAABB( const Vec3f &bbMin, const Vec3f &bbMax, bool saveStates );
 	
-	static void drawModels( const std::string &shaderContext, const std::string &theClass, bool debugView,
+	static void drawModels( uint32 shaderContext, uint32 theClass, bool debugView,
 		const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
-	static void drawParticles( const std::string &shaderContext, const std::string &theClass, bool debugView,
+	static void drawParticles( uint32 shaderContext, uint32 theClass, bool debugView,
 		const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
 
 	bool render( CameraNode *camNode );
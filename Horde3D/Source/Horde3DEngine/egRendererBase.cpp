@@ -33,6 +33,8 @@ RendererBase::RendererBase()
 {
 	_vpWidth = 320; _vpHeight = 240;
 	_curRendBuf = 0x0; _outputBufferIndex = 0;
+	_stateCaching = false;
+	_stateCallCount = 0; _stateCallFilteredCount = 0;
 }
 
 
@@ -70,12 +72,12 @@ uint32 RendererBase::uploadVertices( void *data, uint32 size, uint32 bufId )
 	if( bufId == 0 )
 	{	
 		glGenBuffers( 1, &bufId );
-		glBindBuffer( GL_ARRAY_BUFFER, bufId );
+		setVertexBuffer( bufId );
 		glBufferData( GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW );
 	}
 	else
 	{
-		glBindBuffer( GL_ARRAY_BUFFER, bufId );
+		setVertexBuffer( bufId );
 		glBufferData( GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW );
 	}
 	
@@ -83,10 +85,22 @@ uint32 RendererBase::uploadVertices( void *data, uint32 size, uint32 bufId )
 }
 
 
-void RendererBase::updateVertices( void *data, uint32 offset, uint32 size, uint32 bufId )
+void RendererBase::updateVertices( void *data, uint32 offset, uint32 size, uint32 bufId, bool orphan )
 {
-	glBindBuffer( GL_ARRAY_BUFFER, bufId );
-	glBufferSubData( GL_ARRAY_BUFFER, offset, size, data );
+	setVertexBuffer( bufId );
+	
+	if( orphan && offset == 0 )
+	{
+		// Respecify the whole storage so that the driver can hand out new memory instead of
+		// waiting for draw calls that still source the old data
+		glBufferData( GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW );
+	}
+	else
+	{
+		glBufferSubData( GL_ARRAY_BUFFER, offset, size, data );
+	}
+
+	Modules::stats().incStat( EngineStats::GeoUploadSize, (float)size );
 }
 
 
@@ -95,12 +109,12 @@ uint32 RendererBase::uploadIndices( void *indices, uint32 size, uint32 bufId )
 	if( bufId == 0 ) 
 	{	
 		glGenBuffers( 1, &bufId );
-		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, bufId );
+		setIndexBuffer( bufId );
 		glBufferData( GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW );
 	}
 	else
 	{
-		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, bufId );
+		setIndexBuffer( bufId );
 		//glBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, size, indices );
 		glBufferData( GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW );
 	}
@@ -113,17 +127,17 @@ void RendererBase::unloadBuffers( uint32 vertBufId, uint32 idxBufId )
 {
 	if( vertBufId != 0 )
 	{
-		glBindBuffer( GL_ARRAY_BUFFER, vertBufId );
+		setVertexBuffer( vertBufId );
 		glBufferData( GL_ARRAY_BUFFER, 0, 0x0, GL_STATIC_DRAW );
-		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		setVertexBuffer( 0 );
 		glDeleteBuffers( 1, &vertBufId );
 	}
 
 	if( idxBufId != 0 )
 	{
-		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, idxBufId );
+		setIndexBuffer( idxBufId );
 		glBufferData( GL_ELEMENT_ARRAY_BUFFER, 0, 0x0, GL_STATIC_DRAW );
-		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+		setIndexBuffer( 0 );
 		glDeleteBuffers( 1, &idxBufId );
 	}
 }
@@ -133,7 +147,7 @@ uint32 RendererBase::cloneVertexBuffer( uint32 vertBufId )
 {
 	int size;
 	
-	glBindBuffer( GL_ARRAY_BUFFER, vertBufId );
+	setVertexBuffer( vertBufId );
 	glGetBufferParameteriv( GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size );
 	char *buffer = new char[size];
 	glGetBufferSubData( GL_ARRAY_BUFFER, 0, size, buffer );
@@ -148,7 +162,7 @@ uint32 RendererBase::cloneIndexBuffer( uint32 idxBufId )
 {
 	int size;
 	
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, idxBufId );
+	setIndexBuffer( idxBufId );
 	glGetBufferParameteriv( GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size );
 	char *buffer = new char[size];
 	glGetBufferSubData( GL_ELEMENT_ARRAY_BUFFER, 0, size, buffer );
@@ -159,6 +173,28 @@ uint32 RendererBase::cloneIndexBuffer( uint32 idxBufId )
 }
 
 
+void RendererBase::readBuffer( uint32 vertBufId, uint32 idxBufId, uint32 offset, uint32 size, void *data )
+{
+	if( vertBufId != 0 )
+	{
+		setVertexBuffer( vertBufId );
+		glGetBufferSubData( GL_ARRAY_BUFFER, offset, size, data );
+	}
+	else
+	{
+		setIndexBuffer( idxBufId );
+		glGetBufferSubData( GL_ELEMENT_ARRAY_BUFFER, offset, size, data );
+	}
+}
+
+
+bool RendererBase::supportsPackedVertices()
+{
+	// Signed 10:10:10:2 vertex attributes
+	return glExt::ARB_vertex_type_2_10_10_10_rev;
+}
+
+
 uint32 RendererBase::calcTexSize( TextureFormats::List format, int width, int height )
 {
 	switch( format )
@@ -194,7 +230,8 @@ uint32 RendererBase::uploadTexture( TextureTypes::List type, void *pixels, int w
 	int target = type == TextureTypes::TexCube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
 	
 	if( texId == 0 ) glGenTextures( 1, &texId );
-	glBindTexture( target, texId );
+	setActiveTexUnit( 0 );
+	setTexture( 0, target, texId );
 	
 	if( genMips ) glTexParameteri( target, GL_GENERATE_MIPMAP, GL_TRUE );
 	if( genMips || mipLevel > 0 )
@@ -264,7 +301,8 @@ uint32 RendererBase::uploadTexture( TextureTypes::List type, void *pixels, int w
 
 void RendererBase::updateTexture2D( unsigned char *pixels, int width, int height, int comps, uint32 texId )
 {
-	glBindTexture( GL_TEXTURE_2D, texId );
+	setActiveTexUnit( 0 );
+	setTexture( 0, GL_TEXTURE_2D, texId );
 	glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE );
 	
 	int format = (comps == 4) ? GL_BGRA : GL_BGR;
@@ -274,31 +312,35 @@ void RendererBase::updateTexture2D( unsigned char *pixels, int width, int height
 
 void RendererBase::unloadTexture( uint32 texId, TextureTypes::List type )
 {
+	setActiveTexUnit( 0 );
+	
 	if( type == TextureTypes::Tex2D )
 	{	
-		glBindTexture( GL_TEXTURE_2D, texId );
+		setTexture( 0, GL_TEXTURE_2D, texId );
 		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, 0x0 );
-		glBindTexture( GL_TEXTURE_2D, 0 );
+		setTexture( 0, GL_TEXTURE_2D, 0 );
 	}
 	else if( type == TextureTypes::TexCube )
 	{	
-		glBindTexture( GL_TEXTURE_CUBE_MAP, texId );
+		setTexture( 0, GL_TEXTURE_CUBE_MAP, texId );
 		glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, 0x0 );
 		glTexImage2D( GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, 0x0 );
 		glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, 0x0 );
 		glTexImage2D( GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, 0x0 );
 		glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, 0x0 );
 		glTexImage2D( GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, 0x0 );
-		glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
+		setTexture( 0, GL_TEXTURE_CUBE_MAP, 0 );
 	}
 	
 	glDeleteTextures( 1, &texId );
+	releaseCachedTexture( texId );
 }
 
 
 float *RendererBase::downloadTexture2DData( uint32 texId, int *width, int *height )
 {
-	glBindTexture( GL_TEXTURE_2D, texId );
+	setActiveTexUnit( 0 );
+	setTexture( 0, GL_TEXTURE_2D, texId );
 	glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, width );
 	glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, height );
 	
@@ -410,6 +452,9 @@ uint32 RendererBase::uploadShader( const char *vertexShader, const char *fragmen
 void RendererBase::unloadShader( uint32 shaderId )
 {
 	glDeleteProgram( shaderId );
+	
+	// Deletion is deferred while the program is in use, so its binding is not known anymore
+	if( _stateCache.program == shaderId ) _stateCache.program = StateCache::Unknown;
 }
 
 
@@ -494,7 +539,8 @@ RenderBuffer RendererBase::createRenderBuffer( uint32 width, uint32 height,
 			{
 				// Create a color texture
 				glGenTextures( 1, &rb.colBufs[j] );
-				glBindTexture( GL_TEXTURE_2D, rb.colBufs[j] );
+				setActiveTexUnit( 0 );
+				setTexture( 0, GL_TEXTURE_2D, rb.colBufs[j] );
 				glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE );
 				glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
 				glTexImage2D( GL_TEXTURE_2D, 0, glFormat, rb.width, rb.height, 0, GL_RGBA, GL_FLOAT, 0x0 );
@@ -528,7 +574,8 @@ RenderBuffer RendererBase::createRenderBuffer( uint32 width, uint32 height,
 		{
 			// Create a depth texture
 			glGenTextures( 1, &rb.depthBuf );
-			glBindTexture( GL_TEXTURE_2D, rb.depthBuf );
+			setActiveTexUnit( 0 );
+			setTexture( 0, GL_TEXTURE_2D, rb.depthBuf );
 			glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE );
 			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
 			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE );
@@ -566,6 +613,7 @@ void RendererBase::destroyRenderBuffer( RenderBuffer &rb )
 		else
 		{
 			glDeleteTextures( 1, &rb.depthBuf );
+			releaseCachedTexture( rb.depthBuf );
 		}
 		rb.depthBuf = 0;
 	}
@@ -578,7 +626,11 @@ void RendererBase::destroyRenderBuffer( RenderBuffer &rb )
 		}
 		else
 		{
-			if( rb.colBufs[i] != 0 ) glDeleteTextures( 1, &rb.colBufs[i] );
+			if( rb.colBufs[i] != 0 )
+			{
+				glDeleteTextures( 1, &rb.colBufs[i] );
+				releaseCachedTexture( rb.colBufs[i] );
+			}
 		}
 		rb.colBufs[i] = 0;
 	}
@@ -729,3 +781,232 @@ uint32 RendererBase::getOccQueryResult( uint32 queryId )
 	glGetQueryObjectuiv( queryId, GL_QUERY_RESULT, &samples );
 	return samples;
 }
+
+
+void RendererBase::setCapability( uint32 cap, uint32 &cachedState, bool enabled )
+{
+	if( cachedState == (uint32)enabled )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	if( enabled ) glEnable( cap );
+	else glDisable( cap );
+	if( _stateCaching ) cachedState = (uint32)enabled;
+	++_stateCallCount;
+}
+
+
+void RendererBase::releaseCachedTexture( uint32 texId )
+{
+	// Deleting a texture reverts all units it was bound to back to the default texture
+	for( uint32 i = 0; i < StateCache::MaxTexUnits; ++i )
+	{
+		if( _stateCache.tex2D[i] == texId ) _stateCache.tex2D[i] = 0;
+		if( _stateCache.texCube[i] == texId ) _stateCache.texCube[i] = 0;
+	}
+}
+
+
+void RendererBase::beginStateCaching()
+{
+	// The application may have changed GL states between frames
+	_stateCache.invalidate();
+	_stateCaching = true;
+}
+
+
+void RendererBase::endStateCaching()
+{
+	_stateCache.invalidate();
+	_stateCaching = false;
+
+	Modules::stats().incStat( EngineStats::StateCallCount, (float)_stateCallCount );
+	Modules::stats().incStat( EngineStats::StateCallFilteredCount, (float)_stateCallFilteredCount );
+	_stateCallCount = 0; _stateCallFilteredCount = 0;
+}
+
+
+void RendererBase::setBlending( bool enabled )
+{
+	setCapability( GL_BLEND, _stateCache.blend, enabled );
+}
+
+
+void RendererBase::setBlendFunc( uint32 srcFactor, uint32 dstFactor )
+{
+	if( _stateCache.blendSrc == srcFactor && _stateCache.blendDst == dstFactor )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glBlendFunc( srcFactor, dstFactor );
+	if( _stateCaching )
+	{
+		_stateCache.blendSrc = srcFactor;
+		_stateCache.blendDst = dstFactor;
+	}
+	++_stateCallCount;
+}
+
+
+void RendererBase::setDepthTest( bool enabled )
+{
+	setCapability( GL_DEPTH_TEST, _stateCache.depthTest, enabled );
+}
+
+
+void RendererBase::setDepthFunc( uint32 func )
+{
+	if( _stateCache.depthFunc == func )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glDepthFunc( func );
+	if( _stateCaching ) _stateCache.depthFunc = func;
+	++_stateCallCount;
+}
+
+
+void RendererBase::setDepthMask( bool enabled )
+{
+	if( _stateCache.depthMask == (uint32)enabled )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glDepthMask( enabled ? GL_TRUE : GL_FALSE );
+	if( _stateCaching ) _stateCache.depthMask = (uint32)enabled;
+	++_stateCallCount;
+}
+
+
+void RendererBase::setCulling( bool enabled )
+{
+	setCapability( GL_CULL_FACE, _stateCache.cullFace, enabled );
+}
+
+
+void RendererBase::setColorMask( bool enabled )
+{
+	if( _stateCache.colorMask == (uint32)enabled )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+	glColorMask( mask, mask, mask, mask );
+	if( _stateCaching ) _stateCache.colorMask = (uint32)enabled;
+	++_stateCallCount;
+}
+
+
+void RendererBase::setAlphaTest( bool enabled )
+{
+	setCapability( GL_ALPHA_TEST, _stateCache.alphaTest, enabled );
+}
+
+
+void RendererBase::setAlphaFunc( uint32 func, float ref )
+{
+	if( _stateCache.alphaFunc == func && _stateCache.alphaRef == ref )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glAlphaFunc( func, ref );
+	if( _stateCaching )
+	{
+		_stateCache.alphaFunc = func;
+		_stateCache.alphaRef = ref;
+	}
+	++_stateCallCount;
+}
+
+
+void RendererBase::setAlphaToCoverage( bool enabled )
+{
+	setCapability( GL_SAMPLE_ALPHA_TO_COVERAGE, _stateCache.alphaToCoverage, enabled );
+}
+
+
+void RendererBase::setActiveTexUnit( uint32 unit )
+{
+	if( _stateCache.activeTexUnit == unit )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glActiveTexture( GL_TEXTURE0 + unit );
+	if( _stateCaching ) _stateCache.activeTexUnit = unit;
+	++_stateCallCount;
+}
+
+
+void RendererBase::setTexture( uint32 unit, uint32 target, uint32 texObj )
+{
+	uint32 *cachedTex = 0x0;
+	if( unit < StateCache::MaxTexUnits )
+		cachedTex = target == GL_TEXTURE_CUBE_MAP ? &_stateCache.texCube[unit] : &_stateCache.tex2D[unit];
+	
+	if( cachedTex != 0x0 && *cachedTex == texObj )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	setActiveTexUnit( unit );
+	glBindTexture( target, texObj );
+	if( _stateCaching && cachedTex != 0x0 ) *cachedTex = texObj;
+	++_stateCallCount;
+}
+
+
+void RendererBase::setVertexBuffer( uint32 bufObj )
+{
+	if( _stateCache.vertexBuffer == bufObj )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, bufObj );
+	if( _stateCaching ) _stateCache.vertexBuffer = bufObj;
+	++_stateCallCount;
+}
+
+
+void RendererBase::setIndexBuffer( uint32 bufObj )
+{
+	if( _stateCache.indexBuffer == bufObj )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, bufObj );
+	if( _stateCaching ) _stateCache.indexBuffer = bufObj;
+	++_stateCallCount;
+}
+
+
+void RendererBase::setProgram( uint32 progObj )
+{
+	if( _stateCache.program == progObj )
+	{
+		++_stateCallFilteredCount;
+		return;
+	}
+
+	glUseProgram( progObj );
+	if( _stateCaching ) _stateCache.program = progObj;
+	++_stateCallCount;
+}
@@ -94,6 +94,40 @@ struct TextureTypes
 	};
 };
 
+struct StateCache
+{
+	static const uint32 MaxTexUnits = 16;
+	static const uint32 Unknown = 0xFFFFFFFF;  // State has to be set regardless of its value
+	
+	uint32  blend, blendSrc, blendDst;
+	uint32  depthTest, depthFunc, depthMask;
+	uint32  cullFace, colorMask;
+	uint32  alphaTest, alphaFunc, alphaToCoverage;
+	float   alphaRef;
+	uint32  activeTexUnit;
+	uint32  tex2D[MaxTexUnits], texCube[MaxTexUnits];
+	uint32  vertexBuffer, indexBuffer;
+	uint32  program;
+
+	StateCache() { invalidate(); }
+	
+	void invalidate()
+	{
+		blend = Unknown; blendSrc = Unknown; blendDst = Unknown;
+		depthTest = Unknown; depthFunc = Unknown; depthMask = Unknown;
+		cullFace = Unknown; colorMask = Unknown;
+		alphaTest = Unknown; alphaFunc = Unknown; alphaToCoverage = Unknown;
+		alphaRef = 0;
+		activeTexUnit = Unknown;
+		for( uint32 i = 0; i < MaxTexUnits; ++i )
+		{
+			tex2D[i] = Unknown; texCube[i] = Unknown;
+		}
+		vertexBuffer = Unknown; indexBuffer = Unknown;
+		program = Unknown;
+	}
+};
+
 // =================================================================================================
 
 class RendererBase
@@ -106,12 +140,19 @@ protected:
 	RenderBuffer  *_curRendBuf;
 	int           _outputBufferIndex;  // Left and right eye for stereo rendering
 
+	StateCache    _stateCache;
+	bool          _stateCaching;  // Redundant state changes are only filtered while rendering a frame
+	uint32        _stateCallCount, _stateCallFilteredCount;
+
 
 	void myPerspective( float fovy, float aspect, float zNear, float zFar );
 	
 	uint32 loadShader( const char *vertexShader, const char *fragmentShader );
 	bool linkShader( uint32 shaderId );
 
+	void setCapability( uint32 cap, uint32 &cachedState, bool enabled );
+	void releaseCachedTexture( uint32 texId );
+
 public:
 	
 	RendererBase();
@@ -123,11 +164,13 @@ public:
 	
 	// Vertex buffer functions
 	uint32 uploadVertices( void *data, uint32 size, uint32 bufId = 0 );
-	void updateVertices( void *data, uint32 offset, uint32 size, uint32 bufId );
+	void updateVertices( void *data, uint32 offset, uint32 size, uint32 bufId, bool orphan = false );
 	uint32 uploadIndices( void *indices, uint32 size, uint32 bufId = 0 );
 	void unloadBuffers( uint32 vertBufId, uint32 idxBufId );
 	uint32 cloneVertexBuffer( uint32 vertBufId );
 	uint32 cloneIndexBuffer( uint32 idxBufId );
+	void readBuffer( uint32 vertBufId, uint32 idxBufId, uint32 offset, uint32 size, void *data );
+	bool supportsPackedVertices();
 
 	// Texture map functions
 	uint32 calcTexSize( TextureFormats::List format, int width, int height );
@@ -159,6 +202,27 @@ public:
 	void beginOccQuery( uint32 queryId );
 	void endOccQuery( uint32 queryId );
 	uint32 getOccQueryResult( uint32 queryId );
+
+	// Cached state functions
+	// Note: Texture parameters apply to the active unit which setTexture does not change when
+	//       the binding is redundant, so call setActiveTexUnit before modifying a bound texture
+	void beginStateCaching();
+	void endStateCaching();
+	void setBlending( bool enabled );
+	void setBlendFunc( uint32 srcFactor, uint32 dstFactor );
+	void setDepthTest( bool enabled );
+	void setDepthFunc( uint32 func );
+	void setDepthMask( bool enabled );
+	void setCulling( bool enabled );
+	void setColorMask( bool enabled );
+	void setAlphaTest( bool enabled );
+	void setAlphaFunc( uint32 func, float ref );
+	void setAlphaToCoverage( bool enabled );
+	void setActiveTexUnit( uint32 unit );
+	void setTexture( uint32 unit, uint32 target, uint32 texObj );
+	void setVertexBuffer( uint32 bufObj );
+	void setIndexBuffer( uint32 bufObj );
+	void setProgram( uint32 progObj );
 };
 
 #endif // _egRendererBase_H_
@@ -58,7 +58,8 @@ struct ResourceFlags
 	{
 		NoQuery = 1,
 		NoTexCompression = 2,
-		NoTexMipmaps = 4
+		NoTexMipmaps = 4,
+		NoGeoCPUCopy = 8
 	};
 };
 
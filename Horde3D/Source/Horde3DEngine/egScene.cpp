@@ -41,7 +41,7 @@ using namespace std;
 
 SceneNode::SceneNode( const SceneNodeTpl &tpl ) :
 	_type( tpl.type ), _parent( 0x0 ), _handle( 0 ), _sgHandle( 0 ),
-	_dirty( true ), _transformed( true ), _renderable( false ), _active( true ),
+	_dirty( true ), _transformed( true ), _renderable( false ), _active( true ), _playback( false ),
 	_name( tpl.name ), _attachment( tpl.attachmentString )
 {
 	setTransform( tpl.trans, tpl.rot, tpl.scale );
@@ -55,7 +55,11 @@ SceneNode::~SceneNode()
 
 void SceneNode::setActivation( bool active )
 {
-	_active = active;
+	if( _active != active )
+	{
+		_active = active;
+		onActivationChanged();
+	}
 	
 	// Set same activation state for children
 	for( size_t i = 0, s = _children.size(); i < s; ++i )
@@ -306,6 +310,17 @@ void SceneNode::onDetach( SceneNode &/*parentNode*/ )
 }
 
 
+bool SceneNode::onAdvanceTime( float /*timeDelta*/ )
+{
+	return false;
+}
+
+
+void SceneNode::onActivationChanged()
+{
+}
+
+
 
 // *************************************************************************************************
 // Class GroupNode
@@ -508,6 +523,63 @@ void SceneManager::updateNodes()
 }
 
 
+bool SceneManager::markQueuedModelsVisible( uint32 frameID, const Vec3f &camPos )
+{
+	bool catchUp = false;
+	
+	// Record visibility of models for animation and skinning LOD and mark models
+	// that need to be updated before they are drawn
+	vector< RendQueueEntry > &queue = getRenderableQueue();
+	for( size_t i = 0, s = queue.size(); i < s; ++i )
+	{
+		if( queue[i].type != SceneNodeTypes::Model ) continue;
+
+		ModelNode *modelNode = (ModelNode *)queue[i].node;
+		if( modelNode->_visibleFrame == frameID ) continue;
+		modelNode->_visibleFrame = frameID;
+		modelNode->_viewDist = (Vec3f( modelNode->_absTrans.c[3][0], modelNode->_absTrans.c[3][1],
+		                               modelNode->_absTrans.c[3][2] ) - camPos).length();
+		
+		if( modelNode->checkSkinLodChanged() )
+		{
+			modelNode->_skinningDirty = true;  // Reskin with influences of new LOD
+			modelNode->markDirty();
+			catchUp = true;
+		}
+		if( modelNode->checkAnimPending() )
+		{
+			modelNode->markDirty();
+			catchUp = true;
+		}
+	}
+
+	return catchUp;
+}
+
+
+void SceneManager::updateAnimLod( const Frustum &frustum, const Vec3f &camPos )
+{
+	uint32 frameID = Modules::renderer().getFrameID();
+	
+	// Models in the view are drawn in this frame
+	updateQueues( frustum, 0x0, RenderingOrder::None, true, true );
+	bool catchUp = markQueuedModelsVisible( frameID, camPos );
+
+	// Shadow maps of visible lights contain all models in the light frustum
+	vector< SceneNode * > &lights = getLightQueue();
+	for( size_t i = 0, s = lights.size(); i < s; ++i )
+	{
+		LightNode *light = (LightNode *)lights[i];
+		if( light->_shadowMapCount == 0 || frustum.cullFrustum( light->getFrustum() ) ) continue;
+
+		updateQueues( light->getFrustum(), 0x0, RenderingOrder::None, false, true );
+		if( markQueuedModelsVisible( frameID, camPos ) ) catchUp = true;
+	}
+
+	if( catchUp ) updateNodes();
+}
+
+
 void SceneManager::updateQueues( const Frustum &frustum1, const Frustum *frustum2,
 								 RenderingOrder::List order, bool lightQueue, bool renderableQueue )
 {
@@ -545,7 +617,11 @@ NodeHandle SceneManager::parseNode( SceneNodeTpl &tpl, SceneNode *parent )
 	// Parse children
 	for( uint32 i = 0; i < tpl.children.size(); ++i )
 	{
-		parseNode( *tpl.children[i], sn );
+		// Joints of models are stored in a flat skeleton and only get scene nodes on demand
+		if( sn->_type == SceneNodeTypes::Model && tpl.children[i]->type == SceneNodeTypes::Joint )
+			((ModelNode *)sn)->addSkeletonJointsRec( *(JointNodeTpl *)tpl.children[i], (uint32)-1, 1 );
+		else
+			parseNode( *tpl.children[i], sn );
 	}
 
 	return sn->getHandle();
@@ -621,6 +697,18 @@ void SceneManager::removeNodeRec( SceneNode *node )
 	// Delete node
 	if( handle != RootNode )
 	{
+		if( node->_playback )
+		{
+			for( uint32 i = 0; i < _playbackNodes.size(); ++i )
+			{
+				if( _playbackNodes[i] == node )
+				{
+					_playbackNodes.erase( _playbackNodes.begin() + i );
+					break;
+				}
+			}
+		}
+		
 		_spatialGraph->removeNode( node->_sgHandle );
 		delete _nodes[handle - 1]; _nodes[handle - 1] = 0x0;
 		_freeList.push_back( handle - 1 );
@@ -715,6 +803,13 @@ bool SceneManager::relocateNode( NodeHandle node, NodeHandle parent )
 int SceneManager::findNodes( SceneNode *startNode, const string &name, int type )
 {
 	int count = 0;
+
+	// Create nodes for matching skeleton joints so that they can be returned
+	if( startNode->_type == SceneNodeTypes::Model &&
+	    (type == SceneNodeTypes::Undefined || type == SceneNodeTypes::Joint) )
+	{
+		((ModelNode *)startNode)->createJointNodes( name );
+	}
 	
 	if( type == SceneNodeTypes::Undefined || startNode->_type == type )
 	{
@@ -734,14 +829,55 @@ int SceneManager::findNodes( SceneNode *startNode, const string &name, int type
 }
 
 
+void SceneManager::addPlaybackNode( SceneNode &node )
+{
+	if( node._playback ) return;
+
+	node._playback = true;
+	_playbackNodes.push_back( &node );
+}
+
+
+void SceneManager::advanceTime( float timeDelta )
+{
+	for( uint32 i = 0; i < _playbackNodes.size(); )
+	{
+		SceneNode *node = _playbackNodes[i];
+		
+		if( node->onAdvanceTime( timeDelta ) )
+		{
+			++i;
+		}
+		else
+		{
+			// Node has finished playback
+			node->_playback = false;
+			_playbackNodes[i] = _playbackNodes.back();
+			_playbackNodes.pop_back();
+		}
+	}
+}
+
+
 void SceneManager::castRayInternal( SceneNode *node )
 {
 	if( !node->_active ) return;
 	
 	if( rayAABBIntersection( _rayOrigin, _rayDirection, node->_bBox.getMinCoords(), node->_bBox.getMaxCoords() ) )
 	{
+		// Remember geometry whose CPU copy is read back for the triangle test
+		GeometryResource *geoRes = 0x0;
+		if( node->_type == SceneNodeTypes::Mesh && ((MeshNode *)node)->getParentModel() != 0x0 )
+		{
+			geoRes = ((MeshNode *)node)->getParentModel()->getGeometryResource();
+			if( geoRes != 0x0 && geoRes->hasCPUData() ) geoRes = 0x0;
+		}
+		
 		Vec3f intsPos;
-		if( node->checkIntersection( _rayOrigin, _rayDirection, intsPos ) )
+		bool intersection = node->checkIntersection( _rayOrigin, _rayDirection, intsPos );
+		if( geoRes != 0x0 && geoRes->hasCPUData() ) _rayRestoredGeos.push_back( geoRes );
+		
+		if( intersection )
 		{
 			float dist = (intsPos - _rayOrigin).length();
 
@@ -792,6 +928,10 @@ int SceneManager::castRay( SceneNode *node, const Vec3f &rayOrig, const Vec3f &r
 
 	castRayInternal( node );
 
+	// GPU-only geometry drops the copies again, so that ray casts don't keep them in memory
+	for( size_t i = 0; i < _rayRestoredGeos.size(); ++i ) _rayRestoredGeos[i]->releaseCPUData();
+	_rayRestoredGeos.resize( 0 );
+
 	return (int)_castRayResults.size();
 }
 
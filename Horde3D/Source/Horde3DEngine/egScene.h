@@ -36,6 +36,7 @@
 struct SceneNodeTpl;
 class CameraNode;
 class SceneGraphResource;
+class GeometryResource;
 
 const int RootNode = 1;
 
@@ -104,6 +105,7 @@ protected:
 	bool                        _transformed;
 	bool                        _renderable;
 	bool                        _active;
+	bool                        _playback;  // Node is advanced by engine playback
 
 	BoundingBox                 _bBox;  // AABB in world space
 
@@ -118,6 +120,8 @@ protected:
 	virtual void onFinishedUpdate();  // Called after children have been updated
 	virtual void onAttach( SceneNode &parentNode );	// Called when node is attached to parent
 	virtual void onDetach( SceneNode &parentNode );	// Called when node is detached from parent
+	virtual bool onAdvanceTime( float timeDelta );	// Called for engine playback; false stops playback
+	virtual void onActivationChanged();	// Called after activation state has changed
 
 public:
 
@@ -246,7 +250,7 @@ public:
 
 typedef SceneNodeTpl *(*NodeTypeParsingFunc)( std::map< std::string, std::string > &attribs );
 typedef SceneNode *(*NodeTypeFactoryFunc)( const SceneNodeTpl &tpl );
-typedef void (*NodeTypeRenderFunc)( const std::string &shaderContext, const std::string &theClass, bool debugView,
+typedef void (*NodeTypeRenderFunc)( uint32 shaderContext, uint32 theClass, bool debugView,
                                     const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
                                     int occSet );
 
@@ -275,6 +279,7 @@ protected:
 	std::vector< uint32 >          _freeList;  // List of free slots
 	std::vector< SceneNode * >     _findResults;
 	std::vector< CastRayResult >   _castRayResults;
+	std::vector< SceneNode * >     _playbackNodes;  // Nodes advanced by engine playback
 	SpatialGraph                   *_spatialGraph;
 
 	std::map< int, NodeRegEntry >  _registry;  // Registry of node types
@@ -282,11 +287,13 @@ protected:
 	Vec3f                          _rayOrigin;  // Don't put these values on the stack during recursive search
 	Vec3f                          _rayDirection;  // Ditto
 	int                            _rayNum;  // Ditto
+	std::vector< GeometryResource * >  _rayRestoredGeos;  // Geometry read back from the GPU for the current ray
 
 	NodeHandle parseNode( SceneNodeTpl &tpl, SceneNode *parent );
 	void removeNodeRec( SceneNode *node );
 
 	void castRayInternal( SceneNode *node );
+	bool markQueuedModelsVisible( uint32 frameID, const Vec3f &camPos );
 public:
 
 	SceneManager();
@@ -298,6 +305,7 @@ public:
 	NodeRegEntry *findType( const std::string &typeString );
 	
 	void updateNodes();
+	void updateAnimLod( const Frustum &frustum, const Vec3f &camPos );
 	void updateSpatialNode( uint32 sgHandle ) { _spatialGraph->updateNode( sgHandle ); }
 	void updateQueues( const Frustum &frustum1, const Frustum *frustum2,
 	                   RenderingOrder::List order, bool lightQueue, bool renderableQueue );
@@ -311,6 +319,9 @@ public:
 	void clearFindResults() { _findResults.resize( 0 ); }
 	SceneNode *getFindResult( int index ) { return (unsigned)index < _findResults.size() ? _findResults[index] : 0x0; }
 	
+	void addPlaybackNode( SceneNode &node );
+	void advanceTime( float timeDelta );
+	
 	int castRay( SceneNode *node, const Vec3f &rayOrig, const Vec3f &rayDir, int numNearest );
 	bool getCastRayResult( int index, CastRayResult &crr );
 
@@ -325,6 +336,7 @@ public:
 		{ return (handle != 0 && (unsigned)(handle - 1) < _nodes.size()) ? _nodes[handle - 1] : 0x0; }
 
 	friend class Renderer;
+	friend class ModelNode;
 };
 
 #endif // _egScene_H_
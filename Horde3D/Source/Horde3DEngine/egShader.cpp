@@ -273,6 +273,8 @@ string ShaderResource::_vertPreamble = "";
 string ShaderResource::_fragPreamble = "";
 string ShaderResource::_tmpCode0 = "";
 string ShaderResource::_tmpCode1 = "";
+uint32 ShaderResource::_compileCount = 0;
+vector< string > ShaderResource::_contextNames( 1 );
 
 
 ShaderResource::ShaderResource( const string &name, int flags ) :
@@ -381,6 +383,7 @@ bool ShaderResource::parseFXSection( const char *data )
 		ShaderContext context;
 
 		context.id = node1.getAttribute( "id" );
+		context.nameID = getContextID( context.id );
 		
 		// Config
 		XMLNode node2 = node1.getChildNode( "RenderConfig" );
@@ -441,6 +444,13 @@ bool ShaderResource::parseFXSection( const char *data )
 				context.alphaToCoverage = true;
 			else
 				context.alphaToCoverage = false;
+
+			// Instancing
+			if( _stricmp( node2.getAttribute( "instancing", "false" ), "true" ) == 0 ||
+				_stricmp( node2.getAttribute( "instancing", "0" ), "1" ) == 0 )
+				context.instancing = true;
+			else
+				context.instancing = false;
 		}
 		
 		// Shaders
@@ -658,6 +668,9 @@ void ShaderResource::compileCombination( ShaderContext &context, ShaderCombinati
 		_tmpCode1 += "// ---------------\r\n";
 	}
 
+	// Instanced contexts read the world transformation from vertex attributes
+	if( context.instancing ) _tmpCode0 += "#define _INSTANCING_\r\n";
+
 	// Add actual shader code
 	_tmpCode0 += context.vertCode->assembleCode();
 	_tmpCode1 += context.fragCode->assembleCode();
@@ -689,7 +702,11 @@ void ShaderResource::compileCombination( ShaderContext &context, ShaderCombinati
 		}
 	}
 
+	// Locations change with every compilation, so material bindings have to be rebuilt
+	sc.compileStamp = ++_compileCount;
+	
 	// Find samplers in compiled shader
+	sc.customSamplers.resize( 0 );
 	sc.customSamplers.reserve( _samplers.size() );
 	for( uint32 i = 0; i < _samplers.size(); ++i )
 	{
@@ -701,6 +718,7 @@ void ShaderResource::compileCombination( ShaderContext &context, ShaderCombinati
 	}
 	
 	// Find uniforms in compiled shader
+	sc.customUniforms.resize( 0 );
 	sc.customUniforms.reserve( _uniforms.size() );
 	for( uint32 i = 0; i < _uniforms.size(); ++i )
 	{
@@ -805,3 +823,13 @@ uint32 ShaderResource::calcCombMask( const std::vector< std::string > &flags )
 	
 	return combMask;
 }
+
+
+uint32 ShaderResource::getContextID( const string &name )
+{
+	for( uint32 i = 0; i < _contextNames.size(); ++i )
+		if( _contextNames[i] == name ) return i;
+
+	_contextNames.push_back( name );
+	return (uint32)_contextNames.size() - 1;
+}
@@ -129,6 +129,7 @@ struct ShaderCombination
 	
 	uint32                          shaderObject;
 	uint32                          lastUpdateStamp;
+	uint32                          compileStamp;  // Unique for each compilation, identifies material bindings
 
 	// Engine uniform and attribute locations
 	int                             uni_frameBufSize;
@@ -138,20 +139,21 @@ struct ShaderCombination
 	int                             uni_lightPos, uni_lightDir, uni_lightColor, uni_lightCosCutoff;
 	int                             uni_shadowSplitDists, uni_shadowMats;
 	int                             uni_shadowMapSize, uni_shadowBias;
-	int                             uni_skinMatRows;
+	int                             uni_skinMatRows, uni_skinDualQuats, uni_skinInfluences;
 	int                             uni_parCorners;
 	int                             uni_parPosArray, uni_parSizeAndRotArray, uni_parColorArray;
 	int                             uni_olayColor;
 	int                             attrib_normal, attrib_tangent, attrib_bitangent;
 	int                             attrib_joints, attrib_weights;
 	int                             attrib_texCoords0, attrib_texCoords1;
+	int                             attrib_instWorldMat, attrib_instWorldNormalMat;
 
 	std::vector< int >              customSamplers;
 	std::vector< int >              customUniforms;
 
 
 	ShaderCombination() :
-		combMask( 0 ), shaderObject( 0 ), lastUpdateStamp( 0 )
+		combMask( 0 ), shaderObject( 0 ), lastUpdateStamp( 0 ), compileStamp( 0 )
 	{
 	}
 };
@@ -160,6 +162,7 @@ struct ShaderCombination
 struct ShaderContext
 {
 	std::string                       id;
+	uint32                            nameID;  // Interned id for fast lookup
 	uint32                            flagMask;
 	
 	// RenderConfig
@@ -169,6 +172,7 @@ struct ShaderContext
 	float                             alphaRef;
 	bool                              writeDepth;
 	bool                              alphaToCoverage;
+	bool                              instancing;  // Meshes are drawn with per-instance transformations
 	
 	// Shaders
 	std::vector< ShaderCombination >  shaderCombs;
@@ -177,9 +181,9 @@ struct ShaderContext
 
 
 	ShaderContext() :
-		compiled( false ), writeDepth( true ), blendMode( BlendModes::Replace ),
+		nameID( 0 ), compiled( false ), writeDepth( true ), blendMode( BlendModes::Replace ),
 		depthTest( TestModes::LessEqual ), alphaTest( TestModes::Always ),
-		alphaRef( 0.0f ), alphaToCoverage( false )
+		alphaRef( 0.0f ), alphaToCoverage( false ), instancing( false )
 	{
 	}
 
@@ -220,6 +224,8 @@ private:
 	
 	static std::string            _vertPreamble, _fragPreamble;
 	static std::string            _tmpCode0, _tmpCode1;
+	static uint32                 _compileCount;
+	static std::vector< std::string >  _contextNames;  // Interned context names, 0 is empty name
 	
 	std::vector< ShaderContext >  _contexts;
 	std::vector< ShaderSampler >  _samplers;
@@ -240,6 +246,7 @@ public:
 		{ _vertPreamble = vertPreamble; _fragPreamble = fragPreamble; }
 
 	static uint32 calcCombMask( const std::vector< std::string > &flags );
+	static uint32 getContextID( const std::string &name );
 	
 	ShaderResource( const std::string &name, int flags );
 	~ShaderResource();
@@ -251,10 +258,10 @@ public:
 	void compileContexts();
 	ShaderCombination *getCombination( ShaderContext &context, uint32 combMask );
 
-	ShaderContext *findContext( const std::string &name )
+	ShaderContext *findContext( uint32 nameID )
 	{
 		for( uint32 i = 0; i < _contexts.size(); ++i )
-			if( _contexts[i].id == name ) return &_contexts[i];
+			if( _contexts[i].nameID == nameID ) return &_contexts[i];
 		
 		return 0x0;
 	}
@@ -262,6 +269,7 @@ public:
 	std::vector< ShaderContext > &getContexts() { return _contexts; }
 
 	friend class Renderer;
+	friend class MaterialResource;
 };
 
 typedef SmartResPtr< ShaderResource > PShaderResource;
@@ -37,6 +37,8 @@ namespace glExt
 	bool EXT_texture_compression_s3tc = false;
 	bool ARB_texture_float = false;
 	bool ARB_texture_non_power_of_two = false;
+	bool ARB_instanced_arrays = false;
+	bool ARB_vertex_type_2_10_10_10_rev = false;
 
 	int	majorVersion = 1, minorVersion = 1;
 }
@@ -335,6 +337,14 @@ PFNGLBLITFRAMEBUFFEREXTPROC glBlitFramebufferEXT = 0x0;
 PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC glRenderbufferStorageMultisampleEXT = 0x0;
 
 
+// GL_ARB_draw_instanced
+PFNGLDRAWELEMENTSINSTANCEDARBPROC glDrawElementsInstancedARB = 0x0;
+
+
+// GL_ARB_instanced_arrays
+PFNGLVERTEXATTRIBDIVISORARBPROC glVertexAttribDivisorARB = 0x0;
+
+
 bool isExtensionSupported( string extString )
 {
 	size_t pos = 0;
@@ -700,5 +710,19 @@ bool initOpenGLExtensions()
 		r &= (glRenderbufferStorageMultisampleEXT = (PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC) platGetProcAddress( "glRenderbufferStorageMultisampleEXT" )) != 0x0;
 	}
 
+	glExt::ARB_instanced_arrays = isExtensionSupported( "GL_ARB_instanced_arrays" ) &&
+								  isExtensionSupported( "GL_ARB_draw_instanced" );
+	if( glExt::ARB_instanced_arrays )
+	{
+		// From GL_ARB_draw_instanced
+		r &= (glDrawElementsInstancedARB = (PFNGLDRAWELEMENTSINSTANCEDARBPROC) platGetProcAddress( "glDrawElementsInstancedARB" )) != 0x0;
+		// From GL_ARB_instanced_arrays
+		r &= (glVertexAttribDivisorARB = (PFNGLVERTEXATTRIBDIVISORARBPROC) platGetProcAddress( "glVertexAttribDivisorARB" )) != 0x0;
+	}
+
+	// Core since OpenGL 3.3
+	glExt::ARB_vertex_type_2_10_10_10_rev = isExtensionSupported( "GL_ARB_vertex_type_2_10_10_10_rev" ) ||
+		glExt::majorVersion > 3 || (glExt::majorVersion == 3 && glExt::minorVersion >= 3);
+
 	return r;
 }
@@ -63,6 +63,8 @@ namespace glExt
     extern bool EXT_texture_compression_s3tc;
     extern bool ARB_texture_float;
     extern bool ARB_texture_non_power_of_two;
+    extern bool ARB_instanced_arrays;
+    extern bool ARB_vertex_type_2_10_10_10_rev;
 
     extern int  majorVersion, minorVersion;
 }
@@ -2054,6 +2056,39 @@ typedef void (GLAPIENTRYP PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC) (GLenum ta
 
 extern PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC glRenderbufferStorageMultisampleEXT;
 
+
+// ARB_draw_instanced
+#ifndef GL_ARB_draw_instanced
+#define GL_ARB_draw_instanced 1
+
+typedef void (GLAPIENTRYP PFNGLDRAWELEMENTSINSTANCEDARBPROC) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei primcount);
+
+#endif
+
+extern PFNGLDRAWELEMENTSINSTANCEDARBPROC glDrawElementsInstancedARB;
+
+
+// ARB_instanced_arrays
+#ifndef GL_ARB_instanced_arrays
+#define GL_ARB_instanced_arrays 1
+
+#define GL_VERTEX_ATTRIB_ARRAY_DIVISOR_ARB  0x88FE
+
+typedef void (GLAPIENTRYP PFNGLVERTEXATTRIBDIVISORARBPROC) (GLuint index, GLuint divisor);
+
+#endif
+
+extern PFNGLVERTEXATTRIBDIVISORARBPROC glVertexAttribDivisorARB;
+
+
+// ARB_vertex_type_2_10_10_10_rev
+#ifndef GL_ARB_vertex_type_2_10_10_10_rev
+#define GL_ARB_vertex_type_2_10_10_10_rev 1
+
+#define GL_INT_2_10_10_10_REV             0x8D9F
+
+#endif
+
 }   // extern "C"
 
 #endif // _utOpenGL_H_
@@ -947,6 +947,38 @@ inline bool rayAABBIntersection( const Vec3f &rayOrig, const Vec3f &rayDir,
 }
 
 
+inline bool rayAABBIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, 
+                                 const Vec3f &mins, const Vec3f &maxs, float &t )
+{
+	// Slab test that also returns the entry point as fraction of the ray length
+	// (0 if the ray origin is inside the box)
+	
+	const float orig[3] = { rayOrig.x, rayOrig.y, rayOrig.z };
+	const float dir[3] = { rayDir.x, rayDir.y, rayDir.z };
+	const float bMin[3] = { mins.x, mins.y, mins.z }, bMax[3] = { maxs.x, maxs.y, maxs.z };
+	float lmin = 0.0f, lmax = 1.0f;
+
+	for( unsigned int i = 0; i < 3; ++i )
+	{
+		if( fabsf( dir[i] ) < Math::Epsilon )
+		{
+			// Ray is parallel to slab
+			if( orig[i] < bMin[i] || orig[i] > bMax[i] ) return false;
+			continue;
+		}
+		
+		float l1 = (bMin[i] - orig[i]) / dir[i];
+		float l2 = (bMax[i] - orig[i]) / dir[i];
+		lmin = maxf( minf( l1, l2 ), lmin );
+		lmax = minf( maxf( l1, l2 ), lmax );
+		if( lmin > lmax ) return false;
+	}
+
+	t = lmin;
+	return true;
+}
+
+
 inline float nearestDistToAABB( const Vec3f &pos, const Vec3f &mins, const Vec3f &maxs )
 {
 	const Vec3f center = (mins + maxs) * 0.5f;
@@ -0,0 +1,69 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2009 Nicolas Schulz
+//
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// *************************************************************************************************
+
+// -------------------------------------------------------------------------------------------------
+//
+// SSE helpers for the math library
+//
+// -------------------------------------------------------------------------------------------------
+
+#ifndef _utMathSSE_H_
+#define _utMathSSE_H_
+
+#include "utPlatform.h"
+#include "utMath.h"
+
+#ifdef PLATFORM_SSE
+#	include <xmmintrin.h>
+
+// Conversion of four consecutive vectors between xyz layout and separate x, y and z registers
+
+static inline void loadVec3x4( const Vec3f *vecs, __m128 &x, __m128 &y, __m128 &z )
+{
+	// Four consecutive vectors x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 to SoA form
+	const float *p = &vecs[0].x;
+	__m128 a = _mm_loadu_ps( p ), b = _mm_loadu_ps( p + 4 ), c = _mm_loadu_ps( p + 8 );
+
+	x = _mm_shuffle_ps( a, _mm_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 3, 0 ) );
+	y = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ),
+	                    _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+	z = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ), c, _MM_SHUFFLE( 3, 0, 2, 0 ) );
+}
+
+
+static inline void storeVec3x4( Vec3f *vecs, __m128 x, __m128 y, __m128 z )
+{
+	float *p = &vecs[0].x;
+	
+	_mm_storeu_ps( p, _mm_shuffle_ps( _mm_shuffle_ps( x, y, _MM_SHUFFLE( 0, 0, 0, 0 ) ),
+	                                  _mm_shuffle_ps( z, x, _MM_SHUFFLE( 1, 1, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+	_mm_storeu_ps( p + 4, _mm_shuffle_ps( _mm_shuffle_ps( y, z, _MM_SHUFFLE( 1, 1, 1, 1 ) ),
+	                                      _mm_shuffle_ps( x, y, _MM_SHUFFLE( 2, 2, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+	_mm_storeu_ps( p + 8, _mm_shuffle_ps( _mm_shuffle_ps( z, x, _MM_SHUFFLE( 3, 3, 2, 2 ) ),
+	                                      _mm_shuffle_ps( y, z, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+}
+
+#endif
+
+#endif // _utMathSSE_H_
@@ -37,6 +37,18 @@
 #   endif
 #endif
 
+#ifndef PLATFORM_SSE
+#	if defined( __SSE__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 1)
+#		define PLATFORM_SSE
+#	endif
+#endif
+
+#ifndef PLATFORM_SSE2
+#	if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+#		define PLATFORM_SSE2
+#	endif
+#endif
+
 
 
 #ifndef DLLEXP